@@ -6,31 +6,176 @@
 #include "liblivescene/Export.h"
 #include "liblivescene/Image.h"
 #include <string>
+#include <vector>
 
 
+namespace OpenThreads {
+class Atomic;
+class AtomicPtr;
+}
+
 namespace livescene {
 
 
 /** \defgroup Background Background Isolation */
 /*@{*/
 
+class Background;
+
+/** \brief Scene change callback functor base class.
+Called by Background::accumulateZBackgroundFromLive() when it has relearned part of the background after a scene change,
+with the number of tiles relearned. Called on the thread that learns.
+*/
+
+class LIVESCENE_EXPORT SceneChangeCallback
+{
+	public:
+		virtual ~SceneChangeCallback() {}
+		virtual void operator ()(const livescene::Background &background, const unsigned int &numTiles) = 0; // must be overridden
+}; // SceneChangeCallback
+
+
+/** \brief Immutable copy of a Background's planes, published by Background::publishSnapshot().
+Once acquired with Background::acquireSnapshot(), a snapshot stays valid and unchanged until it is released, whatever
+the Background does meanwhile, so other threads (rendering, say) can read the background while one thread learns it.
+Snapshots belong to their Background, and must all be released before it is destroyed.
+*/
+
+class LIVESCENE_EXPORT BackgroundSnapshot
+{
+	public:
+		// increases with every publish that copied a changed model
+		unsigned long getVersion(void) const {return(_version);}
+		const livescene::Image &getBackgroundZ(void) const {return(_bgZ);}
+		const livescene::Image &getBackgroundRGB(void) const {return(_bgRGB);}
+		// see Background::getDiscriminationThresholds()
+		const unsigned short *getDiscriminationThresholds(void) const {return(_zThreshold.empty() ? 0 : &_zThreshold.front());}
+		// once for every acquire. The snapshot may be reused for a later publish as soon as nothing references it.
+		void release(void) const;
+
+	private:
+		friend class Background;
+		BackgroundSnapshot();
+		~BackgroundSnapshot();
+		BackgroundSnapshot(const BackgroundSnapshot &); // owns its reference count, not copyable
+		BackgroundSnapshot &operator =(const BackgroundSnapshot &);
+
+		livescene::Image _bgZ, _bgRGB;
+		std::vector<unsigned short> _zThreshold;
+		std::vector<unsigned char> _rgbThreshold;
+		float _colorAmbiguityFactor; // as it was when published, so extraction doesn't read the live setting
+		unsigned long _version;
+		unsigned long _modelVersion; // of the Background's model when copied
+		bool _retired; // never published again, and deleted once nothing references it
+		OpenThreads::Atomic *_references; // owned
+}; // BackgroundSnapshot
+
+
+/** \brief Results of one extraction, and the scratch it works in.
+Background::extractZBackground() against a snapshot writes these instead of the Background's own, so each thread that
+extracts keeps one of its own and nothing is shared with the thread that learns. Background::useExtraction() hands the
+tile flags back to the learning thread.
+*/
+
+class LIVESCENE_EXPORT BackgroundExtraction
+{
+	public:
+		BackgroundExtraction() : _foregroundCount(0), _foregroundMinX(0), _foregroundMinY(0), _foregroundMaxX(0), _foregroundMaxY(0),
+			_firstTileX(0), _endTileX(0), _firstTileY(0), _endTileY(0) {}
+
+		// see Background::getForegroundMask() and the rest
+		const unsigned char *getForegroundMask(void) const {return(_foregroundMask.empty() ? 0 : &_foregroundMask.front());}
+		unsigned long getForegroundCount(void) const {return(_foregroundCount);}
+		void getForegroundBounds(unsigned int &minX, unsigned int &minY, unsigned int &maxX, unsigned int &maxY) const
+			{minX = _foregroundMinX; minY = _foregroundMinY; maxX = _foregroundMaxX; maxY = _foregroundMaxY;}
+		const unsigned char *getTileFlags(void) const {return(_tileFlags.empty() ? 0 : &_tileFlags.front());}
+
+	private:
+		friend class Background;
+
+		std::vector<unsigned char> _foregroundMask, _tileFlags;
+		std::vector<unsigned char> _colorChannelChanges, _colorChanges; // one line of colour comparison, per channel and per sample
+		unsigned long _foregroundCount;
+		unsigned int _foregroundMinX, _foregroundMinY, _foregroundMaxX, _foregroundMaxY;
+		unsigned int _firstTileX, _endTileX, _firstTileY, _endTileY; // tiles the view covered
+}; // BackgroundExtraction
+
+
+
 /** \brief Background processor.
 
+The background can come from clean plates (frames known to be empty), and/or be learned
+continuously from live frames with the accumulate*FromLive() methods.
+
+Live learning keeps a per-pixel running Gaussian of Z (mean and variance planes, stored
+structure-of-arrays so the update loops vectorize) and a running mean of RGB. Each live sample that
+matches its pixel's model nudges the model toward it at the learning rate, so slow drift (lighting,
+sensor warm-up, things settling) is followed continuously. Samples that don't match are
+foreground, and leave the model alone, so people in frame don't freeze learning elsewhere and
+aren't learned themselves. A pixel whose mismatching sample stays at the same depth long enough
+is absorbed: after the absorb frame count if it is nearer than the model (something was put
+down), or after the much shorter reveal frame count if it is farther (something that was
+learned as background has moved away, which can't be seen through).
+
+The learned mean is written into the background Z image, so getBackgroundZ() and
+extractZBackground() work the same whichever way the background was built. Learning changes
+the planes in place, so other threads should read them through snapshots instead: the
+learning thread calls publishSnapshot() when it has finished a frame, which copies the planes
+into a free snapshot and swaps it in atomically, and readers acquireSnapshot() and release it
+when done, without locks on either side. Publishing a model that hasn't changed since the last
+snapshot copies nothing. Snapshots are pooled; there are normally three (the current one, one
+still being read, and one being written), and more only while readers hold on to old ones.
+
+Extraction doesn't use one tolerance for the whole frame: each pixel has its own threshold,
+the match standard deviations times its learned Z standard deviation, but at least the
+discrimination epsilon of its mean and at least the minimum discrimination delta. Live learning
+matches against the same threshold, so a sample is learned exactly when extraction calls it
+background. Noisy pixels (edges, far surfaces) get the wider margin they need, and
+stable ones a tighter one. The thresholds are a 16-bit plane kept up to date as the variance is
+learned, so extraction just reads them. Where the noise hasn't been measured yet the variance
+starts out at the discrimination epsilon; building the background from a batch of clean plates
+measures it from the batch.
+
+The RGB model is a per-channel mean and mean absolute deviation, both 16-bit fixed point and
+interleaved like the RGB image, from which a per-channel color difference threshold is kept.
+Colour-assisted extraction uses it where depth alone can't decide: where the live Z is NULL
+(depth shadows, dropouts), and where live and background Z are within the ambiguity band of each
+other (feet on the floor, a hand flat on a table, noise just past the epsilon). There, a sample
+is foreground if its color differs from the background's.
+
+Extraction also marks TILE_SIZE square tiles of the frame: TILE_CHANGED where any valid live
+sample differs from the background by more than the discrimination epsilon, TILE_OCCUPIED where
+there is foreground. Live learning then only updates changed tiles every frame, and refreshes the
+unchanged ones in turn, one in getTileRefreshInterval() each frame at a correspondingly higher
+rate, so its cost follows the activity in the scene while the whole background keeps tracking
+slow drift, even around people in frame. Without extraction results for the frame size being
+learned, every tile is updated.
+
+If the sensor is bumped or the furniture moves, most of the frame suddenly differs from the
+background and stays that way, which absorption alone would take a long time to fix. So the live
+Z update counts, for each tile, the consecutive frames in which at least the scene change sample
+fraction of its samples both differ from the background and are still within the discrimination
+epsilon of the depth they had when that run began. Someone moving about doesn't hold still like
+that. When at least the scene change fraction of all tiles have done so for the scene change frame
+count, those tiles are relearned outright from the live frame, and the SceneChangeCallback is told
+if there is one. A person standing still enough, close enough, for that long looks the same, so the
+defaults are conservative: three quarters of each tile, 60% of the frame, for 90 frames.
 */
 
 
 class LIVESCENE_EXPORT Background
 {
 	public:
-		Background() : _backgroundAvailable(false), _discriminationEpsilonPercent(.01f) {};
-		~Background() {};
+		Background();
+		~Background();
 
 		bool getBackgroundAvailable(void) const {return(_backgroundAvailable);}
 
-		// the discrimination epsilon is the amount of error tolerated when comparing the candidate Z value
-		// against the stored background Z value. It is expressed as a percent of the Z value of the
-		// sample being compared, since Z precision is presumed to degrade with distance.
-		void setDiscriminationEpsilonPercent(const float discriminationEpsilonPercent) {_discriminationEpsilonPercent = discriminationEpsilonPercent;}
+		// the discrimination epsilon is the amount of error presumed when comparing the candidate Z value
+		// against the stored background Z value, until the real noise has been measured, and the least live
+		// learning tolerates. It is expressed as a percent of the Z value of the sample being compared,
+		// since Z precision is presumed to degrade with distance.
+		void setDiscriminationEpsilonPercent(const float discriminationEpsilonPercent) {_discriminationEpsilonPercent = discriminationEpsilonPercent; updateZThresholds();}
 		float getDiscriminationEpsilonPercent(void) const {return(_discriminationEpsilonPercent);}
 
 		/** Comparison/accumulation mode to use when accumulating background
@@ -48,26 +193,220 @@ class LIVESCENE_EXPORT Background
 		bool loadRGBBackgroundFromCleanPlate(const livescene::Image &cleanPlateRGB);
 		bool loadZBackgroundFromCleanPlate(const livescene::Image &cleanPlateZ);
 		bool accumulateBackgroundFromCleanPlate(const livescene::Image &cleanPlateRGB, const livescene::Image &cleanPlateZ, AccumulateMode mode, livescene::Image *foreZ = NULL);
+		// RGB is averaged in every mode
 		bool accumulateRGBBackgroundFromCleanPlate(const livescene::Image &cleanPlateRGB, AccumulateMode mode);
 		bool accumulateZBackgroundFromCleanPlate(const livescene::Image &cleanPlateZ, AccumulateMode mode, livescene::Image *foreZ = NULL);
 
-		// <<<>>> not yet implemented, accumulate non-changing pixels from live stream into background
+		/** Per-sample estimator used when building the background from a batch of clean plates
+		*/
+		enum BatchEstimator {
+			MEDIAN,
+			TRIMMED_MEAN,
+		};
+
+		// builds the background from a batch of clean plates at once, e.g. the first few frames after startup.
+		// Each sample becomes the median (or trimmed mean) of its valid values across the batch, so flicker and
+		// dropouts that a running average would smear into the plate are simply outvoted. NULL/zero Z values
+		// are left out, and a Z sample is only NULL if it is NULL in every plate. All plates must match the first
+		// in size and format. trimFraction is the fraction of the valid values dropped from each end for TRIMMED_MEAN.
+		// Later accumulate*FromCleanPlate() AVERAGE calls weigh the batch result by the number of values behind it.
+		bool loadBackgroundFromCleanPlates(const std::vector<const livescene::Image *> &cleanPlatesRGB, const std::vector<const livescene::Image *> &cleanPlatesZ,
+			BatchEstimator estimator = MEDIAN, float trimFraction = 0.25f);
+		bool loadRGBBackgroundFromCleanPlates(const std::vector<const livescene::Image *> &cleanPlatesRGB, BatchEstimator estimator = MEDIAN, float trimFraction = 0.25f);
+		bool loadZBackgroundFromCleanPlates(const std::vector<const livescene::Image *> &cleanPlatesZ, BatchEstimator estimator = MEDIAN, float trimFraction = 0.25f);
+
+		// live learning parameters, see class description
+		// fraction of the difference between a matching sample and the model that is learned per frame
+		void setLearningRate(const float learningRate) {_learningRate = learningRate;}
+		float getLearningRate(void) const {return(_learningRate);}
+		// a sample matches if it is within its extraction threshold: this many standard deviations of
+		// the model, the discrimination epsilon or the minimum discrimination delta, whichever is larger
+		void setMatchStdDevs(const float matchStdDevs) {_matchStdDevs = matchStdDevs; updateZThresholds();}
+		float getMatchStdDevs(void) const {return(_matchStdDevs);}
+		// frames a nearer, stationary mismatch persists before it becomes background
+		void setAbsorbFrames(const unsigned short absorbFrames) {_absorbFrames = absorbFrames;}
+		unsigned short getAbsorbFrames(void) const {return(_absorbFrames);}
+		// frames a farther, stationary mismatch persists before it becomes background
+		void setRevealFrames(const unsigned short revealFrames) {_revealFrames = revealFrames;}
+		unsigned short getRevealFrames(void) const {return(_revealFrames);}
+		// unchanged tiles are refreshed once in this many frames
+		void setTileRefreshInterval(const unsigned short tileRefreshInterval) {_tileRefreshInterval = tileRefreshInterval > 0 ? tileRefreshInterval : 1; _tileRefreshPhase = 0;}
+		unsigned short getTileRefreshInterval(void) const {return(_tileRefreshInterval);}
+		// scene change detection, see class description. A fraction above 1 turns it off.
+		void setSceneChangeFraction(const float sceneChangeFraction) {_sceneChangeFraction = sceneChangeFraction;}
+		float getSceneChangeFraction(void) const {return(_sceneChangeFraction);}
+		void setSceneChangeSampleFraction(const float sceneChangeSampleFraction) {_sceneChangeSampleFraction = sceneChangeSampleFraction;}
+		float getSceneChangeSampleFraction(void) const {return(_sceneChangeSampleFraction);}
+		void setSceneChangeFrames(const unsigned short sceneChangeFrames) {_sceneChangeFrames = sceneChangeFrames > 0 ? sceneChangeFrames : 1;}
+		unsigned short getSceneChangeFrames(void) const {return(_sceneChangeFrames);}
+		// not owned, 0 for none
+		void setSceneChangeCallback(livescene::SceneChangeCallback *sceneChangeCallback) {_sceneChangeCallback = sceneChangeCallback;}
+		livescene::SceneChangeCallback *getSceneChangeCallback(void) const {return(_sceneChangeCallback);}
+
+		// learn from a live frame, which may contain foreground. If there is no background yet, the frame becomes it.
+		// RGB only learns where the Z model matched, so foreground colors don't bleed into the background.
 		bool accumulateBackgroundFromLive(const livescene::Image &liveRGB, const livescene::Image &liveZ);
+		// learns where the most recent accumulateZBackgroundFromLive() matched, or everywhere if Z isn't being learned
 		bool accumulateRGBBackgroundFromLive(const livescene::Image &liveRGB);
 		bool accumulateZBackgroundFromLive(const livescene::Image &liveZ);
 
 		// extracts the foreground from the background plate.
 		// foregroundZ must be prepped with Image::preAllocate
+		// In the same pass this writes the foreground mask, and the foreground XYZ statistics into
+		// foregroundZ's cached internal stats, so calcInternalStatsXYZ() on it costs nothing afterward.
+		// Returns false if there is no background, or the images don't match it in size.
 		bool extractZBackground(const livescene::Image &liveZ, livescene::Image &foregroundZ);
+		// region-of-interest variant: only samples inside the liveZ view are classified and written,
+		// the rest of foregroundZ and the mask is left untouched. The view must be of an image the size of the background.
+		// foregroundZ's internal stats are invalidated unless the view covers the whole image.
+		bool extractZBackground(const livescene::ImageView &liveZ, livescene::Image &foregroundZ);
+		// colour-assisted variants, see class description. liveRGB must match the RGB background.
+		// Samples with NULL live Z whose color has changed are marked MASK_FOREGROUND_NO_Z in the mask, but
+		// have no depth to put in foregroundZ, so they stay NULL there and aren't in the count, bounds or stats.
+		bool extractZBackground(const livescene::Image &liveZ, const livescene::Image &liveRGB, livescene::Image &foregroundZ);
+		bool extractZBackground(const livescene::ImageView &liveZ, const livescene::Image &liveRGB, livescene::Image &foregroundZ);
+		// the same against a snapshot, from any thread. Only the snapshot's planes, thresholds and colour ambiguity factor
+		// are read, and the mask, bounds and tile flags go to extraction, so nothing the learning thread touches is shared.
+		// Returns false if the snapshot has no thresholds yet, or the images don't match it in size.
+		static bool extractZBackground(const livescene::BackgroundSnapshot &snapshot, const livescene::Image &liveZ,
+			livescene::Image &foregroundZ, livescene::BackgroundExtraction &extraction);
+		static bool extractZBackground(const livescene::BackgroundSnapshot &snapshot, const livescene::ImageView &liveZ,
+			livescene::Image &foregroundZ, livescene::BackgroundExtraction &extraction);
+		static bool extractZBackground(const livescene::BackgroundSnapshot &snapshot, const livescene::Image &liveZ, const livescene::Image &liveRGB,
+			livescene::Image &foregroundZ, livescene::BackgroundExtraction &extraction);
+		static bool extractZBackground(const livescene::BackgroundSnapshot &snapshot, const livescene::ImageView &liveZ, const livescene::Image &liveRGB,
+			livescene::Image &foregroundZ, livescene::BackgroundExtraction &extraction);
+		// from the thread that learns: the next live Z update, and its scene change detection, go by the tile flags of
+		// an extraction against a snapshot, as they do by the Background's own after extractZBackground() on it.
+		// Ignored if the extraction was of a background of another size.
+		void useExtraction(const livescene::BackgroundExtraction &extraction);
 
-		// these can be used to display the background independently
+		// extraction thresholds, see class description. Thresholds are in Z units, and never more than Z_THRESHOLD_LIMIT.
+		enum {Z_THRESHOLD_LIMIT = 1023};
+		void setMinimumDiscriminationDelta(const unsigned short minimumDiscriminationDelta) {_minimumDiscriminationDelta = minimumDiscriminationDelta; updateZThresholds();}
+		unsigned short getMinimumDiscriminationDelta(void) const {return(_minimumDiscriminationDelta);}
+		// one per sample of the background. Empty until the background has been extracted against or learned from.
+		const unsigned short *getDiscriminationThresholds(void) const {return(_zThreshold.empty() ? 0 : &_zThreshold.front());}
+
+		// colour-assisted extraction parameters
+		// a channel has changed if it differs from the background by more than this many of its standard deviations
+		void setColorDeviations(const float colorDeviations) {_colorDeviations = colorDeviations; updateRGBThresholds();}
+		float getColorDeviations(void) const {return(_colorDeviations);}
+		// and by at least this much, which is all that counts where the background color has no measured noise
+		void setColorMinimumDelta(const unsigned char colorMinimumDelta) {_colorMinimumDelta = colorMinimumDelta; updateRGBThresholds();}
+		unsigned char getColorMinimumDelta(void) const {return(_colorMinimumDelta);}
+		// live Z within this many thresholds of the background Z, nearer or farther, is decided by color. Below 16.
+		void setColorAmbiguityFactor(const float colorAmbiguityFactor) {_colorAmbiguityFactor = colorAmbiguityFactor; ++_modelVersion;}
+		float getColorAmbiguityFactor(void) const {return(_colorAmbiguityFactor);}
+
+		// results of the most recent extractZBackground() on the Background itself, covering just its view
+		// mask is one byte per sample of the background, MASK_FOREGROUND for foreground, 0 otherwise. Empty before the first extraction.
+		enum {MASK_FOREGROUND = 0xff, MASK_FOREGROUND_NO_Z = 0x80};
+		const unsigned char *getForegroundMask(void) const {return(_extraction.getForegroundMask());}
+		unsigned long getForegroundCount(void) const {return(_extraction.getForegroundCount());}
+		// inclusive bounds, all zero if there was no foreground
+		void getForegroundBounds(unsigned int &minX, unsigned int &minY, unsigned int &maxX, unsigned int &maxY) const
+			{_extraction.getForegroundBounds(minX, minY, maxX, maxY);}
+		// tile flags, one byte per tile, row-major, that the next live Z update goes by: the most recent extraction's,
+		// or useExtraction()'s. Only tiles the view touched are current. Empty before the first extraction.
+		enum {TILE_SIZE = 16, TILE_CHANGED = 1, TILE_OCCUPIED = 2};
+		unsigned int getTilesX(void) const {return((_bgZ.getWidth() + TILE_SIZE - 1) / TILE_SIZE);}
+		unsigned int getTilesY(void) const {return((_bgZ.getHeight() + TILE_SIZE - 1) / TILE_SIZE);}
+		const unsigned char *getTileFlags(void) const {return(_tileFlags.empty() ? 0 : &_tileFlags.front());}
+
+		// saves the whole model: planes, accumulation and learning state, and parameters, so a fixed installation
+		// can carry on where it left off after a restart. The file is versioned and chunked, with the planes
+		// page-aligned so it can be memory-mapped. It is written beside fileName and renamed over it once complete,
+		// so a crash mid-save leaves the last good model. Returns false if there is no background or the file can't be written.
+		bool save(const std::string &fileName) const;
+		// replaces the current model with a saved one. Learning state that is missing, or doesn't match the planes
+		// in size, is rebuilt from the planes as it would be after a clean-plate load. The saved parameters are for
+		// reference only: tuning stays as the caller set it. Returns false, leaving the model as it was, if the file
+		// can't be read or isn't a model this version understands.
+		bool load(const std::string &fileName);
+
+		// these can be used to display the background independently, from the thread that learns it
 		const livescene::Image &getBackgroundZ(void) const {return(_bgZ);}
 		const livescene::Image &getBackgroundRGB(void) const {return(_bgRGB);}
 
+		// snapshots, see class description. Publish from the thread that learns, after it changes the model; returns the
+		// current snapshot's version, which is only new if the model changed, or 0 if there is no background.
+		unsigned long publishSnapshot(void);
+		// from any thread. The latest published snapshot, referenced until released, or NULL if none has been published.
+		const livescene::BackgroundSnapshot *acquireSnapshot(void) const;
+
 	private:
+		Background(const Background &); // owns its snapshots, not copyable
+		Background &operator =(const Background &);
+
+		void initLiveModel(void);
+		void updateZThresholds(void);
+		void initRGBModel(void);
+		void updateRGBThresholds(void);
+		void seedRGBAccumulators(void);
+		void invalidateTiles(void);
+		bool detectSceneChange(const livescene::Image &liveZ);
+		bool extractForeground(const livescene::ImageView &liveZ, const livescene::Image *liveRGB, livescene::Image &foregroundZ);
+		static bool extractForeground(const livescene::Image &bgZ, const livescene::Image &bgRGB, const std::vector<unsigned short> &zThreshold,
+			const std::vector<unsigned char> &rgbThreshold, const float &colorAmbiguityFactor,
+			const livescene::ImageView &liveZ, const livescene::Image *liveRGB, livescene::Image &foregroundZ, livescene::BackgroundExtraction &extraction);
+
 		livescene::Image _bgRGB, _bgZ;
 		bool _backgroundAvailable;
 		float _discriminationEpsilonPercent;
+		unsigned short _minimumDiscriminationDelta;
+
+		// live Z model. Rebuilt from _bgZ whenever that is changed some other way.
+		float _learningRate, _matchStdDevs;
+		unsigned short _absorbFrames, _revealFrames;
+		bool _liveModelValid;
+		std::vector<float> _zMean, _zVariance; // mean < 0 means no data yet
+		std::vector<unsigned short> _zCandidate, _zPersistence; // depth of the current mismatch and how many frames it has held
+		std::vector<unsigned char> _zMatched; // non-zero where the latest live Z sample matched the model
+		std::vector<unsigned short> _zThreshold; // extraction threshold from the variance, kept with the model
+
+		// RGB model, interleaved like the RGB image, in fixed point (see Background.cpp). Kept whenever _bgRGB has data.
+		float _colorDeviations, _colorAmbiguityFactor;
+		unsigned char _colorMinimumDelta;
+		std::vector<unsigned short> _rgbMean, _rgbDeviation; // deviation is the mean absolute deviation
+		std::vector<unsigned char> _rgbThreshold; // channel difference beyond which the color has changed
+		unsigned short _rgbModelWeight; // how many plates the model stands for, when seeding the accumulators from it
+		bool _rgbAccumulatorsValid;
+		unsigned short _rgbAccumulations;
+		std::vector<unsigned int> _rgbSums, _rgbSumSquares;
+
+		// clean-plate accumulation. Sums and counts are rebuilt from _bgZ whenever that is changed some other way.
+		bool _zAccumulatorsValid;
+		std::vector<unsigned int> _zSums;
+		std::vector<unsigned short> _zCounts;
+		std::vector<unsigned short> _zBefore; // background before the current plate, for the _ADJACENT modes
+		std::vector<unsigned char> _zAdjacent; // one line of adjacency results
+
+		// tile change tracking. Flags are only valid for the background extraction last ran against.
+		std::vector<unsigned char> _tileFlags; // what the next live Z update goes by, see useExtraction()
+		bool _tileFlagsValid;
+		unsigned short _tileRefreshInterval, _tileRefreshPhase;
+		std::vector<unsigned int> _changedTiles, _refreshTiles; // tiles the latest live Z update covered, at the normal and refresh rates
+
+		// scene change detection
+		float _sceneChangeFraction, _sceneChangeSampleFraction;
+		unsigned short _sceneChangeFrames;
+		livescene::SceneChangeCallback *_sceneChangeCallback;
+		std::vector<unsigned short> _tileStableFrames; // consecutive live Z updates each tile has been changed and steady for
+		std::vector<unsigned short> _sceneChangeReference; // live Z from the start of each tile's run
+		std::vector<unsigned short> _tileChangedSamples, _tileStableSamples; // of the latest live Z update
+		std::vector<unsigned int> _sceneChangeTiles, _sceneChangeRestartTiles; // tiles it looked at, and those whose runs began
+		std::vector<unsigned int> _relearnTiles; // tiles the latest live Z update relearned
+
+		// snapshot pool. Only publishSnapshot() changes it, readers only ever go through _currentSnapshot.
+		std::vector<livescene::BackgroundSnapshot *> _snapshots;
+		OpenThreads::AtomicPtr *_currentSnapshot; // owned
+		OpenThreads::Atomic *_acquiring; // owned, readers inside acquireSnapshot()
+		unsigned long _snapshotVersion;
+		unsigned long _modelVersion; // bumped by everything that changes what a snapshot copies
+
+		// results of extraction against the Background itself
+		livescene::BackgroundExtraction _extraction;
 
 }; // Background
 
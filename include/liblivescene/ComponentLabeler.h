@@ -0,0 +1,143 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#ifndef __LIVESCENE_COMPONENTLABELER_H__
+#define __LIVESCENE_COMPONENTLABELER_H__ 1
+
+#include "liblivescene/Export.h"
+#include "liblivescene/Image.h"
+#include <vector>
+#include <cmath> // sqrt
+
+
+namespace livescene {
+
+
+/** \addtogroup Detect */
+/*@{*/
+
+/** \brief Statistics of one connected component, gathered while labelling.
+Coordinates are in parent image space, bounds are inclusive.
+*/
+
+struct LIVESCENE_EXPORT ComponentStats
+{
+public:
+	ComponentStats() : label(0), count(0), minX(0), minY(0), maxX(0), maxY(0), minZ(0), maxZ(0),
+		sumX(0.0), sumY(0.0), sumZ(0.0), sumXX(0.0), sumYY(0.0), sumZZ(0.0) {}
+
+	float getCentroidX(void) const {return(count ? (float)(sumX / count) : 0.0f);}
+	float getCentroidY(void) const {return(count ? (float)(sumY / count) : 0.0f);}
+	float getCentroidZ(void) const {return(count ? (float)(sumZ / count) : 0.0f);}
+	// population standard deviations, the same spread ImageStatistics reports for large sample counts
+	float getStdDevX(void) const {return(stdDev(sumX, sumXX));}
+	float getStdDevY(void) const {return(stdDev(sumY, sumYY));}
+	float getStdDevZ(void) const {return(stdDev(sumZ, sumZZ));}
+
+	unsigned int label; // value of this component in the label plane, 1...N
+	unsigned long count;
+	unsigned int minX, minY, maxX, maxY;
+	unsigned short minZ, maxZ;
+	double sumX, sumY, sumZ, sumXX, sumYY, sumZZ;
+
+private:
+	float stdDev(const double &sum, const double &sumSquares) const
+	{
+		if(count < 2) return(0.0f);
+		const double mean = sum / count, variance = sumSquares / count - mean * mean;
+		return(variance > 0.0 ? (float)sqrt(variance) : 0.0f);
+	}
+}; // ComponentStats
+
+
+/** \brief Run-based connected-component labeller for foreground Z images.
+
+Each row is first broken into runs of valid samples, where a run also ends at any depth step
+larger than the continuity threshold. Runs touching a run on the previous row (8-connected,
+and within the continuity threshold across at least one touching pair of samples) are merged
+with a union-find table using path compression. The depth sums are taken while the runs are
+built, so resolving final labels and totalling per-component statistics only walks the runs,
+not the samples; each sample of the label plane is then written once.
+
+Two people standing side by side, or a hand held in front of the body, therefore come out as
+separate components as long as there is a depth step between them.
+
+Components smaller than the minimum size are rejected: they get label 0, aren't reported, and
+can optionally be written to NULL in the source, which makes a separate Image::filterNoise()
+pass unnecessary.
+*/
+
+class LIVESCENE_EXPORT ComponentLabeler
+{
+	public:
+		// depthContinuity is in the units of the image being labelled: raw disparity or millimeters
+		ComponentLabeler(const unsigned short depthContinuity = 10, const unsigned long minComponentSamples = 0, const bool nullRejected = false)
+			: _depthContinuity(depthContinuity), _minComponentSamples(minComponentSamples), _nullRejected(nullRejected),
+			_labelsWidth(0), _labelsHeight(0), _originX(0), _originY(0), _viewWidth(0), _viewHeight(0) {}
+
+		void setDepthContinuity(const unsigned short depthContinuity) {_depthContinuity = depthContinuity;}
+		unsigned short getDepthContinuity(void) const {return(_depthContinuity);}
+		void setMinComponentSamples(const unsigned long minComponentSamples) {_minComponentSamples = minComponentSamples;}
+		unsigned long getMinComponentSamples(void) const {return(_minComponentSamples);}
+		// if true, label() writes NULL into the source for samples of rejected components
+		void setNullRejected(const bool nullRejected) {_nullRejected = nullRejected;}
+		bool getNullRejected(void) const {return(_nullRejected);}
+
+		// labels the valid samples of a Z view. Returns the number of components kept.
+		// Previous results are discarded.
+		unsigned int label(const livescene::ImageView &foreZ);
+		unsigned int label(const livescene::Image &foreZ) {return(label(foreZ.getView()));}
+
+		// components kept by the last label(), in order of their topmost-leftmost sample
+		const std::vector<livescene::ComponentStats> &getComponents(void) const {return(_components);}
+		unsigned int getNumComponents(void) const {return(_components.size());}
+		// index of the component with the most samples, or -1 if there are none
+		int getLargestComponent(void) const;
+
+		// label plane is the size of the parent image of the last view labelled. Outside that view it reads 0.
+		// X, Y are in parent image space
+		unsigned int getLabel(const unsigned int &X, const unsigned int &Y) const
+		{
+			if(X - _originX >= _viewWidth || Y - _originY >= _viewHeight) return(0); // unsigned wrap covers below-origin too
+			return(_labels[Y * _labelsWidth + X]);
+		}
+		const unsigned int *getLabels(void) const {return(_labels.empty() ? 0 : &_labels.front());}
+		unsigned int getLabelsWidth(void) const {return(_labelsWidth);}
+		unsigned int getLabelsHeight(void) const {return(_labelsHeight);}
+
+	private:
+		struct Run
+		{
+			unsigned int line, start, end; // relative to the view, end is exclusive
+			unsigned int provisional; // provisional label, an index into _parents. Becomes the component index once resolved
+			unsigned int sumZ, minZ, maxZ;
+			double sumZZ;
+		};
+
+		unsigned int findRoot(unsigned int provisional);
+		void unite(const unsigned int &provisionalA, const unsigned int &provisionalB);
+		bool runsConnect(const livescene::ImageView &foreZ, const Run &above, const Run &below) const;
+
+		unsigned short _depthContinuity;
+		unsigned long _minComponentSamples;
+		bool _nullRejected;
+
+		// scratch, reused from frame to frame so labelling doesn't allocate in steady state
+		std::vector<Run> _runs;
+		std::vector<unsigned int> _parents, _rootComponents, _keptLabels;
+		std::vector<livescene::ComponentStats> _allComponents;
+
+		std::vector<unsigned int> _labels;
+		unsigned int _labelsWidth, _labelsHeight;
+		unsigned int _originX, _originY, _viewWidth, _viewHeight;
+		std::vector<livescene::ComponentStats> _components;
+
+}; // ComponentLabeler
+
+/*@}*/
+
+
+// namespace livescene
+}
+
+// __LIVESCENE_COMPONENTLABELER_H__
+#endif
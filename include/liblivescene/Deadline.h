@@ -0,0 +1,49 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#ifndef __LIVESCENE_DEADLINE_H__
+#define __LIVESCENE_DEADLINE_H__ 1
+
+#include "liblivescene/Export.h"
+#include <osg/Timer>
+#include <cfloat> // DBL_MAX
+
+
+namespace livescene {
+
+
+/** \addtogroup Detect */
+/*@{*/
+
+/** \brief A time budget for work that can stop early with a usable result.
+A default-constructed Deadline never expires. Stages that take one do their coarse work first and
+only refine while there is time left, and report whether they finished.
+*/
+
+class Deadline
+{
+	public:
+		// never expires
+		Deadline() : _limited(false), _start(osg::Timer::instance()->tick()), _milliseconds(0.0) {}
+		// expires this many milliseconds from now
+		Deadline(const double milliseconds) : _limited(true), _start(osg::Timer::instance()->tick()), _milliseconds(milliseconds) {}
+
+		bool isLimited(void) const {return(_limited);}
+		double getElapsed(void) const {return(osg::Timer::instance()->delta_m(_start, osg::Timer::instance()->tick()));} // milliseconds
+		// milliseconds left, DBL_MAX if unlimited
+		double getRemaining(void) const {return(_limited ? (_milliseconds > getElapsed() ? _milliseconds - getElapsed() : 0.0) : DBL_MAX);}
+		bool expired(void) const {return(_limited && getElapsed() >= _milliseconds);}
+
+	private:
+		bool _limited;
+		osg::Timer_t _start;
+		double _milliseconds;
+}; // Deadline
+
+/*@}*/
+
+
+// namespace livescene
+}
+
+// __LIVESCENE_DEADLINE_H__
+#endif
@@ -0,0 +1,91 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#ifndef __LIVESCENE_DEPTHCONVERSION_H__
+#define __LIVESCENE_DEPTHCONVERSION_H__ 1
+
+#include "liblivescene/Export.h"
+#include "liblivescene/Image.h"
+#include <vector>
+
+
+namespace livescene {
+
+
+/** \addtogroup Image */
+/*@{*/
+
+/** \brief Table-driven conversion from raw Kinect depth to millimeters and metric XYZ.
+
+Raw disparity is converted to millimeters with a 2048-entry lookup table built once from the
+calibration published by Nicolas Burrus (http://nicolas.burrus.name/index.php/Research/KinectCalibration),
+the same constants libfreenect's glpclview uses. 10-bit depth is looked up at twice its value,
+which is how the 10-bit mode relates to the 11-bit one.
+
+Metric positions come from per-column and per-row ray tables built from the camera intrinsics,
+so a millimeter sample at (column, line) is placed with one multiply per axis rather than a
+4x4 matrix multiply and divide. Output is in meters, in OSG eye space: X right, Y up, looking
+down -Z, matching what makeDeviceToWorldMatrixOSG() produces.
+
+Raw samples that the calibration can't place (NULL, or beyond the sensor's usable range)
+convert to 0, the DEPTH_MM_16 NULL value.
+*/
+
+class LIVESCENE_EXPORT DepthConversion
+{
+	public:
+		// Kinect defaults, from glpclview
+		DepthConversion(const unsigned int width = 640, const unsigned int height = 480,
+			const float fx = 594.21f, const float fy = 591.04f, const float cx = 339.5f, const float cy = 242.7f);
+
+		// rebuilds the ray tables
+		void setIntrinsics(const unsigned int width, const unsigned int height, const float fx, const float fy, const float cx, const float cy);
+		unsigned int getWidth(void) const {return(_rayX.size());}
+		unsigned int getHeight(void) const {return(_rayY.size());}
+
+		// NULL value of DEPTH_MM_16 images
+		static unsigned short getMillimetersNull(void) {return(0);}
+		// samples farther than this are treated as unusable and converted to NULL
+		static unsigned short getMaxRangeMillimeters(void) {return(10000);}
+
+		// single-sample conversions. format is the raw format, DEPTH_10BIT or DEPTH_11BIT.
+		inline unsigned short rawToMillimeters(const unsigned short &raw, const VideoFormat &format) const
+		{
+			const unsigned int raw11 = (format == DEPTH_10BIT) ? raw * 2 : raw;
+			return(raw11 < 2048 ? _rawToMillimeters[raw11] : getMillimetersNull());
+		}
+		// inverse of the above, used to express metric thresholds for raw images. Clamped to the valid raw range.
+		unsigned short millimetersToRaw(const unsigned short &millimeters, const VideoFormat &format) const;
+		unsigned short metersToRaw(const float &meters, const VideoFormat &format) const {return(millimetersToRaw((unsigned short)(meters * 1000.0f + 0.5f), format));}
+
+		// converts a whole DEPTH_10BIT or DEPTH_11BIT image into a DEPTH_MM_16 image of the same size that already has data.
+		// destination null and timestamp are set. Returns false if the formats or sizes don't fit.
+		bool convertToMillimeters(const livescene::Image &rawZ, livescene::Image &millimetersZ) const;
+
+		// places a millimeter sample in metric eye space. column and line must be within the ray tables.
+		inline void toMetric(const unsigned int &column, const unsigned int &line, const unsigned short &millimeters, float &X, float &Y, float &Z) const
+		{
+			X = _rayX[column] * millimeters;
+			Y = _rayY[line] * millimeters;
+			Z = -0.001f * millimeters;
+		}
+
+		// ray tables, pre-scaled from millimeters to meters
+		const float *getRayX(void) const {return(&_rayX.front());}
+		const float *getRayY(void) const {return(&_rayY.front());}
+
+	private:
+		void buildRawTable(void);
+
+		unsigned short _rawToMillimeters[2048];
+		std::vector<float> _rayX, _rayY;
+
+}; // DepthConversion
+
+/*@}*/
+
+
+// namespace livescene
+}
+
+// __LIVESCENE_DEPTHCONVERSION_H__
+#endif
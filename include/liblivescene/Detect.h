@@ -5,16 +5,20 @@
 
 #include <vector>
 #include <utility>
+#include <algorithm> // std::fill
 #include "liblivescene/Export.h"
 #include "liblivescene/Image.h"
+#include "liblivescene/ComponentLabeler.h"
+#include "liblivescene/ImagePyramid.h"
+#include "liblivescene/Deadline.h"
 
 #include "osg/BoundingBox"
 
 
 namespace livescene {
 
-const int OSG_LIVESCENEVIEW_DETECT_BODY_SAMPLES(13000); // fewer than this many foreground samples in a frame are presumed to be less than a single body
-const int OSG_LIVESCENEVIEW_DETECT_MAX_STACK(10000); // do not accumulate more samples than this in the detection stack
+const int OSG_LIVESCENEVIEW_DETECT_BODY_SAMPLES(13000); // connected foreground smaller than this is presumed to be less than a single body
+const unsigned int OSG_LIVESCENEVIEW_DETECT_COARSE_LEVEL(2); // pyramid level of the first pass of a budgeted detect, 4x4 samples to one
 
 /** \defgroup Detect Object Detection
 */
@@ -38,74 +42,172 @@ private:
 }; // Hand
 
 
-/** \brief Triplet of coordinates, used in CoordStack */
-struct coordTriplet
-{
-public:
-	coordTriplet() : X(0), Y(0), Z(0) {}
-	coordTriplet(unsigned int x, unsigned int y, short z) : X(x), Y(y), Z(z) {}
-
-	unsigned int X, Y;
-	short Z;
-};
-
-/** \brief Stack of coordinate pairs, used internally by sampleAndDepleteAdjacentThresholded(). */
-//typedef std::vector<coordTriplet> CoordStack;
-struct CoordStack
+/** \brief One bit per sample, marking the samples a hand search has already taken.
+Used internally by BodyMass so the search doesn't have to write into (or copy) the foreground image.
+Tracks the bounding box of what has been marked, so clear() only touches that area and the mask
+can be reused frame after frame.
+*/
+struct VisitedMask
 {
 public:
-	CoordStack() : entriesUsed(0) {}
-
-	bool empty(void) const {return(entriesUsed == 0);}
-	size_t size(void) const {return(entriesUsed);}
-	void pop_back(void) {entriesUsed--;}
-	void push_back(const coordTriplet &newItem) {entries[entriesUsed++] = newItem;}
-
-	unsigned int entriesUsed;
-	coordTriplet entries[OSG_LIVESCENEVIEW_DETECT_MAX_STACK];
+	VisitedMask() : width(0), height(0), wordsPerRow(0), minX(0), minY(0), maxX(0), maxY(0), marked(false) {}
 
+	// sizes the mask, all clear. Keeps the storage if the size hasn't changed.
+	void reset(const unsigned int &newWidth, const unsigned int &newHeight)
+	{
+		if(newWidth == width && newHeight == height) return; // already clear, see clear()
+		width = newWidth; height = newHeight; wordsPerRow = (width + 31) / 32;
+		bits.assign(wordsPerRow * height, 0);
+		marked = false;
+	}
+	bool test(const unsigned int &X, const unsigned int &Y) const {return((bits[Y * wordsPerRow + (X >> 5)] >> (X & 31)) & 1);}
+	void set(const unsigned int &X, const unsigned int &Y)
+	{
+		bits[Y * wordsPerRow + (X >> 5)] |= 1U << (X & 31);
+		if(!marked) {minX = maxX = X; minY = maxY = Y; marked = true; return;}
+		if(X < minX) minX = X; else if(X > maxX) maxX = X;
+		if(Y < minY) minY = Y; else if(Y > maxY) maxY = Y;
+	}
+	// clears just the words under the bounding box of the marked samples
+	void clear(void)
+	{
+		if(!marked) return;
+		for(unsigned int line = minY; line <= maxY; ++line)
+		{
+			std::fill(bits.begin() + line * wordsPerRow + (minX >> 5), bits.begin() + line * wordsPerRow + (maxX >> 5) + 1, 0U);
+		}
+		marked = false;
+	}
+
+	std::vector<unsigned int> bits;
+	unsigned int width, height, wordsPerRow;
+	unsigned int minX, minY, maxX, maxY; // inclusive bounds of the marked samples
+	bool marked;
 };
 
 
 /** \brief Detect body mass(es)
-* Currently only supports a single body mass, but API supports multiple
-* in the future.
+* Bodies are the connected foreground components (see ComponentLabeler) of at least
+* OSG_LIVESCENEVIEW_DETECT_BODY_SAMPLES samples, so people standing apart are reported separately
+* rather than as one phantom body between them. detect() costs one labelling pass however many
+* bodies there are. Bodies are numbered largest first, and each has up to two hand slots.
+*
+* Given a limited Deadline, detect() works coarse to fine: it labels a reduced copy of the frame
+* (OSG_LIVESCENEVIEW_DETECT_COARSE_LEVEL of an ImagePyramid, a sixteenth of the samples) and only
+* labels at full resolution, around the bodies found, if the time the coarse pass took says that
+* will fit in what is left. Otherwise the coarse bodies, scaled back to image space, are the result
+* and getDetectFinished() is false. Only the window's part of the pyramid is built. When full
+* resolution labelling last went at a rate that would label the whole window in under half the
+* time left, the coarse pass is skipped and the window labelled at full resolution straight away.
+* detectHands() likewise skips the bodies (or second hands) it has no time left for. Neither can
+* stop partway through a labelling pass or a single hand search.
 */
 
 class LIVESCENE_EXPORT BodyMass
 {
 public:
-	BodyMass() {clear();}
-
-	void clear(void) {_bodyPresent = false; _centroid[0] = _centroid[1] = _centroid[2] = 0.0f; _stdDev[0] = _stdDev[1] = _stdDev[2] = 0.0f;
-	_handCentroid[0][0] = _handCentroid[0][1] = _handCentroid[0][2] = 0.0f; _handCentroid[1][0] = _handCentroid[1][1] = _handCentroid[1][2] = 0.0f;}
-	const bool getBodyPresent(void) const {return(_bodyPresent);}
-	const float *getBodyCentroid(unsigned int bodyNum) const {return(_centroid);} // bodyNum is currently ignored
-	const float *getBodyHalfExtent(unsigned int bodyNum) const {return(_stdDev);} // bodyNum is currently ignored
-	const float *getHandCentroid(unsigned int bodyNum, unsigned int handNum) const; // bodyNum is currently ignored
+	BodyMass() : _labeler(10, OSG_LIVESCENEVIEW_DETECT_BODY_SAMPLES),
+		_coarseLabeler(10 << OSG_LIVESCENEVIEW_DETECT_COARSE_LEVEL, OSG_LIVESCENEVIEW_DETECT_BODY_SAMPLES >> (2 * OSG_LIVESCENEVIEW_DETECT_COARSE_LEVEL)),
+		_pyramid(livescene::ImagePyramid::REDUCE_MIN, OSG_LIVESCENEVIEW_DETECT_COARSE_LEVEL),
+		_labelLevel(0), _labelMinX(0), _labelMinY(0), _labelEndX(0), _labelEndY(0),
+		_fullLabelRate(0.0), _detectFinished(true), _handsFinished(true), _handGapBridge(9) {clear();}
+
+	void clear(void) {_bodies.clear();}
+	const bool getBodyPresent(void) const {return(!_bodies.empty());}
+	unsigned int getNumBodies(void) const {return(_bodies.size());}
+	// bodyNum beyond getNumBodies() gives all zeros
+	const float *getBodyCentroid(unsigned int bodyNum) const {return(bodyNum < _bodies.size() ? _bodies[bodyNum].centroid : _none);}
+	const float *getBodyHalfExtent(unsigned int bodyNum) const {return(bodyNum < _bodies.size() ? _bodies[bodyNum].halfExtent : _none);} // standard deviation
+	const livescene::ComponentStats *getBodyComponent(unsigned int bodyNum) const {return(bodyNum < _bodies.size() ? &_bodies[bodyNum].component : 0);} // bounds, sample count, label
+	unsigned int getNumHands(unsigned int bodyNum) const {return(bodyNum < _bodies.size() ? _bodies[bodyNum].numHands : 0);}
+	const float *getHandCentroid(unsigned int bodyNum, unsigned int handNum) const;
+
+	// labeller used by detect(), for its label plane or to change its depth continuity.
+	// Its labels only belong to the last detect() if getLabelLevel() is 0.
+	livescene::ComponentLabeler &getLabeler(void) {return(_labeler);}
+	const livescene::ComponentLabeler &getLabeler(void) const {return(_labeler);}
+
+	// samples of a hand may be separated by up to this many others, along and across rows, and still be gathered
+	// together. Default is 9, which gathers exactly the samples of the original 21x21 neighborhood.
+	void setHandGapBridge(const unsigned int handGapBridge) {_handGapBridge = handGapBridge;}
+	unsigned int getHandGapBridge(void) const {return(_handGapBridge);}
+
+	unsigned int detect(const livescene::Image &foreZ) {return(detect(foreZ.getView()));} // returns the number of bodies detected
+	// only labels the view, e.g. a window around where bodies are expected. Coordinates are still in parent image space.
+	unsigned int detect(const livescene::ImageView &foreZ);
+	// coarse to fine within deadline, see above. window is a view of foreZ to search. An unlimited deadline is detect(window).
+	unsigned int detect(const livescene::Image &foreZ, const livescene::ImageView &window, const livescene::Deadline &deadline);
+	unsigned int detect(const livescene::Image &foreZ, const livescene::Deadline &deadline) {return(detect(foreZ, foreZ.getView(), deadline));}
+	// false if the last detect() ran out of time and reported the coarse bodies
+	bool getDetectFinished(void) const {return(_detectFinished);}
+	// pyramid level the last detect() labelled at, 0 for full resolution
+	unsigned int getLabelLevel(void) const {return(_labelLevel);}
+	// label of the body sample at X, Y (parent image space) from the last detect(), whatever level it labelled at. 0 for none.
+	unsigned int getBodyLabel(const unsigned int &X, const unsigned int &Y) const
+	{
+		return(_labelLevel ? _coarseLabeler.getLabel(X >> _labelLevel, Y >> _labelLevel) : _labeler.getLabel(X, Y));
+	}
+	// whether X, Y (parent image space) was inside the view the last detect() searched: labelled at some level,
+	// or left out of the refine pass for having no body. Outside it getBodyLabel() is 0 whether or not a body
+	// is there, so hand searches stay inside it.
+	bool getLabelled(const unsigned int &X, const unsigned int &Y) const
+	{
+		return(X >= _labelMinX && X < _labelEndX && Y >= _labelMinY && Y < _labelEndY);
+	}
 
-	unsigned int detect(livescene::Image &foreZ); // can only detect 0 or 1 bodies currently. Doesn't modify image, but modifies its internal stats
-	unsigned int detectHands(const livescene::Image &foreZ); // can only detect one or two hands on one body at this time.
+	// searches around every detected body for up to two hands, bodies in parallel. Returns the total number of hands found.
+	// foreZ must be the image last passed to detect().
+	unsigned int detectHands(const livescene::Image &foreZ) {return(detectHands(foreZ, livescene::Deadline()));}
+	// same, but bodies and hands not yet started when the deadline expires are skipped
+	unsigned int detectHands(const livescene::Image &foreZ, const livescene::Deadline &deadline);
+	// false if the last detectHands() skipped any body or hand for lack of time
+	bool getHandsFinished(void) const {return(_handsFinished);}
 
 private:
-	// returns true if it finds a minimum Z (closer than zThreshold) within the defined area
-	bool findMinimumZLocation(const livescene::Image &foreZ,
-		const unsigned int &Xlow, const unsigned int &Ylow, const unsigned int &Xhigh, const unsigned int &Yhigh,
-		const short &zThreshold, unsigned int &minZlocX, unsigned int &minZlocY, unsigned int &minZvalueZ);
-	// returns true if successful. WILL modify foreZtoDeplete during this process.
-	bool BodyMass::sampleAndDepleteAdjacentThresholded(livescene::Image &foreZtoDeplete, const signed int &thresholdZ, 
+	friend class HandSearch;
+
+	struct Body
+	{
+		livescene::ComponentStats component;
+		float centroid[3], // x,y,z
+			halfExtent[3]; // x,y,z
+		float handCentroid[2][3]; // Hand0:x,y,z Hand1:x,y,z
+		unsigned int numHands;
+		bool handsSearched; // false if detectHands() ran out of time before finishing this body
+	};
+
+	// per-body hand search state
+	struct SearchScratch
+	{
+		livescene::VisitedMask visited;
+		std::vector<unsigned int> seeds; // sample indices (Y * width + X) waiting to start a span
+		std::vector<unsigned short> rowMins; // ImageView::findMinZ()'s line minima
+	};
+
+	// detect(view) at full resolution, measuring _fullLabelRate on the way
+	unsigned int detectMeasured(const livescene::ImageView &foreZ, const livescene::Deadline &deadline);
+	// fills _bodies from labelled components, scaling them from the pyramid level they were labelled at
+	void setBodies(const std::vector<livescene::ComponentStats> &components, const unsigned int &level,
+		const unsigned int &parentWidth, const unsigned int &parentHeight);
+	// hand search for one body, see detectHands(). Safe to call concurrently for different bodies.
+	void detectBodyHands(const unsigned int &bodyNum, const livescene::Image &foreZ, const livescene::Deadline &deadline);
+	// returns true if successful. Marks the samples it takes in scratch.visited, foreZ is not modified.
+	bool sampleAdjacentThresholded(const livescene::Image &foreZ, SearchScratch &scratch,
+		const unsigned int &bodyLabel, const signed int &thresholdZ, 
 		const unsigned int &X, const unsigned int &Y, const short &Z,
-		float &weightedX, float &weightedY, float &weightedZ);
-	// called by sampleAndDepleteAdjacentThresholded to process one cell and its neighbors
-	void BodyMass::sampleAndDepleteOneCell(livescene::Image &foreZtoDeplete, CoordStack &searchStack,
-		const unsigned int &X, const unsigned int &Y, const short &Z, 
-		const signed int &thresholdZ, const signed int &maxZ,
-		float &runningX, float &runningY, float &runningZ, float &runningWeight);
-	void addToCoordStack(CoordStack &stack, const unsigned int &X, const unsigned int &Y, const short &Z);
-	bool _bodyPresent;
-	float _centroid[3], // x,y,z
-		_stdDev[3];  // x,y,z
-	float _handCentroid[2][3]; // Hand0:x,y,z Hand1:x,y,z
+		float &weightedX, float &weightedY, float &weightedZ) const;
+
+	livescene::ComponentLabeler _labeler;
+	livescene::ComponentLabeler _coarseLabeler; // for the first pass of a budgeted detect()
+	livescene::ImagePyramid _pyramid;
+	unsigned int _labelLevel;
+	unsigned int _labelMinX, _labelMinY, _labelEndX, _labelEndY; // view the last detect() searched, in parent image space
+	double _fullLabelRate; // milliseconds per sample of the last full resolution labelling a budgeted detect() timed, 0 if none
+	bool _detectFinished, _handsFinished;
+	std::vector<Body> _bodies;
+	std::vector<SearchScratch> _searchScratch; // one per body, kept from frame to frame
+	unsigned int _handGapBridge;
+	static const float _none[3];
 
 }; // BodyMass
 
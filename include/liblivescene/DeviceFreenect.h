@@ -7,7 +7,9 @@
 #include "liblivescene/Device.h"
 #include "liblivescene/DeviceFactory.h"
 #include "liblivescene/DeviceCapabilities.h"
+#include "liblivescene/DepthConversion.h"
 #include <string>
+#include <vector>
 #include <libfreenect.h>
 
 
@@ -140,7 +142,7 @@ class LIVESCENE_EXPORT DeviceFreenect : public DeviceBase, public DeviceCapabili
 
 		// From DeviceCapabilitiesImage
 		/** Synchronously gets an image using the specified format and fills in width, height, depth and data.
-		Returns true if successful. */
+		DEPTH_MM_16 is captured as 11-bit and converted with a DepthConversion table. Returns true if successful. */
 		bool getImageSync(livescene::Image &image);
 
 		/** Asynchronously sets an image using the specified format and fills in width, height, depth and data.
@@ -180,6 +182,8 @@ class LIVESCENE_EXPORT DeviceFreenect : public DeviceBase, public DeviceCapabili
 		int _freenect_led;
 		DeviceFreenectFactory *_hostFactory;
 		int _defaultWidth, _defaultHeight, _defaultRGBdepth, _defaultZdepth;
+		livescene::DepthConversion _depthConversion; // for DEPTH_MM_16
+		std::vector<unsigned short> _millimetersBuffer;
 
 }; // DeviceFreenect
 
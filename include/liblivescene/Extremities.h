@@ -0,0 +1,114 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#ifndef __LIVESCENE_EXTREMITIES_H__
+#define __LIVESCENE_EXTREMITIES_H__ 1
+
+#include "liblivescene/Export.h"
+#include "liblivescene/Image.h"
+#include "liblivescene/ComponentLabeler.h"
+#include <vector>
+
+
+namespace livescene {
+
+class BodyMass;
+
+
+/** \addtogroup Detect */
+/*@{*/
+
+/** \brief One end of a body: a sample geodesically far from the rest of it. Coordinates are in parent image space. */
+
+struct LIVESCENE_EXPORT Extremity
+{
+public:
+	enum Type {
+		HAND,
+		HEAD,
+		FOOT
+	};
+
+	Extremity() : type(HAND), geodesicDistance(0.0f) {position[0] = position[1] = position[2] = 0.0f;}
+
+	Type type;
+	float position[3]; // x,y,z
+	float geodesicDistance; // in samples, from the body centroid or the nearest earlier extremity
+}; // Extremity
+
+
+/** \brief Finds hands, head and feet as the geodesic extremes of a body.
+
+The body is treated as a graph of its samples (one ComponentLabeler component), each connected
+to its 8 neighbors unless the depth step between them is larger than the labeller's continuity.
+Orthogonal steps cost 2 and diagonal ones 3, a close integer approximation of Euclidean length,
+so shortest paths can be found with a bucket queue (Dial's algorithm): a ring of four buckets,
+no heap, and every sample settled once.
+
+The first search starts at the body sample nearest the centroid. The sample farthest from it
+is the first extremity, and is added as a further source: the next search only touches samples
+that are now closer to it than to anything before, and the new farthest sample is the next
+extremity. This repeats until getMaxExtremities() are found or the farthest remaining sample is
+nearer than getMinExtremityDistance() of the body height. Work is bounded by the body's sample
+count per extremity, whatever the pose, so a hand held out to the side or above the head is
+found as readily as one held forward.
+
+Extremities are typed by where they lie relative to the body centroid and spread: the highest
+one centered above the shoulders is the head, ones well below the centroid are feet, the rest
+are hands. These are candidates, not a skeleton.
+
+The distance buffer covers the body's bounding box and is kept between calls.
+*/
+
+class LIVESCENE_EXPORT ExtremityDetector
+{
+	public:
+		ExtremityDetector(const unsigned int maxExtremities = 5, const float minExtremityDistance = 0.15f)
+			: _maxExtremities(maxExtremities), _minExtremityDistance(minExtremityDistance),
+			_boundsX(0), _boundsY(0), _boundsWidth(0), _boundsHeight(0) {}
+
+		void setMaxExtremities(const unsigned int maxExtremities) {_maxExtremities = maxExtremities;}
+		unsigned int getMaxExtremities(void) const {return(_maxExtremities);}
+		// as a fraction of the body's height
+		void setMinExtremityDistance(const float minExtremityDistance) {_minExtremityDistance = minExtremityDistance;}
+		float getMinExtremityDistance(void) const {return(_minExtremityDistance);}
+
+		// finds the extremities of one labelled component of foreZ. labeler must hold the labels of foreZ.
+		// Returns the number found, farthest first.
+		unsigned int detect(const livescene::Image &foreZ, const livescene::ComponentLabeler &labeler, const livescene::ComponentStats &body);
+		// same, for a body found by BodyMass::detect(). Finds nothing if detect() ran out of time before full resolution.
+		unsigned int detect(const livescene::Image &foreZ, const livescene::BodyMass &bodies, const unsigned int &bodyNum);
+
+		const std::vector<livescene::Extremity> &getExtremities(void) const {return(_extremities);}
+		unsigned int getNumExtremities(void) const {return(_extremities.size());}
+
+		// geodesic distance in samples of a body sample from the nearest source after the last detect(), or -1 if unreached
+		float getGeodesicDistance(const unsigned int &X, const unsigned int &Y) const;
+
+	private:
+		enum {UNREACHED = 0xffffffff};
+
+		// runs the bucket queue from one more source, lowering distances where it is closer
+		void propagate(const livescene::Image &foreZ, const livescene::ComponentLabeler &labeler, const unsigned int &bodyLabel,
+			const unsigned int &sourceIndex);
+		// index of the farthest reached sample in the bounding box, and its distance
+		unsigned int findFarthest(unsigned int &farthestDistance) const;
+
+		unsigned int _maxExtremities;
+		float _minExtremityDistance;
+
+		std::vector<livescene::Extremity> _extremities;
+		// step-cost distances (an orthogonal step is 2) over the body's bounding box, kept between calls
+		std::vector<unsigned int> _distances;
+		std::vector<unsigned int> _buckets[4];
+		unsigned int _boundsX, _boundsY, _boundsWidth, _boundsHeight;
+
+}; // ExtremityDetector
+
+/*@}*/
+
+
+// namespace livescene
+}
+
+// __LIVESCENE_EXTREMITIES_H__
+#endif
@@ -19,6 +19,11 @@ namespace livescene {
 
 /** \brief Class for managing the data responsibility associated with creating geometry objects/vertices/normals/texcoords
 
+buildFaces() and buildFacesSimple() mesh bands of lines in parallel. A first pass counts each
+band's triangles and the vertices it uses first, a running sum of the counts gives each band its
+own stretch of the output arrays, and a second pass fills them. A sample shared with the band
+above belongs to whichever band uses it first in line order, so the output is identical to
+meshing the whole image line by line, whatever the number of threads.
 */
 
 class LIVESCENE_EXPORT Geometry
@@ -32,7 +37,7 @@ public:
 	} GeometryEntityType;
 
 	Geometry() : _entityType(GEOMETRY_UNKNOWN),
-		_vertices(0), _indices(0), _indicesTempBuffer(0), _normals(0), _texcoord(0),
+		_vertices(0), _indices(0), _indicesTempBuffer(0), _cellsTempBuffer(0), _normals(0), _texcoord(0),
 		_numVertices(0), _numIndices(0), _numNormals(0), _numTexCoords(0),
 		_numVerticesAllocated(0), _numIndicesAllocated(0), _numNormalsAllocated(0), _numTexCoordsAllocated(0),
 		_width(0), _height(0), _meshEpsilonPercent(.015f) {}
@@ -74,10 +79,19 @@ public:
 	This variant is less sophisticated about making "nice" geometry and should be faster. */
 	bool buildFacesSimple(const livescene::Image &imageZ, const livescene::Image * const imageRGB);
 
+	/** Region-of-interest variants of the above. Only samples inside the imageZ view are meshed, but vertices
+	and texcoords stay in whole-image space so the results line up with full-frame geometry. */
+	bool buildPointCloud(const livescene::ImageView &imageZ, const livescene::Image * const imageRGB);
+	bool buildFaces(const livescene::ImageView &imageZ, const livescene::Image * const imageRGB);
+	bool buildFacesSimple(const livescene::ImageView &imageZ, const livescene::Image * const imageRGB);
+
 private:
+	friend class FaceBands;
+
 	short *_vertices;
 	unsigned int *_indices;
 	unsigned int *_indicesTempBuffer; // tempbuffer is used to record which index a vertex/tx has already been recorded at (for reuse)
+	unsigned char *_cellsTempBuffer; // CELL_ triangles of each mesh cell, recorded while counting so they aren't worked out twice
 	float *_normals;
 	float *_texcoord;
 	int _width, _height;
@@ -91,9 +105,54 @@ private:
 	void allocData(const unsigned int &numVert, const unsigned int &numId, const unsigned int &numTex, const unsigned int &numNorm);
 	void freeTempBuffer(void);
 	void allocTempBuffer(void);
-	void clearTempBuffer(const unsigned int &_clearValue);
+	void clearTempBuffer(const unsigned int &_clearValue, const livescene::ImageView &region);
+	// shared by buildFaces() and buildFacesSimple()
+	bool buildFacesBanded(const livescene::ImageView &imageZ, const bool &simple);
+
+	// triangles a mesh cell can form, named by their corners in the order they are emitted
+	enum
+	{
+		CELL_UL_LL_LR = 1,
+		CELL_UL_LR_UR = 2,
+		CELL_UL_LL_UR = 4,
+		CELL_LL_UR_LR = 8
+	};
+
+	// Which triangles the cell with these corner depths forms, as CELL_ bits.
+	// Cells are normally split into two triangles with the split running UL-LR.
+	// If that's not possible, but one triangle can be formed with the split
+	// running LL-UR, it is, unless simple is set. This reduces sawtooth edges
+	// along borders between data and no-data.
+	inline unsigned int classifyCell(const livescene::ImageView &imageZ, const short &depthUL, const short &depthUR,
+		const short &depthLL, const short &depthLR, const bool &simple) const
+	{
+		unsigned int cell(0);
+		// is top-left sample of mesh cell non-rejected?
+		if(imageZ.isCellValueValid(depthUL))
+		{
+			// is LR vertex valid, allowing for potentially both polygons split UL<->LR?
+			if(imageZ.isCellValueValid(depthLR))
+			{
+				// is LL valid, allowing UL, LL, LR?
+				if(imageZ.isCellValueValid(depthLL) && isTriRangeMeshable(depthUL, depthLL, depthLR))
+					cell |= CELL_UL_LL_LR;
+				// is UR valid, allowing UL, LR, UR?
+				if(imageZ.isCellValueValid(depthUR) && isTriRangeMeshable(depthUL, depthLR, depthUR))
+					cell |= CELL_UL_LR_UR;
+			} // if
+			// are at least UR and LL left valid, allowing one UL, LL, UR?
+			else if(!simple && imageZ.isCellValueValid(depthLL) && imageZ.isCellValueValid(depthUR)
+				&& isTriRangeMeshable(depthUL, depthLL, depthUR))
+				cell = CELL_UL_LL_UR;
+		} // if
+		// we still might make a triangle out of UR, LR, LL if all are valid even if UL is NULL
+		else if(!simple && imageZ.isCellValueValid(depthLL) && imageZ.isCellValueValid(depthUR) && imageZ.isCellValueValid(depthLR)
+			&& isTriRangeMeshable(depthLL, depthUR, depthLR))
+			cell = CELL_LL_UR_LR;
+		return(cell);
+	}
 
-	inline bool isTriRangeMeshable(const short &valueA, const short &valueB, const short &valueC)
+	inline bool isTriRangeMeshable(const short &valueA, const short &valueB, const short &valueC) const
 	{
 		short delta = (short)((float)valueA * _meshEpsilonPercent);
 		short minZ, maxZ;
@@ -0,0 +1,154 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#ifndef __LIVESCENE_GESTURE_H__
+#define __LIVESCENE_GESTURE_H__ 1
+
+#include "liblivescene/Export.h"
+#include <string>
+#include <vector>
+#include <map>
+
+
+namespace livescene {
+
+
+/** \addtogroup Detect */
+/*@{*/
+
+/** \brief A gesture to look for, as the direction of motion in each frame at its usual speed.
+Steps are unit X,Y,Z directions in the recognizer's scaled space, Y down like the image.
+*/
+
+struct LIVESCENE_EXPORT GestureTemplate
+{
+public:
+	GestureTemplate() : id(0), tolerance(0.15f), minExtent(0.0f) {}
+
+	unsigned int getLength(void) const {return(steps.size() / 3);}
+	// appends one step, normalized
+	void addStep(const float &X, const float &Y, const float &Z);
+
+	// The factories set tolerance to suit the shape: 0.06 for swipes, which must not be confused with arcs
+	// of a circle, 0.25 for circles and 0.15 for push-pulls.
+
+	// a straight stroke along X, Y, Z (need not be normalized)
+	static GestureTemplate swipe(const std::string &name, const unsigned int &id, const float &X, const float &Y, const float &Z,
+		const unsigned int &frames, const float &minExtent);
+	// one turn in the X/Y plane, beginning at startAngle (radians, 0 along +X, increasing clockwise on screen)
+	static GestureTemplate circle(const std::string &name, const unsigned int &id, const bool &clockwise, const float &startAngle,
+		const unsigned int &frames, const float &minExtent);
+	// towards the sensor (-Z) and back again
+	static GestureTemplate pushPull(const std::string &name, const unsigned int &id, const unsigned int &frames, const float &minExtent);
+
+	std::string name;
+	unsigned int id; // reported with matches. Templates may share an id, e.g. one gesture begun at different points.
+	std::vector<float> steps; // X,Y,Z triples
+	float tolerance; // mean cost per matched frame allowed, 0 for a perfect match. A frame's cost is 1 - cos of its angle to the template step.
+	float minExtent; // least path length a match must cover
+}; // GestureTemplate
+
+
+/** \brief One recognized gesture. Frames count GestureRecognizer::update() calls since the last reset(). */
+
+struct LIVESCENE_EXPORT GestureMatch
+{
+public:
+	GestureMatch() : id(0), templateNum(0), startFrame(0), endFrame(0), distance(0.0f), extent(0.0f) {}
+
+	unsigned int id, templateNum;
+	unsigned int startFrame, endFrame; // inclusive
+	float distance; // summed cost of the match
+	float extent; // path length covered
+}; // GestureMatch
+
+
+/** \brief Recognizes gestures in a stream of positions, such as a tracked hand's.
+
+Each template is matched with streaming subsequence dynamic time warping (SPRING, Sakurai et al.
+2007): a gesture may start at any frame and be performed faster or slower than its template, and
+the best match is reported as soon as no later frame could improve on it. Positions are turned
+into per-frame motion, so gestures are found wherever they are made, and the cost of a frame is
+how far its direction is from the template step's, so they are found at any size. Frames with
+less motion than getMinStep() cost 1, as if at right angles.
+
+Every frame advances each template by one column of its warping matrix: each template keeps two
+columns of its own length, and nothing else grows with the length of the stream. Each frame may
+match a template step, repeat the last one (slower than the template) or skip one (up to twice as
+fast), so a match covers at least half the template's frames. Large template sets are updated in
+parallel, so adding templates doesn't have to add latency.
+
+A match must cost no more than the template's tolerance per frame and cover at least its
+minExtent. The cheapest match is usually the shortest one the warping allows, so minExtent is
+best set to about half the gesture's size, and getMinStep() is what keeps slow drift and jitter
+from being taken for gestures. Motion that carries on the way a match ended, like the rest of a long
+swipe, is part of that match, not the start of the next. A match whose id was already reported
+for an overlapping stretch of frames is dropped, so templates sharing an id report a motion once.
+*/
+
+class LIVESCENE_EXPORT GestureRecognizer
+{
+	public:
+		GestureRecognizer();
+
+		// returns the new template's number
+		unsigned int addTemplate(const livescene::GestureTemplate &gestureTemplate);
+		void clearTemplates(void);
+		unsigned int getNumTemplates(void) const {return(_templates.size());}
+		const livescene::GestureTemplate &getTemplate(const unsigned int &templateNum) const {return(_templates[templateNum].gesture);}
+
+		// positions are multiplied by these before use, e.g. to bring depth units near image units. Default 1, 1, 1.
+		void setScale(const float &X, const float &Y, const float &Z) {_scale[0] = X; _scale[1] = Y; _scale[2] = Z;}
+		const float *getScale(void) const {return(_scale);}
+		// frames moving less than this, after scaling, have no direction, so a resting hand's jitter doesn't look like motion. Default 2.
+		void setMinStep(const float &minStep) {_minStep = minStep;}
+		float getMinStep(void) const {return(_minStep);}
+
+		// forget the stream, e.g. when the hand is lost. Partial matches are dropped.
+		void reset(void);
+		// adds the next position (X,Y,Z). Returns the number of gestures recognized by this frame.
+		unsigned int update(const float *position);
+		// the gestures recognized by the last update(), in template order
+		const std::vector<livescene::GestureMatch> &getMatches(void) const {return(_matches);}
+		unsigned int getFrame(void) const {return(_frame);}
+
+	private:
+		friend class GestureBands;
+
+		struct TemplateState
+		{
+			livescene::GestureTemplate gesture;
+			// two columns of the warping matrix, indexed by template step, 0 being the virtual start
+			std::vector<float> distance[2], startExtent[2];
+			std::vector<unsigned int> start[2];
+			unsigned int column; // which of the two is current
+			bool haveCandidate, haveMatch;
+			bool continuing; // the motion still follows the last step of the last match
+			livescene::GestureMatch candidate; // best match so far, waiting to see if it can be improved on
+			livescene::GestureMatch match; // reported by this frame
+		};
+
+		// advances one template by the current frame. Safe to call concurrently for different templates.
+		void updateTemplate(TemplateState &state) const;
+		void resetTemplate(TemplateState &state) const;
+
+		std::vector<TemplateState> _templates;
+		std::vector<livescene::GestureMatch> _matches;
+		std::map<unsigned int, unsigned int> _lastMatchEnd; // by id
+
+		float _scale[3], _minStep;
+		bool _havePosition;
+		float _lastPosition[3], _direction[3]; // _direction is zero for frames without motion
+		float _extent; // path length so far
+		float _stepLength;
+		unsigned int _frame;
+
+}; // GestureRecognizer
+
+/*@}*/
+
+
+// namespace livescene
+}
+
+// __LIVESCENE_GESTURE_H__
+#endif
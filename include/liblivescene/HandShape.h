@@ -0,0 +1,162 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#ifndef __LIVESCENE_HANDSHAPE_H__
+#define __LIVESCENE_HANDSHAPE_H__ 1
+
+#include "liblivescene/Export.h"
+#include "liblivescene/Image.h"
+#include <vector>
+
+
+namespace livescene {
+
+class BodyMass;
+
+
+/** \addtogroup Detect */
+/*@{*/
+
+/** \brief A point on a hand contour, in parent image space. */
+
+struct LIVESCENE_EXPORT ContourPoint
+{
+public:
+	ContourPoint() : x(0), y(0) {}
+	ContourPoint(const int &newX, const int &newY) : x(newX), y(newY) {}
+
+	int x, y;
+}; // ContourPoint
+
+
+/** \brief A stretch of the contour that dips inside the convex hull, such as the gap between two fingers.
+start, end and deepest are indices into HandShape::getContour().
+*/
+
+struct LIVESCENE_EXPORT ConvexityDefect
+{
+public:
+	ConvexityDefect() : start(0), end(0), deepest(0), depth(0.0f) {}
+
+	unsigned int start, end, deepest;
+	float depth; // distance in samples of deepest from the hull edge start-end
+}; // ConvexityDefect
+
+
+/** \brief Fingertips and open/closed state of a hand, from its outline.
+
+Works on a small square window around a known hand centroid (e.g. BodyMass::getHandCentroid()),
+so it is cheap enough to run on every hand in every frame. Within the window, hand samples are
+those within getDepthTolerance() of the centroid's depth; the connected piece of them nearest
+the centroid is the hand.
+
+Its outer contour is traced (Moore neighborhood tracing, holes ignored) and its convex hull
+built (monotone chain) on the contour points, so hull vertices are contour indices. Between each
+pair of neighboring hull vertices the contour point farthest from the hull edge is a convexity
+defect. Defects deeper than getMinDefectDepth() of the hand radius, with an opening angle no
+wider than getMaxDefectAngle(), are the gaps between fingers, and their ends are fingertips.
+Ends on the window edge are cut-off wrist or arm, not fingers. With no such defect, a single
+contour point farther than getPointingDistance() radii from the hand centroid is a lone
+pointing finger.
+
+The hand is OPEN with getOpenFingertips() or more fingertips, CLOSED with none, and UNKNOWN in
+between or when too little of it is seen; callers should hold their previous state on UNKNOWN.
+getSolidity() (contour area over hull area) is also reported, near 1 for a fist.
+
+The hand radius is that of a disk of the hand's sample count. Working storage is kept between
+calls.
+*/
+
+class LIVESCENE_EXPORT HandShape
+{
+	public:
+		enum State {
+			UNKNOWN,
+			OPEN,
+			CLOSED
+		};
+
+		HandShape(const unsigned int windowHalfSize = 48, const unsigned short depthTolerance = 40);
+
+		// the window reaches this many samples to each side of the centroid. Default 48.
+		void setWindowHalfSize(const unsigned int windowHalfSize) {_windowHalfSize = windowHalfSize;}
+		unsigned int getWindowHalfSize(void) const {return(_windowHalfSize);}
+		// hand samples are within this depth, in image units, of the centroid. Default 40.
+		void setDepthTolerance(const unsigned short depthTolerance) {_depthTolerance = depthTolerance;}
+		unsigned short getDepthTolerance(void) const {return(_depthTolerance);}
+		// a finger gap is at least this deep, as a fraction of the hand radius. Default 0.4.
+		void setMinDefectDepth(const float minDefectDepth) {_minDefectDepth = minDefectDepth;}
+		float getMinDefectDepth(void) const {return(_minDefectDepth);}
+		// a finger gap opens no wider than this, in degrees. Default 90.
+		void setMaxDefectAngle(const float maxDefectAngle);
+		float getMaxDefectAngle(void) const {return(_maxDefectAngle);}
+		// a lone finger reaches at least this far from the hand centroid, in hand radii. Default 1.6.
+		void setPointingDistance(const float pointingDistance) {_pointingDistance = pointingDistance;}
+		float getPointingDistance(void) const {return(_pointingDistance);}
+		// an open hand shows at least this many fingertips. Default 3.
+		void setOpenFingertips(const unsigned int openFingertips) {_openFingertips = openFingertips;}
+		unsigned int getOpenFingertips(void) const {return(_openFingertips);}
+		// hands of fewer samples than this are UNKNOWN. Default 100.
+		void setMinSamples(const unsigned int minSamples) {_minSamples = minSamples;}
+		unsigned int getMinSamples(void) const {return(_minSamples);}
+
+		// analyzes the hand around handCentroid (x,y,z in image space). Returns the state.
+		State analyze(const livescene::Image &foreZ, const float *handCentroid);
+		// same, for a hand found by BodyMass::detectHands(). UNKNOWN if there is no such hand.
+		State analyze(const livescene::Image &foreZ, const livescene::BodyMass &bodies, const unsigned int &bodyNum, const unsigned int &handNum);
+
+		State getState(void) const {return(_state);}
+		unsigned int getNumFingertips(void) const {return(_fingertips.size() / 3);}
+		// x,y,z of a fingertip in image space, all zeros beyond getNumFingertips()
+		const float *getFingertip(const unsigned int &fingertipNum) const {return(fingertipNum < getNumFingertips() ? &_fingertips[fingertipNum * 3] : _none);}
+		float getSolidity(void) const {return(_solidity);}
+		// radius in samples of a disk as large as the hand
+		float getHandRadius(void) const {return(_handRadius);}
+
+		// outline of the hand, clockwise on screen, from the last analyze()
+		const std::vector<livescene::ContourPoint> &getContour(void) const {return(_contour);}
+		// convex hull vertices as indices into getContour(), in contour order
+		const std::vector<unsigned int> &getHull(void) const {return(_hull);}
+		// the finger gaps only
+		const std::vector<livescene::ConvexityDefect> &getDefects(void) const {return(_defects);}
+
+	private:
+		// marks the hand samples in the window and keeps the piece nearest the centroid. Returns its sample count.
+		unsigned int extractHand(const livescene::Image &foreZ, const float *handCentroid);
+		void traceContour(void);
+		void buildHull(void);
+		void findDefects(void);
+		void findFingertips(const livescene::Image &foreZ);
+		// true if the contour point lies on the edge of the window and so may be cut off
+		bool onWindowEdge(const livescene::ContourPoint &point) const;
+		bool isHand(const int &column, const int &line) const {return(column >= 0 && column < _windowWidth && line >= 0 && line < _windowHeight && _mask[line * _windowWidth + column] == HAND_SAMPLE);}
+
+		enum {OUTSIDE = 0, CANDIDATE = 1, HAND_SAMPLE = 2};
+
+		unsigned int _windowHalfSize;
+		unsigned short _depthTolerance;
+		float _minDefectDepth, _maxDefectAngle, _maxDefectCos, _pointingDistance;
+		unsigned int _openFingertips, _minSamples;
+
+		State _state;
+		float _solidity, _handRadius, _handCentroid[2];
+		std::vector<float> _fingertips; // x,y,z triples
+		std::vector<livescene::ContourPoint> _contour;
+		std::vector<unsigned int> _hull;
+		std::vector<livescene::ConvexityDefect> _defects;
+
+		// window in parent image space, and its mask of OUTSIDE/CANDIDATE/HAND_SAMPLE
+		int _windowX, _windowY, _windowWidth, _windowHeight;
+		std::vector<unsigned char> _mask;
+		std::vector<unsigned int> _stack;
+		static const float _none[3];
+
+}; // HandShape
+
+/*@}*/
+
+
+// namespace livescene
+}
+
+// __LIVESCENE_HANDSHAPE_H__
+#endif
@@ -28,6 +28,9 @@ public:
 	double getVariance(void) const {return ( (_samples > 1) ? m_newS / (_samples - 1) : 0.0 );}
 	unsigned long int getNumSamples(void) const {return(_samples);}
 	void clear(void) {_mean = 0.0; _min = 0.0; _max = 0.0; m_newS = 0.0; m_oldM = 0.0; m_oldS = 0.0; _samples = 0;}
+	// replaces the accumulated state with totals gathered elsewhere (e.g. in a fused image pass).
+	// addSample() can continue from there.
+	void setFromSums(const unsigned long int numSamples, const double sum, const double sumSquares, const double min, const double max);
 
 private:
 
@@ -50,8 +53,12 @@ typedef enum {
 	DEPTH_11BIT_PACKED    = 9, /**< 11 bit packed depth information */
 	DEPTH_10BIT_PACKED    = 10, /**< 10 bit packed depth information */
 	DEPTH_FLOAT_32_BIT    = 11, /**< single precision floats, only used for testing */
+	DEPTH_MM_16           = 12, /**< depth in millimeters in one uint16_t/pixel, NULL is 0. See DepthConversion */
 } VideoFormat;
 
+// true for the single-channel unsigned short depth formats the Z processing code operates on
+inline bool isDepthFormat(const VideoFormat format) {return(format == DEPTH_10BIT || format == DEPTH_11BIT || format == DEPTH_MM_16);}
+
 
 
 /** \brief Approve/reject callback functor base class.
@@ -67,6 +74,9 @@ class LIVESCENE_EXPORT ApproveCallback
 }; // ApproveCallback
 
 
+class ImageView; // defined below
+
+
 /** \brief Image core object.
 
 */
@@ -79,8 +89,8 @@ class LIVESCENE_EXPORT Image
 		/**  */
 		Image(const Image &image, bool cloneData = false); // copy constructor can make a local, persistent copy of the data
 		Image(int width = 640, int height = 480, int depth = 1, VideoFormat format = VIDEO_RGB)
-			: _width(width), _height(height), _depth(depth), _format(format), _timestamp(0), _nullValue(0), _data(0), _accumulation(1), _dataSelfAllocated(false),
-			_xStatValid(false), _yStatValid(false), _zStatValid(false)
+			: _width(width), _height(height), _depth(depth), _format(format), _timestamp(0), _generation(0), _nullValue(0), _data(0), _accumulation(1),
+			_dataSelfAllocated(false), _xStatValid(false), _yStatValid(false), _zStatValid(false)
 		{}
 		~Image();
 
@@ -98,11 +108,17 @@ class LIVESCENE_EXPORT Image
 		int getImageBytes(void) const {return(getWidth() * getHeight() * getDepth());}
 		unsigned long getTimestamp(void) const {return(_timestamp);}
 		void setTimestamp(const unsigned long Timestamp) {_timestamp = Timestamp;}
+		// generation changes whenever the pixel data does, so per-frame caches (ImagePyramid) can tell a rewritten buffer from
+		// the one they saw. Invalidating or replacing the internal stats, and Image's own editors, increase it. After writing
+		// the data some other way, through an ImageView say, increase it yourself.
+		unsigned long getGeneration(void) const {return(_generation);}
+		void increaseGeneration(void) {++_generation;}
 
 		// accumulation is used in averaging multiple frames together (limited by precision)
 		int getAccumulation(void) const {return(_accumulation);}
 		void increaseAccumulation(void) {++_accumulation;}
 		void clearAccumulation(void) {_accumulation = 1;} // no sense to have zero data recorded
+		void setAccumulation(const unsigned short accumulation) {_accumulation = accumulation;}
 
 		int getNull(void) const {return(_nullValue);}
 		void setNull(int newNull) {_nullValue = newNull;}
@@ -145,8 +161,11 @@ class LIVESCENE_EXPORT Image
 
 		// this calculates full-frame XYZ stats and stores them in the cached internal stats object to avoid unnecessary recalcs
 		bool calcInternalStatsXYZ(ApproveCallback *approveCallback = 0);
-		// mark internal stats as invalid
-		void invalidateInternalStats(void) {_xStatValid = _yStatValid = _zStatValid = false; _xStat.clear(); _yStat.clear(); _zStat.clear(); }
+		// stores stats calculated elsewhere (e.g. during background extraction) as the valid cached internal stats
+		void setInternalStatsXYZ(const livescene::ImageStatistics &statX, const livescene::ImageStatistics &statY, const livescene::ImageStatistics &statZ)
+			{_xStat = statX; _yStat = statY; _zStat = statZ; _xStatValid = _yStatValid = _zStatValid = true; ++_generation;}
+		// mark internal stats as invalid, because the data has changed
+		void invalidateInternalStats(void) {_xStatValid = _yStatValid = _zStatValid = false; _xStat.clear(); _yStat.clear(); _zStat.clear(); ++_generation;}
 		const livescene::ImageStatistics &getInternalStatsX(void) const {return(_xStat);}
 		const livescene::ImageStatistics &getInternalStatsY(void) const {return(_yStat);}
 		const livescene::ImageStatistics &getInternalStatsZ(void) const {return(_zStat);}
@@ -154,6 +173,10 @@ class LIVESCENE_EXPORT Image
 		// this will ensure the image is allocated to the proper size and ready to write to
 		bool preAllocate(void);
 
+		// non-owning views of the pixel data, see ImageView. Region is clamped to the image.
+		livescene::ImageView getView(void) const;
+		livescene::ImageView getView(const unsigned int &Xlow, const unsigned int &Ylow, const unsigned int &viewWidth, const unsigned int &viewHeight) const;
+
 	private:
 		void freeData(void);
 		void allocData(void);
@@ -163,6 +186,7 @@ class LIVESCENE_EXPORT Image
 		unsigned short _accumulation;
 		VideoFormat _format;
         unsigned long _timestamp;
+		unsigned long _generation;
 		void *_data; // this is not resource tracked or freed, it's just a dumb pointer for transport
 		bool _dataSelfAllocated;
 
@@ -174,6 +198,75 @@ class LIVESCENE_EXPORT Image
 
 
 
+/** \brief Non-owning, zero-copy view of a rectangular region of an Image.
+
+Carries a pointer to the first sample of the region, the region origin and size in the
+parent image, and the parent's stride so rows can be stepped without copying. Views are cheap
+to make and pass by value, and remain valid only as long as the parent's data buffer does.
+
+The Z kernels live here so they can be restricted to a region of interest, such as the
+bounding box of the foreground; the full-frame Image methods are just whole-image views.
+Coordinates passed to the kernels are relative to the view, coordinates reported back
+(stats, callbacks) are in parent image space so results from different views are comparable.
+Like a pointer, a const view still permits writing its samples.
+*/
+
+class LIVESCENE_EXPORT ImageView
+{
+	public:
+		ImageView() : _data(0), _originX(0), _originY(0), _width(0), _height(0), _stride(0), _parentWidth(0), _parentHeight(0),
+			_nullValue(0), _format(VIDEO_RGB) {}
+		ImageView(const Image &image); // whole image
+		ImageView(const Image &image, const unsigned int &Xlow, const unsigned int &Ylow, const unsigned int &viewWidth, const unsigned int &viewHeight); // clamped to image
+		ImageView(const ImageView &view, const unsigned int &Xlow, const unsigned int &Ylow, const unsigned int &viewWidth, const unsigned int &viewHeight); // sub-view, Xlow/Ylow relative to view, clamped to view
+
+		// makes a view from inclusive-low, exclusive-high bounds, matching the older *Bounded() APIs
+		static ImageView fromBounds(const Image &image, const unsigned int &Xlow, const unsigned int &Ylow, const unsigned int &Xhigh, const unsigned int &Yhigh);
+
+		unsigned short *getData(void) const {return(_data);} // first sample of the region
+		unsigned short *getRow(const unsigned int &line) const {return(_data + line * _stride);} // line is relative to the view
+		unsigned int getOriginX(void) const {return(_originX);}
+		unsigned int getOriginY(void) const {return(_originY);}
+		unsigned int getWidth(void) const {return(_width);}
+		unsigned int getHeight(void) const {return(_height);}
+		unsigned int getStride(void) const {return(_stride);} // in samples, not bytes
+		unsigned int getParentWidth(void) const {return(_parentWidth);}
+		unsigned int getParentHeight(void) const {return(_parentHeight);}
+		int getSamples(void) const {return(getWidth() * getHeight());}
+		bool isEmpty(void) const {return(_data == 0 || _width == 0 || _height == 0);}
+		VideoFormat getFormat(void) const {return(_format);}
+		bool isZ(void) const {return(isDepthFormat(_format));}
+		int getNull(void) const {return(_nullValue);}
+		inline bool isCellValueValid(const unsigned short &value) const {return(value != (unsigned short)_nullValue);}
+
+		// Z kernels, see the matching Image methods for descriptions. Neighbor tests are clamped to the view.
+		void rewriteZeroToNull(void) const;
+		unsigned int filterNoise(const unsigned int &numNeighbors) const;
+		unsigned int countValidNeighbors(const unsigned int &X, const unsigned int &Y) const;
+		bool calcStatsXYZ(livescene::ImageStatistics *destStatsX, livescene::ImageStatistics *destStatsY, livescene::ImageStatistics *destStatsZ, ApproveCallback *approveCallback = 0) const;
+		bool calcHistogram(std::vector<unsigned long> &destHistogram) const;
+
+		// nearest query: finds the smallest valid sample no greater than zThreshold, and its location in parent image space.
+		// Ties go to the first in row-major order. approveCallback, if any, can reject candidates (e.g. already used, or
+		// noise), and the search carries on to the next nearest; it is only called on the calling thread.
+		// Each line is reduced to its minimum with SIMD, lines split into bands across numThreads for large views
+		// (0 uses getDefaultNumThreads()), and only lines whose minimum can win are revisited to recover the location.
+		// rowMins, if given, holds the line minima and is kept by the caller so repeated searches don't allocate.
+		// Returns false if nothing qualifies.
+		bool findMinZ(const unsigned short &zThreshold, unsigned int &minX, unsigned int &minY, unsigned short &minZ,
+			ApproveCallback *approveCallback = 0, const unsigned int numThreads = 0, std::vector<unsigned short> *rowMins = 0) const;
+
+	private:
+		unsigned short *_data;
+		unsigned int _originX, _originY, _width, _height, _stride;
+		unsigned int _parentWidth, _parentHeight;
+		int _nullValue;
+		VideoFormat _format;
+
+}; // ImageView
+
+
+
 /*@}*/
 
 
@@ -0,0 +1,103 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#ifndef __LIVESCENE_IMAGEPYRAMID_H__
+#define __LIVESCENE_IMAGEPYRAMID_H__ 1
+
+#include "liblivescene/Export.h"
+#include "liblivescene/Image.h"
+#include <vector>
+
+
+namespace livescene {
+
+
+/** \addtogroup Image */
+/*@{*/
+
+/** \brief Half-resolution levels of a Z Image, built on demand and cached per frame.
+
+Level 0 is the source image itself (not copied). Each further level halves the width and
+height of the one before it, reducing each 2x2 block of samples to one. The reduction is
+null-aware: NULL samples never contribute, and a block with no valid samples becomes NULL.
+
+Coarse levels allow analysis to search a much smaller raster first and only refine at full
+resolution near candidates. A sample at (X, Y) on level 0 lies in (X >> level, Y >> level)
+on a coarser level.
+
+The cache key is the source data pointer, generation (see Image::getGeneration()), timestamp,
+dimensions and format. Callers that rewrite a buffer in place through an ImageView must mark the
+Image with increaseGeneration(), or call invalidate() here, before the next build().
+*/
+
+class LIVESCENE_EXPORT ImagePyramid
+{
+	public:
+		/** Reduction used to collapse each 2x2 block into one coarser sample
+		*/
+		enum ReduceMode {
+			REDUCE_MIN,    // nearest valid sample, preserves thin near features like fingers
+			REDUCE_MEDIAN, // robust to single-sample noise
+			REDUCE_MEAN,   // rounded average of valid samples
+		};
+
+		ImagePyramid(ReduceMode mode = REDUCE_MIN, unsigned int numLevels = 3);
+		~ImagePyramid();
+
+		// changing either of these invalidates the cache
+		void setReduceMode(const ReduceMode mode) {if(mode != _mode) invalidate(); _mode = mode;}
+		ReduceMode getReduceMode(void) const {return(_mode);}
+		// number of levels to build below the source, so getLevel() accepts 0...numLevels
+		void setNumLevels(const unsigned int numLevels) {if(numLevels != _numLevels) invalidate(); _numLevels = numLevels;}
+		unsigned int getNumLevels(void) const {return(_numLevels);}
+
+		// builds all levels from a Z image, or does nothing if the cached levels already belong to this frame, as
+		// this image's data and generation. See the class description for edits the generation doesn't see.
+		// Levels stop early if they would become smaller than 1x1.
+		// returns false if the image is not a Z image
+		bool build(const livescene::Image &imageZ);
+		// builds only the part of each level under window, a view of imageZ, for callers that only look there. The samples
+		// built are the same as build() makes, the rest of each level is left as it was. Always recalculates, and leaves
+		// nothing cached for build() to reuse.
+		// returns false if the image is not a Z image or the window isn't of it
+		bool build(const livescene::Image &imageZ, const livescene::ImageView &window);
+
+		// forget the cached frame so the next build() recalculates
+		void invalidate(void) {_sourceData = 0; _numLevelsBuilt = 0;}
+
+		// number of usable levels including level 0, zero if nothing has been built
+		unsigned int getNumLevelsBuilt(void) const {return(_numLevelsBuilt);}
+
+		// level 0 is the source image passed to build(), and is only valid as long as it is
+		const livescene::Image &getLevel(const unsigned int level) const;
+
+	private:
+		ImagePyramid(const ImagePyramid &); // not copyable, owns its level buffers
+		ImagePyramid & operator= (const ImagePyramid &);
+
+		// reduces the dest samples in minX...endX, minY...endY (exclusive ends)
+		void reduceLevel(const livescene::Image &source, livescene::Image &dest,
+			const unsigned int &minX, const unsigned int &minY, const unsigned int &endX, const unsigned int &endY) const;
+		void allocateLevels(const livescene::Image &imageZ);
+		void freeLevels(void);
+
+		ReduceMode _mode;
+		unsigned int _numLevels, _numLevelsBuilt, _numLevelsAllocated;
+		std::vector<livescene::Image *> _levels; // coarser levels, _levels[0] is pyramid level 1
+
+		// cache key of the source last built from
+		const livescene::Image *_source;
+		const void *_sourceData;
+		unsigned long _sourceGeneration, _sourceTimestamp;
+		unsigned int _sourceWidth, _sourceHeight;
+		VideoFormat _sourceFormat;
+
+}; // ImagePyramid
+
+/*@}*/
+
+
+// namespace livescene
+}
+
+// __LIVESCENE_IMAGEPYRAMID_H__
+#endif
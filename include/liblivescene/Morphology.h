@@ -0,0 +1,80 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#ifndef __LIVESCENE_MORPHOLOGY_H__
+#define __LIVESCENE_MORPHOLOGY_H__ 1
+
+#include "liblivescene/Export.h"
+#include "liblivescene/Image.h"
+#include <vector>
+
+
+namespace livescene {
+
+
+/** \addtogroup Image */
+/*@{*/
+
+/** \brief Rectangular-kernel erode, dilate, open and close for foreground masks and depth.
+
+Uses the van Herk/Gil-Werman algorithm: each 1D pass costs three min/max operations per sample
+no matter how large the kernel is. The 2D kernel is separable, so a horizontal pass over rows is
+followed by a vertical pass that works on whole rows at a time, which keeps the inner loops
+contiguous and lets the compiler vectorize them. Both passes are split into bands with
+runBandsParallel().
+
+Masks are byte planes where non-zero is set. Erode shrinks set regions (min filter), dilate
+grows them (max filter). Outside the image counts as neither, so set regions touching the edge
+are not eroded away from it.
+
+Depth operations work on the foreground silhouette of a Z view: NULL is treated as infinitely
+far. Erode shrinks the silhouette (a sample becomes the farthest of its neighborhood, so NULL if
+any neighbor is NULL), dilate grows it (the nearest valid neighbor), and nearer surfaces win at
+depth edges. Opening removes speckle and thin protrusions smaller than the kernel, closing fills
+small holes and gaps.
+
+Operations are in place. Scratch buffers are kept between calls, so one Morphology object per
+pipeline stage avoids reallocating every frame. Not safe to call concurrently on one object.
+*/
+
+class LIVESCENE_EXPORT Morphology
+{
+	public:
+		// kernel is (2 * radiusX + 1) by (2 * radiusY + 1). numThreads of 0 uses getDefaultNumThreads().
+		Morphology(const unsigned int radiusX = 1, const unsigned int radiusY = 1, const unsigned int numThreads = 0)
+			: _radiusX(radiusX), _radiusY(radiusY), _numThreads(numThreads) {}
+
+		void setRadius(const unsigned int radiusX, const unsigned int radiusY) {_radiusX = radiusX; _radiusY = radiusY;}
+		unsigned int getRadiusX(void) const {return(_radiusX);}
+		unsigned int getRadiusY(void) const {return(_radiusY);}
+		void setNumThreads(const unsigned int numThreads) {_numThreads = numThreads;}
+		unsigned int getNumThreads(void) const {return(_numThreads);}
+
+		// binary masks. stride is in bytes.
+		void erodeMask(unsigned char *mask, const unsigned int &width, const unsigned int &height, const unsigned int &stride);
+		void dilateMask(unsigned char *mask, const unsigned int &width, const unsigned int &height, const unsigned int &stride);
+		void openMask(unsigned char *mask, const unsigned int &width, const unsigned int &height, const unsigned int &stride);
+		void closeMask(unsigned char *mask, const unsigned int &width, const unsigned int &height, const unsigned int &stride);
+
+		// grey-level on a Z view, NULL-aware as described above. Return false if the view isn't Z.
+		bool erodeDepth(const livescene::ImageView &imageZ);
+		bool dilateDepth(const livescene::ImageView &imageZ);
+		bool openDepth(const livescene::ImageView &imageZ);
+		bool closeDepth(const livescene::ImageView &imageZ);
+
+	private:
+		unsigned int _radiusX, _radiusY, _numThreads;
+
+		// horizontal pass output, and the vertical pass's running min/max planes
+		std::vector<unsigned char> _maskIntermediate, _maskForward, _maskBackward;
+		std::vector<unsigned short> _depthIntermediate, _depthForward, _depthBackward;
+
+}; // Morphology
+
+/*@}*/
+
+
+// namespace livescene
+}
+
+// __LIVESCENE_MORPHOLOGY_H__
+#endif
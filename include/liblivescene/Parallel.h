@@ -0,0 +1,70 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#ifndef __LIVESCENE_PARALLEL_H__
+#define __LIVESCENE_PARALLEL_H__ 1
+
+#include "liblivescene/Export.h"
+#include <vector>
+
+
+namespace livescene {
+
+
+/** \defgroup Parallel Parallel Processing */
+/*@{*/
+
+/** \brief Band callback functor base class.
+Processes the half-open range [begin, end) of some list of items, typically image lines or columns.
+Called concurrently for disjoint ranges, so implementations must only write state owned by their range.
+*/
+
+class LIVESCENE_EXPORT BandCallback
+{
+	public:
+		virtual ~BandCallback() {}
+		virtual void operator ()(const unsigned int &begin, const unsigned int &end) = 0; // must be overridden
+}; // BandCallback
+
+
+/** \brief Splits [0, numItems) into contiguous bands and runs callback on each concurrently.
+The calling thread processes the first band itself, and the call returns once all bands are done.
+The other bands run on worker threads that are started on first use and kept, so calls are cheap
+enough to make many times a frame. Bands may themselves call runBandsParallel().
+Bands are never smaller than minItemsPerBand, so small images don't pay thread overhead for nothing.
+numThreads of 0 uses getDefaultNumThreads(). With one band, callback runs directly with no threads involved.
+*/
+LIVESCENE_EXPORT void runBandsParallel(livescene::BandCallback &callback, const unsigned int &numItems,
+	unsigned int numThreads = 0, const unsigned int &minItemsPerBand = 16);
+
+/** \brief Span callback functor base class, for work split into tiles.
+Processes columns [beginColumn, endColumn) of one line. Called concurrently for spans of different tiles.
+*/
+
+class LIVESCENE_EXPORT SpanCallback
+{
+	public:
+		virtual ~SpanCallback() {}
+		virtual void operator ()(const unsigned int &line, const unsigned int &beginColumn, const unsigned int &endColumn) = 0; // must be overridden
+}; // SpanCallback
+
+
+/** \brief Runs callback on every line span of the listed tiles, with the list split into bands as runBandsParallel() does.
+Tiles are tileSize square and numbered row-major over a width by height area, (width + tileSize - 1) / tileSize to a row.
+Tiles on the right and bottom edges are clipped to the area. Each tile is done top to bottom.
+*/
+LIVESCENE_EXPORT void runTilesParallel(livescene::SpanCallback &callback, const std::vector<unsigned int> &tiles, const unsigned int &tileSize,
+	const unsigned int &width, const unsigned int &height, unsigned int numThreads = 0);
+
+// number of threads used when 0 is requested. Initially the number of processors.
+LIVESCENE_EXPORT unsigned int getDefaultNumThreads(void);
+// 0 restores the processor count
+LIVESCENE_EXPORT void setDefaultNumThreads(const unsigned int numThreads);
+
+/*@}*/
+
+
+// namespace livescene
+}
+
+// __LIVESCENE_PARALLEL_H__
+#endif
@@ -0,0 +1,50 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#ifndef __LIVESCENE_SIMD_H__
+#define __LIVESCENE_SIMD_H__ 1
+
+// Selects the SSE2 code paths where the compiler targets it, which is every x86-64 build and
+// 32-bit builds with SSE2 enabled. Everything else uses the scalar paths, which compute the same results.
+// Define LIVESCENE_NO_SIMD to force the scalar paths, e.g. to compare them.
+
+#if !defined( LIVESCENE_NO_SIMD ) && ( defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) )
+    #define LIVESCENE_SSE2 1
+    #include <emmintrin.h>
+#endif
+
+
+namespace livescene {
+
+/** \addtogroup Image */
+/*@{*/
+
+// number of set bits, for turning SIMD comparison masks into counts
+inline unsigned int countBits(unsigned int bits)
+{
+	bits = bits - ((bits >> 1) & 0x55555555);
+	bits = (bits & 0x33333333) + ((bits >> 2) & 0x33333333);
+	return((((bits + (bits >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24);
+} // countBits
+
+// index of the lowest/highest set bit. bits must not be zero.
+inline unsigned int lowestBit(unsigned int bits)
+{
+	unsigned int index(0);
+	while(!(bits & 1)) {bits >>= 1; ++index;}
+	return(index);
+} // lowestBit
+
+inline unsigned int highestBit(unsigned int bits)
+{
+	unsigned int index(0);
+	while(bits >>= 1) ++index;
+	return(index);
+} // highestBit
+
+/*@}*/
+
+// namespace livescene
+}
+
+// __LIVESCENE_SIMD_H__
+#endif
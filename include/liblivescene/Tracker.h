@@ -0,0 +1,173 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#ifndef __LIVESCENE_TRACKER_H__
+#define __LIVESCENE_TRACKER_H__ 1
+
+#include "liblivescene/Export.h"
+#include "liblivescene/Image.h"
+#include "liblivescene/Detect.h"
+#include <vector>
+
+
+namespace livescene {
+
+
+/** \addtogroup Detect */
+/*@{*/
+
+/** \brief Constant-velocity Kalman filter for one coordinate.
+State is position and velocity, time steps are one frame. Process noise is the variance of the
+acceleration the target may make per frame, measurement noise the variance of the detector.
+*/
+
+class LIVESCENE_EXPORT KalmanFilterCV
+{
+	public:
+		KalmanFilterCV(const float processNoise = 1.0f, const float measurementNoise = 4.0f)
+			: _processNoise(processNoise), _measurementNoise(measurementNoise) {reset(0.0f);}
+
+		void setNoise(const float processNoise, const float measurementNoise) {_processNoise = processNoise; _measurementNoise = measurementNoise;}
+
+		// starts over at position, at rest, with the detector's uncertainty in position and a large one in velocity
+		void reset(const float position);
+		// advances the state one frame
+		void predict(void);
+		// blends in a measurement of the position
+		void correct(const float measurement);
+
+		float getPosition(void) const {return(_position);}
+		float getVelocity(void) const {return(_velocity);}
+		float getPositionVariance(void) const {return(_p00);}
+
+	private:
+		float _processNoise, _measurementNoise;
+		float _position, _velocity;
+		float _p00, _p01, _p11; // covariance, symmetric
+}; // KalmanFilterCV
+
+
+/** \brief An X, Y, Z point filtered with one KalmanFilterCV per axis. */
+
+class LIVESCENE_EXPORT TrackedPoint
+{
+	public:
+		TrackedPoint() {_position[0] = _position[1] = _position[2] = 0.0f;}
+
+		void setNoise(const float processNoise, const float measurementNoise);
+		void reset(const float *position);
+		void predict(void);
+		void correct(const float *measurement);
+
+		const float *getPosition(void) const {return(_position);}
+		float getVelocity(const unsigned int axis) const {return(_axes[axis].getVelocity());}
+
+	private:
+		void updatePosition(void) {for(unsigned int axis = 0; axis < 3; ++axis) _position[axis] = _axes[axis].getPosition();}
+
+		livescene::KalmanFilterCV _axes[3];
+		float _position[3];
+}; // TrackedPoint
+
+
+/** \brief Follows bodies and their hands from frame to frame.
+
+Each tracked body and hand has a constant-velocity Kalman filter that predicts where it will be
+in the next frame. Detection (BodyMass) then only labels a window around the predicted bodies,
+so once bodies are being tracked the cost follows their size rather than the frame's. The whole
+frame is searched when nothing is tracked, when a track was missed in the previous frame, and
+every getGlobalSearchInterval() frames to pick up newcomers.
+
+Detections are matched to the nearest predicted body within a gate of a few body widths. Tracks
+that go unmatched coast on their prediction for up to getMaxMissedFrames() frames before being
+dropped, and unmatched detections start new tracks. Hands are matched to their body's two hand
+slots the same way.
+
+The getters match BodyMass but report filtered positions, which jitter much less than raw
+detections. Bodies are in track order, oldest first, and each keeps its ID for as long as it is
+tracked. Positions are in image space: X and Y in samples, Z in the units of the image.
+*/
+
+class LIVESCENE_EXPORT BodyTracker
+{
+	public:
+		BodyTracker();
+
+		// forget all tracks, e.g. when there is no foreground
+		void clear(void);
+		// predicts, detects and corrects. Returns the number of bodies tracked.
+		unsigned int update(const livescene::Image &foreZ) {return(update(foreZ, livescene::Deadline()));}
+		// same, with detection working coarse to fine within deadline (see BodyMass). Tracks are still
+		// predicted and corrected with whatever was detected in time.
+		unsigned int update(const livescene::Image &foreZ, const livescene::Deadline &deadline);
+
+		bool getBodyPresent(void) const {return(!_tracks.empty());}
+		unsigned int getNumBodies(void) const {return(_tracks.size());}
+		// bodyNum beyond getNumBodies() gives 0 or all zeros
+		unsigned int getBodyID(unsigned int bodyNum) const {return(bodyNum < _tracks.size() ? _tracks[bodyNum].id : 0);}
+		const float *getBodyCentroid(unsigned int bodyNum) const {return(bodyNum < _tracks.size() ? _tracks[bodyNum].body.getPosition() : _none);}
+		const float *getBodyHalfExtent(unsigned int bodyNum) const {return(bodyNum < _tracks.size() ? _tracks[bodyNum].halfExtent : _none);}
+		float getBodyVelocity(unsigned int bodyNum, const unsigned int axis) const {return(bodyNum < _tracks.size() ? _tracks[bodyNum].body.getVelocity(axis) : 0.0f);}
+		// hands are numbered in slot order among those tracked, so a hand keeps its number while both are tracked
+		unsigned int getNumHands(unsigned int bodyNum) const;
+		const float *getHandCentroid(unsigned int bodyNum, unsigned int handNum) const;
+
+		// true if the last update() searched the whole frame rather than a predicted window
+		bool getLastSearchGlobal(void) const {return(_lastSearchGlobal);}
+		// false if the last update() ran out of time for full resolution bodies or for some hands
+		bool getLastUpdateFinished(void) const {return(_detector.getDetectFinished() && _detector.getHandsFinished());}
+
+		// frames between whole-frame searches while bodies are tracked, 0 to always search the whole frame. Default 30.
+		void setGlobalSearchInterval(const unsigned int frames) {_globalSearchInterval = frames;}
+		unsigned int getGlobalSearchInterval(void) const {return(_globalSearchInterval);}
+		// frames a track may go undetected before it is dropped. Default 5.
+		void setMaxMissedFrames(const unsigned int frames) {_maxMissedFrames = frames;}
+		unsigned int getMaxMissedFrames(void) const {return(_maxMissedFrames);}
+		// the window around each predicted body grows by this fraction of its size on every side. Default 0.25.
+		void setWindowMargin(const float fraction) {_windowMargin = fraction;}
+		float getWindowMargin(void) const {return(_windowMargin);}
+		// filter noise for new tracks, see KalmanFilterCV. Defaults 1 and 4.
+		void setNoise(const float processNoise, const float measurementNoise) {_processNoise = processNoise; _measurementNoise = measurementNoise;}
+
+		// the detector, to configure it
+		livescene::BodyMass &getDetector(void) {return(_detector);}
+		const livescene::BodyMass &getDetector(void) const {return(_detector);}
+
+	private:
+		struct Track
+		{
+			unsigned int id;
+			livescene::TrackedPoint body;
+			float halfExtent[3];
+			float measuredCentroid[3]; // centroid and bounds of the last detection, for the search window
+			unsigned int minX, minY, maxX, maxY;
+			unsigned int missed;
+			livescene::TrackedPoint hands[2];
+			bool handTracked[2];
+			unsigned int handMissed[2];
+		};
+
+		// window around the predicted bodies, in parent image space, clamped to the image
+		livescene::ImageView predictedWindow(const livescene::Image &foreZ) const;
+		void startTrack(const unsigned int &detection);
+		void correctTrack(Track &track, const unsigned int &detection);
+		void updateHands(Track &track, const unsigned int &detection);
+		void missHands(Track &track);
+
+		livescene::BodyMass _detector;
+		std::vector<Track> _tracks;
+		unsigned int _nextID, _framesSinceGlobal;
+		bool _lostTrack, _lastSearchGlobal;
+		unsigned int _globalSearchInterval, _maxMissedFrames;
+		float _windowMargin, _processNoise, _measurementNoise;
+		static const float _none[3];
+
+}; // BodyTracker
+
+/*@}*/
+
+
+// namespace livescene
+}
+
+// __LIVESCENE_TRACKER_H__
+#endif
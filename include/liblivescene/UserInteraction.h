@@ -5,6 +5,8 @@
 
 #include <liblivescene/Export.h>
 #include <liblivescene/Image.h>
+#include <liblivescene/HandShape.h>
+#include <liblivescene/Gesture.h>
 
 #include <osgViewer/GraphicsWindow>
 #include <osg/Vec2s>
@@ -52,6 +54,7 @@ public:
         osg::Vec3 _worldCoord; // Currently unused.
         unsigned int _age; // Count of frames this Interactor has existed.
         bool _active; // Enabled or disables.
+        livescene::HandShape::State _handState; // Open or closed, if grab detection is on.
     };
     typedef std::vector< Interactor > InteractorContainer;
 
@@ -87,6 +90,11 @@ public:
     Compares \c newInteractors to \c lastInteractors to generate events.
     Interactors that did not previously exist generate PUSH events.
     Interactors that no longer exist generate RELEASE events.
+    Gestures recognized this frame are sent as mapped by the ContactEventMap,
+    if gesture detection is on.
+    Without grab detection, an Interactor that goes inactive within
+    getDefaultSendEventsPunchMaxAge() frames of going active is a PUNCH
+    instead of a RELEASE. With grab detection there are no PUNCH events.
     */
     LIVESCENE_EXPORT void defaultSendEvents( InteractorContainer& lastInteractors, InteractorContainer& newInteractors );
 
@@ -113,12 +121,22 @@ public:
 
 
     /** If using the defaultSendEvents, specify the mapping of interactions to events.
+    Gestures are sent as the event type they map to, named after the gesture
+    (see GestureTemplate::name). By default they all map to USER events.
+    Unmapped gestures aren't sent.
     */
     enum ContactType {
         CONTACT_START,
         MOTION,
         CONTACT_END,
-        PUNCH
+        PUNCH,
+        SWIPE_LEFT,
+        SWIPE_RIGHT,
+        SWIPE_UP,
+        SWIPE_DOWN,
+        CIRCLE_CLOCKWISE,
+        CIRCLE_COUNTERCLOCKWISE,
+        PUSH_PULL
     };
     typedef std::map< ContactType, osgGA::GUIEventAdapter::EventType > ContactEventMap;
 
@@ -144,6 +162,33 @@ public:
     LIVESCENE_EXPORT void setDefaultSendEventsPunchMaxAge( unsigned int age );
     LIVESCENE_EXPORT unsigned int getDefaultSendEventsPunchMaxAge() const;
 
+    /** If enabled, defaultDetection makes an Interactor active when the hand
+    is closed (a grab) and inactive when it opens (a release), rather than
+    by its distance. The hand must still be within the detection threshold.
+    Off by default. See livescene::HandShape.
+    */
+    LIVESCENE_EXPORT void setDefaultGrabDetection( bool enable );
+    LIVESCENE_EXPORT bool getDefaultGrabDetection() const;
+    /** The hand shape analyzer used for grab detection, to tune it. */
+    LIVESCENE_EXPORT livescene::HandShape& getDefaultHandShape() { return( _handShape ); }
+
+    /** If enabled, gestures are recognized from the motion of the first
+    Interactor and sent by defaultSendEvents. Off by default, as it costs
+    time every frame.
+    */
+    LIVESCENE_EXPORT void setDefaultGestureDetection( bool enable );
+    LIVESCENE_EXPORT bool getDefaultGestureDetection() const;
+    /** Gestures are recognized from the motion of the first Interactor, as
+    the user sees it (x flipped as in transformMouse), in device coordinates.
+    Template ids are ContactTypes. By default there are swipes in four
+    directions, circles both ways and a push-pull. Add, replace or clear
+    templates here.
+    */
+    LIVESCENE_EXPORT livescene::GestureRecognizer& getGestureRecognizer() { return( _gestureRecognizer ); }
+    /** Gestures recognized in the current frame, for SendEventsCallbacks.
+    */
+    LIVESCENE_EXPORT const std::vector< livescene::GestureMatch >& getRecognizedGestures() const { return( _gestureRecognizer.getMatches() ); }
+
 
     /** Search the list of \c interactors and return the one closest to
     the given distance.
@@ -183,6 +228,11 @@ protected:
     unsigned short _defaultActiveThreshold;
     int _defaultSendEventsButton;
     unsigned int _defaultSendEventsPunchMaxAge;
+    bool _defaultGrabDetection;
+    bool _defaultGestureDetection;
+    livescene::HandShape _handShape;
+    livescene::GestureRecognizer _gestureRecognizer;
+    std::vector< unsigned short > _rowMins; // findMinZ() scratch, kept between frames
 };
 
 
@@ -9,6 +9,7 @@
 #include <osg/MatrixTransform>
 #include "liblivescene/Export.h"
 #include "liblivescene/GeometryBuilder.h"
+#include "liblivescene/DepthConversion.h"
 
 
 namespace livescene {
@@ -314,6 +315,34 @@ Calls \c transformPointOSG() to do the actual transformOSG.
 */
 LIVESCENE_EXPORT int transformOSG( osg::Vec3Array* vec, const osg::Matrix& m, const livescene::Image imageZ, const unsigned short invalid=2047 );
 
+/** \brief Transform a millimeter depth sample into a metric OSG Vec3.
+Uses the ray tables of \c conversion rather than a matrix multiply and divide. Results are in
+meters, in the same eye space as transformPointOSG() with a makeDeviceToWorldMatrixOSG() matrix.
+
+\param conversion Input. Supplies the per-column and per-row ray tables.
+\param coordX Input. Raster X coordinate of sample.
+\param coordY Input. Raster Y coordinate of sample.
+\param millimeters Input. Depth value from a DEPTH_MM_16 image.
+\return Contains the transformed output.
+*/
+inline osg::Vec3 transformPointMetricOSG( const livescene::DepthConversion& conversion, const int &coordX, const int &coordY, const unsigned short &millimeters )
+{
+	float X, Y, Z;
+	conversion.toMetric(coordX, coordY, millimeters, X, Y, Z);
+	return(osg::Vec3(X, Y, Z));
+}
+
+/** \brief Transform DEPTH_MM_16 image data into an OSG Vec3Array.
+The metric equivalent of transformOSG(). NULL samples are discarded.
+
+\param vec Output. Contains the transformed output. This function marks it as dirty.
+\param conversion Input. Supplies the ray tables, and must be at least as large as \c imageMM.
+\param imageMM Input. Millimeter depth image, typically from DepthConversion::convertToMillimeters().
+\see transformPointMetricOSG()
+\return Number of valid values, or zero if \c imageMM isn't DEPTH_MM_16.
+*/
+LIVESCENE_EXPORT int transformMetricOSG( osg::Vec3Array* vec, const livescene::DepthConversion& conversion, const livescene::Image &imageMM );
+
 
 // namespace livescene
 }
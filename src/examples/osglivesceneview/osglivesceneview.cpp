@@ -7,6 +7,8 @@
 #include <liblivescene/osgGeometry.h>
 #include <liblivescene/Background.h>
 #include <liblivescene/Detect.h>
+#include <liblivescene/Tracker.h>
+#include <liblivescene/Morphology.h>
 #ifdef WIN32
 // RdV to PM/CH: somehow, I cannot put this line as first header file line... try it out and you will get strange errors
 #include <windows.h>  // (at least) for SYSTEMTIME
@@ -34,6 +36,8 @@
 
 const int OSG_LIVESCENEVIEW_BACKGROUND_NOISE_SAMPLES(1500); // fewer than this many foreground samples in a frame are presumed to be background noise
 const int OSG_LIVESCENEVIEW_INITIAL_BACKGROUND_FRAMES(10); // Assume the first n frames are empty background, for calibration
+const int OSG_LIVESCENEVIEW_BACKGROUND_SAVE_FRAMES(1800); // with -bgfile, save the background model this often (about a minute), so a crash loses little
+const double OSG_LIVESCENEVIEW_DETECT_BUDGET_MS(8.0); // body and hand detection settle for coarse results rather than take longer than this per frame
 
 // configure these to taste
 bool PolygonsMode(true),
@@ -42,8 +46,10 @@ FilterNoise(false),
 ShowBackground(false),
 textureForeground(false),
 textureBackground(true),
-dynamicAccumulateBackground(true), // this option takes "empty" frames and merges them with the background. It costs about 1fps.
+dynamicAccumulateBackground(true), // this option continuously learns the background from live frames
+colorAssistedBackground(false), // lets color decide where depth can't tell foreground from background
 depth10bit(true);
+std::string backgroundFile; // -bgfile: background model loaded at startup if it exists, and saved while running
 
 
 static const int NominalFrameW = 640, NominalFrameH = 480; // <<<>>> these should be made dynamic
@@ -66,6 +72,14 @@ std::string fgInfoStr, minDepth, maxDepth;
 
 bool singleCapture = false;
 
+// lets the user know when the background has caught up with a bumped sensor or moved furniture
+class SceneChangeNotice : public livescene::SceneChangeCallback {
+public:
+    virtual void operator ()(const livescene::Background &background, const unsigned int &numTiles) {
+        osg::notify( osg::NOTICE ) << "Scene changed, relearned " << numTiles << " of " << background.getTilesX() * background.getTilesY() << " background tiles." << std::endl;
+    }
+};
+
 class PrintSceneGraphVisitor : public osg::NodeVisitor {
 public:
     PrintSceneGraphVisitor(std::ostream &out) : NodeVisitor(NodeVisitor::TRAVERSE_ALL_CHILDREN), _out(out) {
@@ -327,6 +341,8 @@ int main( int argc, char** argv )
     osg::notify( osg::ALWAYS ) << "-tf\tEnables textureForeground (default is false)." << std::endl;
     osg::notify( osg::ALWAYS ) << "-notb\tDisables textureBackground (default is true)." << std::endl;
     osg::notify( osg::ALWAYS ) << "-nodab\tDisables dynamicAccumulateBackground (default is true)." << std::endl;
+    osg::notify( osg::ALWAYS ) << "-cab\tEnables colorAssistedBackground (default is false)." << std::endl;
+    osg::notify( osg::ALWAYS ) << "-bgfile <file>\tLoads the background model from file at startup, and saves it there while running." << std::endl;
     osg::notify( osg::ALWAYS ) << "-depth11bit\tEnables 11bit depth (default is 10bit)." << std::endl;
     PolygonsMode = arguments.find( "-nopm" ) < 0;
     IsolateBackground = arguments.find( "-noib" ) < 0;
@@ -335,6 +351,8 @@ int main( int argc, char** argv )
     textureForeground = arguments.find( "-tf" ) > 0;
     textureBackground = arguments.find( "-notb" ) < 0;
     dynamicAccumulateBackground = arguments.find( "-nodab" ) < 0;
+    colorAssistedBackground = arguments.find( "-cab" ) > 0;
+    arguments.read( "-bgfile", backgroundFile );
     depth10bit = arguments.find( "-depth11bit" ) < 0;
 
 
@@ -426,6 +444,17 @@ int main( int argc, char** argv )
 
     int backgroundEstablished(0);
     livescene::Background background;
+    SceneChangeNotice sceneChangeNotice;
+    background.setSceneChangeCallback(&sceneChangeNotice);
+    std::vector<const livescene::Image *> initialPlatesRGB, initialPlatesZ; // copies of the initial frames, for the median background
+    if(!backgroundFile.empty() && background.load(backgroundFile))
+    { // no need to learn it again, or for the scene to be empty at startup
+        osg::notify( osg::ALWAYS ) << "Loaded background model from " << backgroundFile << std::endl;
+        backgroundEstablished = OSG_LIVESCENEVIEW_INITIAL_BACKGROUND_FRAMES;
+        background.publishSnapshot();
+    } // if
+
+    livescene::BodyTracker detectedBodies; // persists so bodies are followed from frame to frame
 
     livescene::Geometry geometryBuilderFore;
     livescene::Geometry geometryBuilderBack;
@@ -458,6 +487,12 @@ int main( int argc, char** argv )
     osg::ref_ptr<osg::Geode> foreScene;
     osg::ref_ptr<osg::Geode> backScene;
 
+    // 3x3 opening of the foreground silhouette, keeps its scratch buffers from frame to frame
+    livescene::Morphology foregroundMorphology(1, 1);
+
+    // extraction results against background snapshots, keeps its buffers from frame to frame
+    livescene::BackgroundExtraction backgroundExtraction;
+
     for(bool keepGoing(true); keepGoing && !viewer.done(); )
     {
         bool goodRGB(false), goodZ(false), noForeground(false);
@@ -483,43 +518,77 @@ int main( int argc, char** argv )
         if(goodRGB && goodZ)
         {
 
-            if(backgroundEstablished == 0) // load initial frame
-            { // store a background clean plate
-                background.loadBackgroundFromCleanPlate(imageRGB, imageZ);
-                ++backgroundEstablished;
-            } // if
-            else if(backgroundEstablished < OSG_LIVESCENEVIEW_INITIAL_BACKGROUND_FRAMES) // accumulate some frames, averaged, for background calibration
-            { // store a background clean plate
-                background.accumulateBackgroundFromCleanPlate(imageRGB, imageZ, livescene::Background::AVERAGE_Z);
+            if(backgroundEstablished < OSG_LIVESCENEVIEW_INITIAL_BACKGROUND_FRAMES) // collect some frames for background calibration
+            {
+                if(backgroundEstablished == 0) // load initial frame
+                { // store a background clean plate to work with until the rest are in
+                    background.loadBackgroundFromCleanPlate(imageRGB, imageZ);
+                    background.publishSnapshot();
+                } // if
+                initialPlatesRGB.push_back(new livescene::Image(imageRGB, true));
+                initialPlatesZ.push_back(new livescene::Image(imageZ, true));
                 ++backgroundEstablished;
+                if(backgroundEstablished == OSG_LIVESCENEVIEW_INITIAL_BACKGROUND_FRAMES)
+                { // the median of them all outvotes flicker and dropouts in any one frame
+                    background.loadBackgroundFromCleanPlates(initialPlatesRGB, initialPlatesZ, livescene::Background::MEDIAN);
+                    background.publishSnapshot();
+                    for(unsigned int plate = 0; plate < initialPlatesZ.size(); ++plate)
+                    {
+                        delete initialPlatesRGB[plate];
+                        delete initialPlatesZ[plate];
+                    } // for
+                    initialPlatesRGB.clear();
+                    initialPlatesZ.clear();
+                } // if
                 noForeground = true; // skip FG processing while establishing background
             } // if
 
+            // the background is read from a snapshot, as separate extraction or render threads would have to.
+            // Published whenever the background is loaded or learned, so this is it as of the last frame. Released once drawn.
+            const livescene::BackgroundSnapshot *snapshot(0);
+            if(IsolateBackground || ShowBackground)
+            {
+                snapshot = background.acquireSnapshot();
+            } // if
+
             if(IsolateBackground)
             {
                 foreZ.preAllocate(); // need room to write processed data to (only done at start if needed, not on every frame)
                 foreZ.setNull(imageZ.getNull()); // transfer over NULL value
-                background.extractZBackground(imageZ, foreZ); // wipe out everything that is already in the background plate
+                if(snapshot)
+                {
+                    if(colorAssistedBackground)
+                    { // wipe out everything that is already in the background plate, by color where depth is ambiguous
+                        livescene::Background::extractZBackground(*snapshot, imageZ, imageRGB, foreZ, backgroundExtraction);
+                    } // if
+                    else
+                    { // wipe out everything that is already in the background plate
+                        livescene::Background::extractZBackground(*snapshot, imageZ, foreZ, backgroundExtraction);
+                    } // else
+                    background.useExtraction(backgroundExtraction); // learning goes by the tiles extraction found changed
+                } // if
 
-                // calculate and cache foreground stats
+                // foreground stats were cached by the extraction pass, this just confirms they're there
                 foreZ.calcInternalStatsXYZ();
 
-                // we can only dynamically accumulate background when we don't think there's a foreground object in frame,
-                // because foreground objects contacting background objects may get 'sucked into' the background
+                // learn from every live frame once the initial plate is in. The per-pixel model only
+                // learns samples that match it, so people in frame don't get 'sucked into' the background
+                if(backgroundEstablished >= OSG_LIVESCENEVIEW_INITIAL_BACKGROUND_FRAMES && dynamicAccumulateBackground)
+                {
+                    background.accumulateBackgroundFromLive(imageRGB, imageZ);
+                    background.publishSnapshot(); // for the next frame
+                } // if
                 if(backgroundEstablished >= OSG_LIVESCENEVIEW_INITIAL_BACKGROUND_FRAMES && foreZ.getInternalStatsZ().getNumSamples() < OSG_LIVESCENEVIEW_BACKGROUND_NOISE_SAMPLES) // very small amount of foreground
                 {
-                    // add it to the background
-                    // make sure we're only adding it where it's Z-threshold adjacent to existing background (MIN_Z_ADJACENT)
-                    if(dynamicAccumulateBackground)
-                    {
-                        background.accumulateBackgroundFromCleanPlate(imageRGB, imageZ, livescene::Background::AVERAGE_Z_ADJACENT, &foreZ);
-                    } // if
                     noForeground = true; // <<<>>> somehow we could completely avoid drawing the foreground in this case, but we don't yet
                 } // if
                 if(FilterNoise && !noForeground)
                 { // these operations only make sense if we have a foreground
                     // filter noise
                     numFiltered = foreZ.filterNoise(2);
+                    // then knock off thin protrusions and speckle clusters the neighbor count can't see
+                    foregroundMorphology.openDepth(foreZ.getView());
+                    foreZ.increaseGeneration(); // edited through a view, which can't say so itself
                 } // if
             } // if
 
@@ -528,6 +597,8 @@ int main( int argc, char** argv )
 
 
 
+            const livescene::BackgroundSnapshot *backSnapshot(ShowBackground ? snapshot : 0); // drawn as extraction saw it
+
             if(!debugOneShot)
             {
                 //debugOneShot = true;
@@ -536,9 +607,9 @@ int main( int argc, char** argv )
                     if(IsolateBackground)
                     {
                         geometryBuilderFore.buildPointCloud(foreZ, &imageRGB); // using isolated background
-                        if(ShowBackground)
+                        if(backSnapshot)
                         {
-                            geometryBuilderBack.buildPointCloud(background.getBackgroundZ(), &background.getBackgroundRGB()); // build only the BG data
+                            geometryBuilderBack.buildPointCloud(backSnapshot->getBackgroundZ(), &backSnapshot->getBackgroundRGB()); // build only the BG data
                             backScene = livescene::buildOSGPointCloudCopy(geometryBuilderBack, backScene, backColor);
                         } // if
                     } // if
@@ -553,9 +624,9 @@ int main( int argc, char** argv )
                     if(IsolateBackground)
                     {
                         geometryBuilderFore.buildFacesSimple(foreZ, &imageRGB); // using isolated background
-                        if(ShowBackground)
+                        if(backSnapshot)
                         {
-                            geometryBuilderBack.buildFacesSimple(background.getBackgroundZ(), &background.getBackgroundRGB()); // build only the BG data
+                            geometryBuilderBack.buildFacesSimple(backSnapshot->getBackgroundZ(), &backSnapshot->getBackgroundRGB()); // build only the BG data
                             backScene = livescene::buildOSGPolyMeshCopy(geometryBuilderBack, backScene, backColor);
                         } // if
                     } // 
@@ -605,17 +676,24 @@ int main( int argc, char** argv )
                 } // if
 
             } // oneshot
+            if(snapshot)
+            {
+                snapshot->release();
+            } // if
 
-            livescene::BodyMass detectedBodies;
             int numHands(0);
             bodyBoundsPAT->setNodeMask(0); // start by hiding body bounds in case we don't find any bodies
             handZeroPAT->setNodeMask(0); // hide hand zero
             handOnePAT->setNodeMask(0); // hide hand one
-            if(!noForeground)
+            if(noForeground)
+            {
+                detectedBodies.clear();
+            } // if
+            else
             { // foreground detected
-                if(detectedBodies.detect(foreZ)) // try to detect bodies
+                if(detectedBodies.update(foreZ, livescene::Deadline(OSG_LIVESCENEVIEW_DETECT_BUDGET_MS))) // try to detect and track bodies and hands
                 {
-                    numHands = detectedBodies.detectHands(foreZ); // try to detect hands
+                    numHands = detectedBodies.getNumHands(0); // the display follows the longest tracked body
                     bodyBoundsPAT->setNodeMask(~0); // make the body bounds box visible
                     if(numHands) handZeroPAT->setNodeMask(~0); // show hand zero
                     if(numHands > 1) handOnePAT->setNodeMask(~0); // show hand one
@@ -687,6 +765,7 @@ int main( int argc, char** argv )
                 "Frame: " << frameCount << std::endl <<
                 "Foreground Samples: " << foreZ.getInternalStatsZ().getNumSamples() << std::endl <<
                 fgInfoStr << std::endl <<
+                "Bodies: " << detectedBodies.getNumBodies() << (detectedBodies.getLastUpdateFinished() ? "" : " (coarse)") << std::endl <<
                 "Noise Filtered: " << numFiltered << std::endl <<
                 "FzMin: " << foreZ.getInternalStatsZ().getMin() << std::endl <<
                 "FzMed: " << foreZ.getInternalStatsZ().getMidVal() << std::endl <<
@@ -700,6 +779,11 @@ int main( int argc, char** argv )
 
             viewer.frame();
             ++frameCount;
+
+            if(!backgroundFile.empty() && backgroundEstablished >= OSG_LIVESCENEVIEW_INITIAL_BACKGROUND_FRAMES && frameCount % OSG_LIVESCENEVIEW_BACKGROUND_SAVE_FRAMES == 0)
+            {
+                background.save(backgroundFile);
+            } // if
         } // if
         else
         {
@@ -708,6 +792,11 @@ int main( int argc, char** argv )
 
     } // for keepGoing / !done
 
+    if(!backgroundFile.empty() && backgroundEstablished >= OSG_LIVESCENEVIEW_INITIAL_BACKGROUND_FRAMES)
+    {
+        background.save(backgroundFile);
+    } // if
+
     // Release the interfaces
     if(ImageCapabilitiesRGB)
     {
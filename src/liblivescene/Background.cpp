@@ -1,9 +1,77 @@
 // Copyright 2011 Skew Matrix Software and AlphaPixel
 
 #include "liblivescene/Background.h"
+#include "liblivescene/Parallel.h"
+#include "liblivescene/SIMD.h"
+#include <OpenThreads/Atomic>
+#include <algorithm> // std::min/max
+#include <climits> // INT_MAX
+#include <cmath> // sqrt
+#include <cstdio> // FILE
+#include <cstdlib> // abs
+#include <cstring> // memcpy/memcmp
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace livescene {
 
+// The RGB model's mean and deviation planes are 9.7 fixed point: 0-255 in 1/128 steps, and the
+// difference of two values still fits a signed 16-bit SIMD lane.
+static const unsigned int RGB_FRACTION_BITS = 7;
+
+// multiplier taking a fixed point mean absolute deviation to a color threshold in (value * scale) >> 16.
+// For normally distributed noise the standard deviation is 1.25 mean absolute deviations.
+static inline unsigned short colorDeviationScale(const float &colorDeviations)
+{
+	return((unsigned short)std::min(colorDeviations * 1.25f * (65536.0f / (1 << RGB_FRACTION_BITS)), 65535.0f));
+} // colorDeviationScale
+
+static inline unsigned char colorThreshold(const unsigned short &deviation, const unsigned short &deviationScale, const unsigned char &minimumDelta)
+{
+	return((unsigned char)std::min(std::max(((unsigned int)deviation * deviationScale) >> 16, (unsigned int)minimumDelta), 255U));
+} // colorThreshold
+
+// (value * rateQ16) >> 16, rounded to nearest rather than floored, so the RGB model doesn't creep down under symmetric noise
+static inline int scaleRounded(const int &value, const short &rateQ16)
+{
+	return((value * rateQ16 + (1 << 15)) >> 16);
+} // scaleRounded
+
+#ifdef LIVESCENE_SSE2
+// the same on eight signed lanes: the high half of each product, plus the carry rounding its low half would add
+static inline __m128i scaleRounded(const __m128i &value, const __m128i &rateQ16)
+{
+	return(_mm_add_epi16(_mm_mulhi_epi16(value, rateQ16), _mm_srli_epi16(_mm_mullo_epi16(value, rateQ16), 15)));
+} // scaleRounded
+#endif // LIVESCENE_SSE2
+
+
+Background::Background() : _backgroundAvailable(false), _discriminationEpsilonPercent(.01f), _minimumDiscriminationDelta(2),
+	_learningRate(0.02f), _matchStdDevs(2.5f), _absorbFrames(900), _revealFrames(15), _liveModelValid(false),
+	_colorDeviations(3.0f), _colorAmbiguityFactor(3.0f), _colorMinimumDelta(24),
+	_rgbModelWeight(1), _rgbAccumulatorsValid(false), _rgbAccumulations(0), _zAccumulatorsValid(false),
+	_tileFlagsValid(false), _tileRefreshInterval(8), _tileRefreshPhase(0),
+	_sceneChangeFraction(0.6f), _sceneChangeSampleFraction(0.75f), _sceneChangeFrames(90), _sceneChangeCallback(0),
+	_currentSnapshot(new OpenThreads::AtomicPtr), _acquiring(new OpenThreads::Atomic(0)), _snapshotVersion(0), _modelVersion(0)
+{
+} // Background::Background
+
+Background::~Background()
+{
+	for(std::vector<livescene::BackgroundSnapshot *>::iterator snapshotIt = _snapshots.begin(); snapshotIt != _snapshots.end(); ++snapshotIt)
+	{
+		delete *snapshotIt;
+	} // for
+	delete _currentSnapshot;
+	delete _acquiring;
+} // Background::~Background
+
+
 bool Background::loadBackgroundFromCleanPlate(const livescene::Image &cleanPlateRGB, const livescene::Image &cleanPlateZ)
 {
 	bool successZ(false), successRGB(false);
@@ -15,14 +83,20 @@ bool Background::loadBackgroundFromCleanPlate(const livescene::Image &cleanPlate
 bool Background::loadRGBBackgroundFromCleanPlate(const livescene::Image &cleanPlateRGB)
 {
 	_bgRGB = livescene::Image(cleanPlateRGB, true); // clone image for persistent storage. Note this does two copies, which is inefficient
+	++_modelVersion; // see publishSnapshot()
 	_backgroundAvailable = true; // technically not true until you load the Z too
+	initRGBModel();
 	return(true);
 } // Background::loadRGBBackgroundFromCleanPlate
 
 bool Background::loadZBackgroundFromCleanPlate(const livescene::Image &cleanPlateZ)
 {
 	_bgZ = livescene::Image(cleanPlateZ, true); // clone image for persistent storage. Note this does two copies, which is inefficient
+	++_modelVersion; // see publishSnapshot()
 	_backgroundAvailable = true; // technically not true until you load the RGB too
+	_liveModelValid = false; // reseed live learning from the new plate
+	_zAccumulatorsValid = false; // and clean-plate averaging
+	invalidateTiles(); // tiles were found against the old background
 	return(true);
 } // Background::loadZBackgroundFromCleanPlate
 
@@ -38,157 +112,2008 @@ bool Background::accumulateBackgroundFromCleanPlate(const livescene::Image &clea
 
 bool Background::accumulateRGBBackgroundFromCleanPlate(const livescene::Image &cleanPlateRGB, AccumulateMode mode)
 {
-return(false); // <<<>>> not implemented
+	if(!_bgRGB.getData())
+	{
+		return(loadRGBBackgroundFromCleanPlate(cleanPlateRGB));
+	} // if
+	if(cleanPlateRGB.getFormat() != _bgRGB.getFormat() || cleanPlateRGB.getImageBytes() != _bgRGB.getImageBytes() || !cleanPlateRGB.getData())
+	{
+		return(false);
+	} // if
+	++_modelVersion; // see publishSnapshot()
+	if(!_rgbAccumulatorsValid)
+	{
+		seedRGBAccumulators();
+	} // if
+
+	const unsigned int numChannels = _bgRGB.getImageBytes();
+	if(_rgbAccumulations == 0xffff)
+	{ // halve rather than stop, the mean and deviation are unchanged and newer plates keep counting
+		for(unsigned int channel = 0; channel < numChannels; ++channel)
+		{
+			_rgbSums[channel] >>= 1;
+			_rgbSumSquares[channel] >>= 1;
+		} // for
+		_rgbAccumulations >>= 1;
+	} // if
+	const unsigned int count = ++_rgbAccumulations;
+
+	const unsigned char *cleanRGBData = (const unsigned char *)cleanPlateRGB.getData();
+	unsigned char *bgRGBData = (unsigned char *)_bgRGB.getData();
+	for(unsigned int channel = 0; channel < numChannels; ++channel)
+	{
+		const unsigned int value = cleanRGBData[channel];
+		const unsigned int sum = (_rgbSums[channel] += value);
+		const unsigned int sumSquares = (_rgbSumSquares[channel] += value * value);
+		const unsigned int mean = ((sum << RGB_FRACTION_BITS) + count / 2) / count;
+		const float realMean = (float)sum / count, variance = std::max((float)sumSquares / count - realMean * realMean, 0.0f);
+		_rgbMean[channel] = (unsigned short)mean;
+		// stored as mean absolute deviation, 0.8 standard deviations for normally distributed noise
+		_rgbDeviation[channel] = (unsigned short)(sqrtf(variance) * (0.8f * (1 << RGB_FRACTION_BITS)) + 0.5f);
+		bgRGBData[channel] = (unsigned char)((mean + (1 << (RGB_FRACTION_BITS - 1))) >> RGB_FRACTION_BITS);
+	} // for
+	_rgbModelWeight = (unsigned short)count;
+	updateRGBThresholds();
+	return(true);
 } // Background::accumulateRGBBackgroundFromCleanPlate
 
 
-bool Background::accumulateZBackgroundFromCleanPlate(const livescene::Image &cleanPlateZ, AccumulateMode mode, livescene::Image *foreZ)
+void Background::initRGBModel(void)
 {
-	// Once this exceeds 1/n where n is the largest reasonable Z value, it has no more effect and we'll skip it
-	if(_bgZ.getAccumulation() > 1023) return(false);
+	const unsigned char *bgRGBData = (const unsigned char *)_bgRGB.getData();
+	const unsigned int numChannels = _bgRGB.getImageBytes();
+	_rgbMean.resize(numChannels);
+	for(unsigned int channel = 0; channel < numChannels; ++channel)
+	{
+		_rgbMean[channel] = (unsigned short)(bgRGBData[channel] << RGB_FRACTION_BITS);
+	} // for
+	_rgbDeviation.assign(numChannels, 0); // unknown from a single plate
+	_rgbModelWeight = 1;
+	_rgbAccumulatorsValid = false;
+	updateRGBThresholds();
+} // Background::initRGBModel
+
+
+void Background::updateRGBThresholds(void)
+{
+	const unsigned int numChannels = _rgbDeviation.size();
+	const unsigned short deviationScale = colorDeviationScale(_colorDeviations);
+	_rgbThreshold.resize(numChannels);
+	++_modelVersion; // see publishSnapshot()
+	for(unsigned int channel = 0; channel < numChannels; ++channel)
+	{
+		_rgbThreshold[channel] = colorThreshold(_rgbDeviation[channel], deviationScale, _colorMinimumDelta);
+	} // for
+} // Background::updateRGBThresholds
+
+
+// sums and sums of squares as if _rgbModelWeight plates with the model's mean and deviation had been accumulated
+void Background::seedRGBAccumulators(void)
+{
+	const unsigned int numChannels = _rgbMean.size();
+	const double weight = _rgbModelWeight, fixedPoint = 1 << RGB_FRACTION_BITS;
+	_rgbSums.resize(numChannels);
+	_rgbSumSquares.resize(numChannels);
+	for(unsigned int channel = 0; channel < numChannels; ++channel)
+	{
+		const double mean = _rgbMean[channel] / fixedPoint, stdDev = _rgbDeviation[channel] * 1.25 / fixedPoint;
+		_rgbSums[channel] = (unsigned int)(mean * weight + 0.5);
+		_rgbSumSquares[channel] = (unsigned int)(std::min(mean * mean + stdDev * stdDev, 65025.0) * weight + 0.5); // 255 squared can't be exceeded
+	} // for
+	_rgbAccumulations = _rgbModelWeight;
+	_rgbAccumulatorsValid = true;
+} // Background::seedRGBAccumulators
+
+
+// Whether one clean-plate sample is within epsilon of a valid neighbor in the background.
+// bgAbove/bgBelow are NULL on the first/last line. Background samples that are NULL or zero aren't valid neighbors.
+static inline unsigned char isAdjacentZ(const unsigned short *bgAbove, const unsigned short *bgRow, const unsigned short *bgBelow,
+	const unsigned int &column, const unsigned int &width, const int &clean, const unsigned short &bgNull, const unsigned short &epsilonQ16)
+{
+	int minDelta(0x10000); // beyond any real delta, no valid neighbor
+	const unsigned int firstNeighbor = (column > 0 ? column - 1 : 0), lastNeighbor = std::min(column + 1, width - 1);
+	for(unsigned int neighbor = firstNeighbor; neighbor <= lastNeighbor; ++neighbor)
+	{
+		if(bgAbove && bgAbove[neighbor] != bgNull && bgAbove[neighbor] != 0) minDelta = std::min(minDelta, abs((int)bgAbove[neighbor] - clean));
+		if(bgBelow && bgBelow[neighbor] != bgNull && bgBelow[neighbor] != 0) minDelta = std::min(minDelta, abs((int)bgBelow[neighbor] - clean));
+		if(neighbor != column && bgRow[neighbor] != bgNull && bgRow[neighbor] != 0) minDelta = std::min(minDelta, abs((int)bgRow[neighbor] - clean));
+	} // for
+	return((minDelta <= (int)(((unsigned int)clean * epsilonQ16) >> 16)) ? 0xff : 0);
+} // isAdjacentZ
 
-	const int maxSample = _bgZ.getSamples();
-	const float accumWeight = 1.0f / (_bgZ.getAccumulation() + 1); // only used in AVERAGE mode
-	unsigned short *bgZData = (unsigned short *)_bgZ.getData();
-	unsigned short bgzZnull = (unsigned short)_bgZ.getNull();
-	unsigned short *foreZData = NULL;
-	unsigned short *cleanZData = (unsigned short *)cleanPlateZ.getData();
-	unsigned short cleanZnull = (unsigned short)cleanPlateZ.getNull();
-	unsigned short foreZnull = 0;
 
-	if(foreZ)
+// Marks which samples of one line of a clean plate are within epsilon of a valid neighbor in the background.
+static void findAdjacentZRow(const unsigned short *bgAbove, const unsigned short *bgRow, const unsigned short *bgBelow, const unsigned short *cleanRow,
+	const unsigned int &width, const unsigned short &bgNull, const unsigned short &epsilonQ16, unsigned char *adjacentRow)
+{
+	unsigned int column(0);
+#ifdef LIVESCENE_SSE2
+	if(bgAbove && bgBelow && width > 1)
 	{
-		foreZData = (unsigned short *)foreZ->getData();
-		foreZnull = (unsigned short)foreZ->getNull();
+		// interior columns eight at a time. The first column and the tail are done by the scalar loops below.
+		adjacentRow[0] = isAdjacentZ(bgAbove, bgRow, bgBelow, 0, width, cleanRow[0], bgNull, epsilonQ16);
+		const __m128i zero = _mm_setzero_si128(), bgNullV = _mm_set1_epi16((short)bgNull), epsilonV = _mm_set1_epi16((short)epsilonQ16);
+		for(column = 1; column + 9 <= width; column += 8)
+		{
+			const unsigned short *neighbors[8] = {bgAbove + column - 1, bgAbove + column, bgAbove + column + 1, bgRow + column - 1,
+				bgRow + column + 1, bgBelow + column - 1, bgBelow + column, bgBelow + column + 1};
+			const __m128i clean = _mm_loadu_si128((const __m128i *)(cleanRow + column));
+			__m128i minDelta = _mm_set1_epi16(-1); // 0xffff, no valid neighbor
+			for(unsigned int neighbor = 0; neighbor < 8; ++neighbor)
+			{
+				const __m128i bg = _mm_loadu_si128((const __m128i *)neighbors[neighbor]);
+				const __m128i invalid = _mm_or_si128(_mm_cmpeq_epi16(bg, bgNullV), _mm_cmpeq_epi16(bg, zero));
+				// |bg - clean|, or 0xffff for an invalid neighbor
+				const __m128i delta = _mm_or_si128(_mm_or_si128(_mm_subs_epu16(bg, clean), _mm_subs_epu16(clean, bg)), invalid);
+				minDelta = _mm_subs_epu16(minDelta, _mm_subs_epu16(minDelta, delta)); // unsigned min, which SSE2 lacks
+			} // for
+			// minDelta <= epsilon, unsigned
+			const __m128i adjacent = _mm_cmpeq_epi16(_mm_subs_epu16(minDelta, _mm_mulhi_epu16(clean, epsilonV)), zero);
+			_mm_storel_epi64((__m128i *)(adjacentRow + column), _mm_packs_epi16(adjacent, adjacent));
+		} // for
 	} // if
+#endif // LIVESCENE_SSE2
+
+	for(; column < width; ++column)
+	{
+		adjacentRow[column] = isAdjacentZ(bgAbove, bgRow, bgBelow, column, width, cleanRow[column], bgNull, epsilonQ16);
+	} // for
+} // findAdjacentZRow
+
+
+// Accumulates one line of a clean plate. Templated on the mode so the per-sample loop carries no mode switch.
+// Sum and count planes make AVERAGE exact: the background is the rounded mean of every sample accumulated.
+template <Background::AccumulateMode MODE>
+static void accumulateZRow(const unsigned short *cleanRow, unsigned short *bgRow, unsigned int *sumRow, unsigned short *countRow,
+	const unsigned char *adjacentRow, unsigned short *foreRow, const unsigned int &width, const unsigned short &cleanNull, const unsigned short &foreNull)
+{
+	const bool adjacentMode = (MODE == Background::MIN_Z_ADJACENT || MODE == Background::MAX_Z_ADJACENT || MODE == Background::AVERAGE_Z_ADJACENT);
+	for(unsigned int column = 0; column < width; ++column)
+	{
+		const unsigned short cleanZsample = cleanRow[column];
+		if(cleanZsample == cleanNull || cleanZsample == 0) continue;
+		// if mode == _ADJACENT, it must also be close enough in Z to an adjacent sample in the background
+		if(adjacentMode && !adjacentRow[column]) continue;
+
+		const bool hasData = (countRow[column] > 0); // no data yet always takes the clean sample
+		if(MODE == Background::MIN_Z || MODE == Background::MIN_Z_ADJACENT || MODE == Background::MAX_Z || MODE == Background::MAX_Z_ADJACENT)
+		{
+			// is the sample from the clean plate nearer to (MIN) or farther from (MAX) the sensor
+			const bool replace = (MODE == Background::MIN_Z || MODE == Background::MIN_Z_ADJACENT) ? (cleanZsample < bgRow[column]) : (cleanZsample > bgRow[column]);
+			if(hasData && !replace) continue;
+			// restart the average from here, so a later AVERAGE carries on from the replacement
+			sumRow[column] = cleanZsample;
+			countRow[column] = 1;
+			bgRow[column] = cleanZsample;
+		} // if
+		else
+		{ // AVERAGE
+			if(countRow[column] == 0xffff)
+			{ // halve rather than stop, the mean is unchanged and newer samples keep counting
+				sumRow[column] = (sumRow[column] + 1) >> 1;
+				countRow[column] >>= 1;
+			} // if
+			sumRow[column] += cleanZsample;
+			++countRow[column];
+			bgRow[column] = (unsigned short)((sumRow[column] + (countRow[column] >> 1)) / countRow[column]); // rounded, not truncated
+		} // else
+		if(foreRow)
+		{ // knock it out of foreground
+			foreRow[column] = foreNull;
+		} // if
+	} // for
+} // accumulateZRow
+
+
+template <Background::AccumulateMode MODE>
+static void accumulateZPlate(const livescene::Image &cleanPlateZ, livescene::Image &bgZ, const std::vector<unsigned short> &bgZBefore,
+	std::vector<unsigned int> &sums, std::vector<unsigned short> &counts, std::vector<unsigned char> &adjacent,
+	livescene::Image *foreZ, const unsigned short &epsilonQ16)
+{
+	const bool adjacentMode = (MODE == Background::MIN_Z_ADJACENT || MODE == Background::MAX_Z_ADJACENT || MODE == Background::AVERAGE_Z_ADJACENT);
+	const unsigned int width(cleanPlateZ.getWidth()), height(cleanPlateZ.getHeight());
+	const unsigned short *cleanZData = (const unsigned short *)cleanPlateZ.getData();
+	unsigned short *bgZData = (unsigned short *)bgZ.getData();
+	unsigned short *foreZData = foreZ ? (unsigned short *)foreZ->getData() : 0;
+	const unsigned short cleanZnull = (unsigned short)cleanPlateZ.getNull(), bgZnull = (unsigned short)bgZ.getNull(), foreZnull = foreZ ? (unsigned short)foreZ->getNull() : 0;
+	adjacent.resize(width);
+
+	for(unsigned int line = 0; line < height; ++line)
+	{
+		const unsigned int rowSub = line * width;
+		if(adjacentMode)
+		{ // adjacency is judged against the background as it was before this plate, so it doesn't depend on scan order
+			const unsigned short *bgBeforeRow = &bgZBefore[rowSub];
+			findAdjacentZRow(line > 0 ? bgBeforeRow - width : 0, bgBeforeRow, line + 1 < height ? bgBeforeRow + width : 0,
+				cleanZData + rowSub, width, bgZnull, epsilonQ16, &adjacent.front());
+		} // if
+		accumulateZRow<MODE>(cleanZData + rowSub, bgZData + rowSub, &sums[rowSub], &counts[rowSub], &adjacent.front(),
+			foreZData ? foreZData + rowSub : 0, width, cleanZnull, foreZnull);
+	} // for lines
+} // accumulateZPlate
+
 
-	int width(cleanPlateZ.getWidth()), height(cleanPlateZ.getHeight());
+bool Background::accumulateZBackgroundFromCleanPlate(const livescene::Image &cleanPlateZ, AccumulateMode mode, livescene::Image *foreZ)
+{
+	if(!_bgZ.getData())
+	{
+		return(loadZBackgroundFromCleanPlate(cleanPlateZ));
+	} // if
+	if(cleanPlateZ.getWidth() != _bgZ.getWidth() || cleanPlateZ.getHeight() != _bgZ.getHeight() || !cleanPlateZ.getData()
+		|| (foreZ && (foreZ->getWidth() != _bgZ.getWidth() || foreZ->getHeight() != _bgZ.getHeight() || !foreZ->getData())))
+	{
+		return(false);
+	} // if
+	++_modelVersion; // see publishSnapshot()
 
+	const unsigned int numSamples = _bgZ.getSamples();
+	const unsigned short *bgZData = (const unsigned short *)_bgZ.getData();
+	if(!_zAccumulatorsValid)
+	{ // seed from whatever the background currently holds, as one sample's worth
+		const unsigned short bgZnull = (unsigned short)_bgZ.getNull();
+		_zSums.resize(numSamples);
+		_zCounts.resize(numSamples);
+		for(unsigned int sample = 0; sample < numSamples; ++sample)
+		{
+			const bool hasData = (bgZData[sample] != bgZnull && bgZData[sample] != 0);
+			_zSums[sample] = hasData ? bgZData[sample] : 0;
+			_zCounts[sample] = hasData ? 1 : 0;
+		} // for
+		_zAccumulatorsValid = true;
+	} // if
+	if(mode == MIN_Z_ADJACENT || mode == MAX_Z_ADJACENT || mode == AVERAGE_Z_ADJACENT)
+	{
+		_zBefore.assign(bgZData, bgZData + numSamples);
+	} // if
 
-	int sample = 0;
-	for(int line = 0; line < height; ++line)
+	const unsigned short epsilonQ16 = (unsigned short)std::min(_discriminationEpsilonPercent * 65536.0f, 65535.0f);
+	switch(mode)
 	{
-		for(int column = 0; column < width; ++column)
+	case MIN_Z: accumulateZPlate<MIN_Z>(cleanPlateZ, _bgZ, _zBefore, _zSums, _zCounts, _zAdjacent, foreZ, epsilonQ16); break;
+	case MAX_Z: accumulateZPlate<MAX_Z>(cleanPlateZ, _bgZ, _zBefore, _zSums, _zCounts, _zAdjacent, foreZ, epsilonQ16); break;
+	case AVERAGE_Z: accumulateZPlate<AVERAGE_Z>(cleanPlateZ, _bgZ, _zBefore, _zSums, _zCounts, _zAdjacent, foreZ, epsilonQ16); break;
+	case MIN_Z_ADJACENT: accumulateZPlate<MIN_Z_ADJACENT>(cleanPlateZ, _bgZ, _zBefore, _zSums, _zCounts, _zAdjacent, foreZ, epsilonQ16); break;
+	case MAX_Z_ADJACENT: accumulateZPlate<MAX_Z_ADJACENT>(cleanPlateZ, _bgZ, _zBefore, _zSums, _zCounts, _zAdjacent, foreZ, epsilonQ16); break;
+	case AVERAGE_Z_ADJACENT: accumulateZPlate<AVERAGE_Z_ADJACENT>(cleanPlateZ, _bgZ, _zBefore, _zSums, _zCounts, _zAdjacent, foreZ, epsilonQ16); break;
+	} // mode
+
+	if(_bgZ.getAccumulation() < 0xffff) _bgZ.increaseAccumulation(); // informational only now, the count planes do the averaging
+	_liveModelValid = false; // reseed live learning from the updated plate
+	invalidateTiles();
+
+	return(true);
+} // Background::accumulateZBackgroundFromCleanPlate
+
+
+// Reduces a stack of equally sized planes to one plane, sample by sample. Bands are lines, and each line is
+// done in tiles: a tile's values from every plane are gathered side by side, sorted and reduced while they're still in L1.
+template <typename T>
+class BatchReduce : public livescene::BandCallback
+{
+	public:
+		enum {TILE_SAMPLES = 64};
+
+		// counts, if given, receives the number of valid values behind each result, and deviations
+		// their mean absolute deviation from it, in RGB model fixed point
+		BatchReduce(const std::vector<const T *> &planes, const unsigned int &lineSamples, const bool &nullAware, const T &nullValue,
+			const Background::BatchEstimator &estimator, const float &trimFraction, T *dest, unsigned short *counts, unsigned short *deviations)
+			: _planes(planes), _lineSamples(lineSamples), _nullAware(nullAware), _nullValue(nullValue),
+			_estimator(estimator), _trimFraction(trimFraction), _dest(dest), _counts(counts), _deviations(deviations) {}
+
+		virtual void operator ()(const unsigned int &begin, const unsigned int &end)
 		{
-			sample = column + line * width; // precacluate array subscript
-			const int cleanZsample = cleanZData[sample];
-			if(cleanZsample != cleanZnull && cleanZsample != 0)
+			const unsigned int numPlanes = _planes.size();
+			std::vector<T> gathered(numPlanes * TILE_SAMPLES);
+			unsigned int validValues[TILE_SAMPLES];
+
+			for(unsigned int line = begin; line < end; ++line)
 			{
-				long delta = 0;
-				const int cleanZepsilon = (int)(cleanZsample * _discriminationEpsilonPercent); // margin of noise/error
-				switch(mode)
+				for(unsigned int tileStart = 0; tileStart < _lineSamples; tileStart += TILE_SAMPLES)
 				{
-				case MIN_Z:
-				case MIN_Z_ADJACENT:
-					{
-						// is the sample from the clean plate nearer to the sensor
-						// if mode == _ADJACENT, it must also be close enough in Z to an adjacent sample in the background
-						if(cleanZsample < bgZData[sample] && (mode == MIN_Z || (_bgZ.minimumDeltaToNeighbors(column, line, cleanZsample, delta) && delta <= cleanZepsilon)))
-						{
-							bgZData[sample] = cleanZsample;
-							if(foreZ)
-							{ // knock it out of foreground
-								foreZData[sample] = foreZnull;
-							} // if
-						} // if
-						break;
-					} // MIN_Z
-				case MAX_Z:
-				case MAX_Z_ADJACENT:
+					const unsigned int lineSub = line * _lineSamples + tileStart, tileSamples = std::min((unsigned int)TILE_SAMPLES, _lineSamples - tileStart);
+					std::fill(validValues, validValues + tileSamples, 0);
+					// each plane is read sequentially, and its values dealt out to the samples' slots
+					for(unsigned int plane = 0; plane < numPlanes; ++plane)
 					{
-						// is the sample from the clean plate further from the sensor
-						// if mode == _ADJACENT, it must also be close enough in Z to an adjacent sample in the background
-						if(cleanZsample > bgZData[sample] && (mode == MAX_Z || (_bgZ.minimumDeltaToNeighbors(column, line, cleanZsample, delta) && delta <= cleanZepsilon)))
+						const T *planeRow = _planes[plane] + lineSub;
+						for(unsigned int sample = 0; sample < tileSamples; ++sample)
 						{
-							bgZData[sample] = cleanZsample;
-							if(foreZ)
-							{ // knock it out of foreground
-								foreZData[sample] = foreZnull;
-							} // if
-						} // if
-						break;
-					} // MAX_Z
-				case AVERAGE_Z:
-				case AVERAGE_Z_ADJACENT:
+							const T value = planeRow[sample];
+							if(_nullAware && (value == _nullValue || value == 0)) continue;
+							gathered[sample * numPlanes + validValues[sample]++] = value;
+						} // for
+					} // for planes
+					for(unsigned int sample = 0; sample < tileSamples; ++sample)
 					{
-						// if mode == _ADJACENT, is the sample from the clean plate close enough in Z to an adjacent sample in the background?
-						if(mode == AVERAGE_Z || (_bgZ.minimumDeltaToNeighbors(column, line, cleanZsample, delta) && delta <= cleanZepsilon))
-						{
-							if(bgZData[sample] == cleanZnull) // is it a clean replacement -- no existing samples at this location
-							{ // just overwrite no-data value
-								bgZData[sample] = cleanZsample; 
-							} // if
-							else
-							{ // average together existing data values using weight and inverse weight derived from accumuation (truncate to short after add)
-								bgZData[sample] = (unsigned short)((accumWeight * (float)cleanZsample) + ((1.0f - accumWeight) * (float)bgZData[sample]));
-							} // else
-							if(foreZ)
-							{ // knock it out of foreground
-								foreZData[sample] = foreZnull;
-							} // if
-						} // if part of background
-						break;
-					} // AVERAGE_Z
-				} // mode
-			} // if not null
-		} // for column
-	} // for lines
+						const T result = estimate(&gathered[sample * numPlanes], validValues[sample]);
+						_dest[lineSub + sample] = result;
+						if(_counts) _counts[lineSub + sample] = (unsigned short)std::min(validValues[sample], 0xffffU);
+						if(_deviations) _deviations[lineSub + sample] = meanAbsoluteDeviation(&gathered[sample * numPlanes], validValues[sample], result);
+					} // for
+				} // for tiles
+			} // for lines
+		} // operator ()
+
+	private:
+		T estimate(T *values, const unsigned int &numValues) const
+		{
+			if(numValues == 0)
+			{
+				return(_nullValue);
+			} // if
+			if(numValues <= 16)
+			{ // typical batch sizes, insertion sort beats the general sort's overhead
+				for(unsigned int index = 1; index < numValues; ++index)
+				{
+					const T value = values[index];
+					unsigned int insert = index;
+					for(; insert > 0 && values[insert - 1] > value; --insert) values[insert] = values[insert - 1];
+					values[insert] = value;
+				} // for
+			} // if
+			else
+			{
+				std::sort(values, values + numValues);
+			} // else
+
+			if(_estimator == Background::MEDIAN)
+			{ // an even count rounds the mean of the middle two
+				const unsigned int middle = numValues / 2;
+				return((numValues & 1) ? values[middle] : (T)(((unsigned int)values[middle - 1] + values[middle] + 1) / 2));
+			} // if
+			// TRIMMED_MEAN, always keeping at least the middle value(s)
+			unsigned int trim = (unsigned int)(numValues * _trimFraction);
+			if(2 * trim >= numValues) trim = (numValues - 1) / 2;
+			unsigned long sum(0);
+			for(unsigned int index = trim; index < numValues - trim; ++index) sum += values[index];
+			const unsigned int kept = numValues - 2 * trim;
+			return((T)((sum + kept / 2) / kept));
+		} // estimate
+
+		unsigned short meanAbsoluteDeviation(const T *values, const unsigned int &numValues, const T &center) const
+		{
+			if(numValues == 0)
+			{
+				return(0);
+			} // if
+			unsigned long sum(0);
+			for(unsigned int index = 0; index < numValues; ++index) sum += abs((int)values[index] - (int)center);
+			return((unsigned short)std::min(((sum << RGB_FRACTION_BITS) + numValues / 2) / numValues, 0xffffUL));
+		} // meanAbsoluteDeviation
+
+		const std::vector<const T *> &_planes;
+		unsigned int _lineSamples;
+		bool _nullAware;
+		T _nullValue;
+		Background::BatchEstimator _estimator;
+		float _trimFraction;
+		T *_dest;
+		unsigned short *_counts, *_deviations;
+}; // BatchReduce
 
-	_bgZ.increaseAccumulation();
 
+// plates must all be present, with data, and match the first in size and format
+static bool checkCleanPlates(const std::vector<const livescene::Image *> &cleanPlates)
+{
+	if(cleanPlates.empty() || !cleanPlates.front() || !cleanPlates.front()->getData())
+	{
+		return(false);
+	} // if
+	const livescene::Image &first = *cleanPlates.front();
+	for(std::vector<const livescene::Image *>::const_iterator plateIt = cleanPlates.begin(); plateIt != cleanPlates.end(); ++plateIt)
+	{
+		if(!*plateIt || !(*plateIt)->getData() || (*plateIt)->getWidth() != first.getWidth() || (*plateIt)->getHeight() != first.getHeight()
+			|| (*plateIt)->getFormat() != first.getFormat() || (*plateIt)->getImageBytes() != first.getImageBytes())
+		{
+			return(false);
+		} // if
+	} // for
 	return(true);
-} // Background::accumulateZBackgroundFromCleanPlate
+} // checkCleanPlates
+
+
+bool Background::loadBackgroundFromCleanPlates(const std::vector<const livescene::Image *> &cleanPlatesRGB, const std::vector<const livescene::Image *> &cleanPlatesZ,
+	BatchEstimator estimator, float trimFraction)
+{
+	bool successZ(false), successRGB(false);
+	successRGB = loadRGBBackgroundFromCleanPlates(cleanPlatesRGB, estimator, trimFraction);
+	successZ = loadZBackgroundFromCleanPlates(cleanPlatesZ, estimator, trimFraction);
+	return(successRGB && successZ);
+} // Background::loadBackgroundFromCleanPlates
+
+bool Background::loadRGBBackgroundFromCleanPlates(const std::vector<const livescene::Image *> &cleanPlatesRGB, BatchEstimator estimator, float trimFraction)
+{
+	if(!checkCleanPlates(cleanPlatesRGB))
+	{
+		return(false);
+	} // if
+	std::vector<const unsigned char *> planes;
+	planes.reserve(cleanPlatesRGB.size());
+	for(std::vector<const livescene::Image *>::const_iterator plateIt = cleanPlatesRGB.begin(); plateIt != cleanPlatesRGB.end(); ++plateIt)
+	{
+		planes.push_back((const unsigned char *)(*plateIt)->getData());
+	} // for
+
+	livescene::Image result(*cleanPlatesRGB.front(), true); // takes on size and format, the data is all overwritten
+	const unsigned int height(result.getHeight()), numChannels(result.getImageBytes());
+	_rgbDeviation.resize(numChannels);
+	BatchReduce<unsigned char> reduce(planes, numChannels / height, false, 0, estimator, trimFraction,
+		(unsigned char *)result.getData(), 0, &_rgbDeviation.front());
+	runBandsParallel(reduce, height);
+	result.invalidateInternalStats(); // they were the first plate's
+
+	_bgRGB = result;
+	++_modelVersion; // see publishSnapshot()
+	_backgroundAvailable = true; // technically not true until you load the Z too
+	const unsigned char *bgRGBData = (const unsigned char *)_bgRGB.getData();
+	_rgbMean.resize(numChannels);
+	for(unsigned int channel = 0; channel < numChannels; ++channel)
+	{
+		_rgbMean[channel] = (unsigned short)(bgRGBData[channel] << RGB_FRACTION_BITS);
+	} // for
+	_rgbModelWeight = (unsigned short)std::min(cleanPlatesRGB.size(), (size_t)0xffff);
+	_rgbAccumulatorsValid = false; // seeded from the model, weighted by the batch size, if needed
+	updateRGBThresholds();
+	return(true);
+} // Background::loadRGBBackgroundFromCleanPlates
+
+bool Background::loadZBackgroundFromCleanPlates(const std::vector<const livescene::Image *> &cleanPlatesZ, BatchEstimator estimator, float trimFraction)
+{
+	if(!checkCleanPlates(cleanPlatesZ))
+	{
+		return(false);
+	} // if
+	std::vector<const unsigned short *> planes;
+	planes.reserve(cleanPlatesZ.size());
+	for(std::vector<const livescene::Image *>::const_iterator plateIt = cleanPlatesZ.begin(); plateIt != cleanPlatesZ.end(); ++plateIt)
+	{
+		planes.push_back((const unsigned short *)(*plateIt)->getData());
+	} // for
+
+	livescene::Image result(*cleanPlatesZ.front(), true); // takes on size, format and NULL, the data is all overwritten
+	const unsigned int width(result.getWidth()), height(result.getHeight()), numSamples(result.getSamples());
+	_zSums.resize(numSamples);
+	_zCounts.resize(numSamples);
+	std::vector<unsigned short> deviations(numSamples);
+	BatchReduce<unsigned short> reduce(planes, width, true, (unsigned short)result.getNull(), estimator, trimFraction,
+		(unsigned short *)result.getData(), &_zCounts.front(), &deviations.front());
+	runBandsParallel(reduce, height);
+	result.invalidateInternalStats(); // they were the first plate's
+
+	// seed clean-plate averaging as if every value behind each result had been accumulated
+	const unsigned short *resultData = (const unsigned short *)result.getData();
+	for(unsigned int sample = 0; sample < numSamples; ++sample)
+	{
+		_zSums[sample] = (unsigned int)resultData[sample] * _zCounts[sample];
+	} // for
+	_zAccumulatorsValid = true;
+
+	_bgZ = result;
+	++_modelVersion; // see publishSnapshot()
+	_backgroundAvailable = true; // technically not true until you load the RGB too
+	invalidateTiles();
+
+	// the batch measured the noise, so live learning and the thresholds can start from that instead of the epsilon
+	initLiveModel();
+	for(unsigned int sample = 0; sample < numSamples; ++sample)
+	{
+		if(_zCounts[sample] > 1)
+		{ // mean absolute deviation, in RGB model fixed point, to variance for normally distributed noise
+			const float stdDev = deviations[sample] * (1.25f / (1 << RGB_FRACTION_BITS));
+			_zVariance[sample] = std::max(stdDev * stdDev, 1.0f);
+		} // if
+	} // for
+	updateZThresholds();
+	return(true);
+} // Background::loadZBackgroundFromCleanPlates
+
+
+// starting variance of a newly learned Z sample, about the discrimination epsilon
+static inline float initialZVariance(const float &z, const float &discriminationEpsilonPercent)
+{
+	const float stdDev = z * discriminationEpsilonPercent;
+	return(std::max(stdDev * stdDev, 1.0f));
+} // initialZVariance
+
+// threshold for a Z sample of mean and variance: matchStdDevs standard deviations, but at least the discrimination
+// epsilon of the mean and at least minimumDelta. Extraction and the live update both match against it.
+// Capped so extraction can scale it by the colour ambiguity factor in 16 bits.
+static inline unsigned short zThreshold(const float &mean, const float &variance, const float &matchVariances,
+	const float &epsilonPercent, const unsigned short &minimumDelta)
+{
+	const float epsilon = mean * epsilonPercent;
+	const float threshold = sqrtf(std::max(variance * matchVariances, epsilon * epsilon)) + 0.5f;
+	return((unsigned short)std::min(std::max(threshold, (float)minimumDelta), (float)Background::Z_THRESHOLD_LIMIT));
+} // zThreshold
+
+
+void Background::initLiveModel(void)
+{
+	const unsigned int numSamples = _bgZ.getSamples();
+	const unsigned short *bgZData = (const unsigned short *)_bgZ.getData();
+	const unsigned short bgZnull = (unsigned short)_bgZ.getNull();
+	_zMean.resize(numSamples);
+	_zVariance.resize(numSamples);
+	_zCandidate.assign(numSamples, 0);
+	_zPersistence.assign(numSamples, 0);
+	_zMatched.clear(); // nothing matched yet, RGB learns everywhere until Z has been through once
+	for(unsigned int sample = 0; sample < numSamples; ++sample)
+	{
+		const unsigned short bgZsample = bgZData[sample];
+		const bool hasData = (bgZsample != bgZnull && bgZsample != 0);
+		_zMean[sample] = hasData ? bgZsample : -1.0f;
+		_zVariance[sample] = hasData ? initialZVariance(bgZsample, _discriminationEpsilonPercent) : 0.0f;
+	} // for
+	_liveModelValid = true;
+	updateZThresholds();
+} // Background::initLiveModel
+
+void Background::updateZThresholds(void)
+{
+	if(!_liveModelValid)
+	{
+		return; // rebuilt with the model
+	} // if
+	const unsigned int numSamples = _zVariance.size();
+	const float matchVariances = _matchStdDevs * _matchStdDevs;
+	_zThreshold.resize(numSamples);
+	++_modelVersion; // see publishSnapshot()
+	for(unsigned int sample = 0; sample < numSamples; ++sample)
+	{
+		_zThreshold[sample] = (_zMean[sample] < 0.0f) ? _minimumDiscriminationDelta :
+			zThreshold(_zMean[sample], _zVariance[sample], matchVariances, _discriminationEpsilonPercent, _minimumDiscriminationDelta);
+	} // for
+} // Background::updateZThresholds
+
+
+void Background::invalidateTiles(void)
+{
+	_tileFlagsValid = false;
+	_tileStableFrames.clear(); // scene change detection starts over too
+} // Background::invalidateTiles
+
+
+// every tile of a width by height frame
+static void listTiles(const unsigned int &width, const unsigned int &height, std::vector<unsigned int> &tiles)
+{
+	const unsigned int numTiles = ((width + Background::TILE_SIZE - 1) / Background::TILE_SIZE) * ((height + Background::TILE_SIZE - 1) / Background::TILE_SIZE);
+	tiles.resize(numTiles);
+	for(unsigned int tile = 0; tile < numTiles; ++tile) tiles[tile] = tile;
+} // listTiles
+
+// learning rate that, applied once every interval frames, learns as much as learningRate does every frame
+static inline float refreshLearningRate(const float &learningRate, const unsigned short &interval)
+{
+	return(std::min(1.0f - powf(1.0f - learningRate, interval), 0.49f)); // the RGB fixed point needs below 0.5
+} // refreshLearningRate
+
+
+/** \brief Updates the live Z model for a band of lines, see Background. */
+class ZLiveUpdate : public livescene::SpanCallback
+{
+	public:
+		ZLiveUpdate(const unsigned short *liveZData, const unsigned short &liveZnull, unsigned short *bgZData,
+			float *mean, float *variance, unsigned short *candidate, unsigned short *persistence, unsigned char *matched, unsigned short *threshold,
+			const unsigned int &width, const float &learningRate, const float &matchStdDevs, const float &epsilonPercent, const unsigned short &minimumDelta,
+			const unsigned short &absorbFrames, const unsigned short &revealFrames)
+			: _liveZData(liveZData), _liveZnull(liveZnull), _bgZData(bgZData),
+			_mean(mean), _variance(variance), _candidate(candidate), _persistence(persistence), _matched(matched), _threshold(threshold), _width(width),
+			_learningRate(learningRate), _matchVariances(matchStdDevs * matchStdDevs), _epsilonPercent(epsilonPercent), _minimumDelta(minimumDelta),
+			_absorbFrames(absorbFrames), _revealFrames(revealFrames) {}
+
+		virtual void operator ()(const unsigned int &line, const unsigned int &beginColumn, const unsigned int &endColumn)
+		{
+			const unsigned int endSample = line * _width + endColumn;
+			for(unsigned int sample = line * _width + beginColumn; sample < endSample; ++sample)
+			{
+				const unsigned short liveZsample = _liveZData[sample];
+				if(liveZsample == _liveZnull || liveZsample == 0)
+				{ // no information, leave the model as it is
+					_matched[sample] = 0;
+					continue;
+				} // if
+
+				const float z = liveZsample, mean = _mean[sample];
+				if(mean < 0.0f)
+				{ // first data at this pixel
+					learnOutright(sample, z);
+					_matched[sample] = 1;
+					continue;
+				} // if
+
+				const float delta = z - mean;
+				// the same test extraction makes, so whatever extraction calls background is learned
+				const int bgDelta = (int)liveZsample - (int)_bgZData[sample];
+				if(bgDelta <= (int)_threshold[sample] && -bgDelta <= (int)_threshold[sample])
+				{ // background, follow it
+					_mean[sample] = mean + _learningRate * delta;
+					_variance[sample] = std::max(_variance[sample] + _learningRate * (delta * delta - _variance[sample]), 1.0f);
+					_threshold[sample] = zThreshold(_mean[sample], _variance[sample], _matchVariances, _epsilonPercent, _minimumDelta);
+					_persistence[sample] = 0;
+					_matched[sample] = 1;
+				} // if
+				else
+				{ // foreground, unless it holds still long enough
+					_matched[sample] = 0;
+					const int candidateDelta = (int)liveZsample - (int)_candidate[sample];
+					const int candidateEpsilon = std::max((int)(liveZsample * _epsilonPercent), 1);
+					if(candidateDelta <= candidateEpsilon && -candidateDelta <= candidateEpsilon)
+					{
+						if(_persistence[sample] < 0xffff) ++_persistence[sample];
+					} // if
+					else
+					{ // something different arrived, start counting again
+						_candidate[sample] = liveZsample;
+						_persistence[sample] = 1;
+					} // else
+					if(_persistence[sample] >= (delta > 0.0f ? _revealFrames : _absorbFrames))
+					{
+						learnOutright(sample, z);
+					} // if
+				} // else
+				_bgZData[sample] = (unsigned short)(_mean[sample] + 0.5f);
+			} // for
+		} // operator ()
+
+	private:
+		inline void learnOutright(const unsigned int &sample, const float &z)
+		{
+			_mean[sample] = z;
+			_variance[sample] = initialZVariance(z, _epsilonPercent);
+			_threshold[sample] = zThreshold(_mean[sample], _variance[sample], _matchVariances, _epsilonPercent, _minimumDelta);
+			_persistence[sample] = 0;
+			_bgZData[sample] = (unsigned short)z;
+		}
+
+		const unsigned short *_liveZData;
+		unsigned short _liveZnull;
+		unsigned short *_bgZData;
+		float *_mean, *_variance;
+		unsigned short *_candidate, *_persistence;
+		unsigned char *_matched;
+		unsigned short *_threshold;
+		unsigned int _width;
+		float _learningRate, _matchVariances, _epsilonPercent;
+		unsigned short _minimumDelta, _absorbFrames, _revealFrames;
+}; // ZLiveUpdate
+
+
+/** \brief Relearns the live Z model outright from the live frame, for tiles after a scene change. */
+class ZRelearn : public livescene::SpanCallback
+{
+	public:
+		ZRelearn(const unsigned short *liveZData, const unsigned short &liveZnull, unsigned short *bgZData, const unsigned short &bgZnull,
+			float *mean, float *variance, unsigned short *candidate, unsigned short *persistence, unsigned char *matched, unsigned short *threshold,
+			const unsigned int &width, const float &matchStdDevs, const float &epsilonPercent, const unsigned short &minimumDelta)
+			: _liveZData(liveZData), _liveZnull(liveZnull), _bgZData(bgZData), _bgZnull(bgZnull),
+			_mean(mean), _variance(variance), _candidate(candidate), _persistence(persistence), _matched(matched), _threshold(threshold), _width(width),
+			_matchVariances(matchStdDevs * matchStdDevs), _epsilonPercent(epsilonPercent), _minimumDelta(minimumDelta) {}
+
+		virtual void operator ()(const unsigned int &line, const unsigned int &beginColumn, const unsigned int &endColumn)
+		{
+			const unsigned int endSample = line * _width + endColumn;
+			for(unsigned int sample = line * _width + beginColumn; sample < endSample; ++sample)
+			{
+				const unsigned short liveZsample = _liveZData[sample];
+				_candidate[sample] = 0;
+				_persistence[sample] = 0;
+				if(liveZsample == _liveZnull || liveZsample == 0)
+				{ // what was there before is gone, and nothing is known yet
+					_mean[sample] = -1.0f;
+					_variance[sample] = 0.0f;
+					_threshold[sample] = _minimumDelta;
+					_bgZData[sample] = _bgZnull;
+					_matched[sample] = 0;
+				} // if
+				else
+				{
+					_mean[sample] = liveZsample;
+					_variance[sample] = initialZVariance(liveZsample, _epsilonPercent);
+					_threshold[sample] = zThreshold(_mean[sample], _variance[sample], _matchVariances, _epsilonPercent, _minimumDelta);
+					_bgZData[sample] = liveZsample;
+					_matched[sample] = 1;
+				} // else
+			} // for
+		} // operator ()
+
+	private:
+		const unsigned short *_liveZData;
+		unsigned short _liveZnull;
+		unsigned short *_bgZData;
+		unsigned short _bgZnull;
+		float *_mean, *_variance;
+		unsigned short *_candidate, *_persistence;
+		unsigned char *_matched;
+		unsigned short *_threshold;
+		unsigned int _width;
+		float _matchVariances, _epsilonPercent;
+		unsigned short _minimumDelta;
+}; // ZRelearn
+
+
+/** \brief Counts, per tile, the samples that differ from the background and those of them still within the discrimination
+epsilon of the tile's reference, the live Z from when its run of changed frames began. Counts must start at zero. */
+class SceneChangeCount : public livescene::SpanCallback
+{
+	public:
+		SceneChangeCount(const unsigned short *liveZData, const unsigned short &liveZnull, const unsigned short *bgZData, const unsigned short &bgZnull,
+			const unsigned short *threshold, const unsigned short *reference, const unsigned int &width, const float &epsilonPercent,
+			const unsigned short &minimumDelta, unsigned short *changedSamples, unsigned short *stableSamples)
+			: _liveZData(liveZData), _liveZnull(liveZnull), _bgZData(bgZData), _bgZnull(bgZnull), _threshold(threshold), _reference(reference),
+			_width(width), _tilesX((width + Background::TILE_SIZE - 1) / Background::TILE_SIZE), _epsilonPercent(epsilonPercent),
+			_minimumDelta(minimumDelta), _changedSamples(changedSamples), _stableSamples(stableSamples) {}
+
+		virtual void operator ()(const unsigned int &line, const unsigned int &beginColumn, const unsigned int &endColumn)
+		{
+			const unsigned int tile = (line / Background::TILE_SIZE) * _tilesX + beginColumn / Background::TILE_SIZE;
+			unsigned int changed(0), stable(0);
+			const unsigned int endSample = line * _width + endColumn;
+			for(unsigned int sample = line * _width + beginColumn; sample < endSample; ++sample)
+			{
+				const unsigned short liveZsample = _liveZData[sample], bgZsample = _bgZData[sample];
+				if(liveZsample == _liveZnull || liveZsample == 0
+					|| (bgZsample != _bgZnull && abs((int)liveZsample - (int)bgZsample) <= (int)_threshold[sample]))
+				{
+					continue;
+				} // if
+				++changed;
+				const float tolerance = std::max(_reference[sample] * _epsilonPercent, (float)_minimumDelta);
+				if(abs((int)liveZsample - (int)_reference[sample]) <= tolerance) ++stable;
+			} // for
+			_changedSamples[tile] = (unsigned short)(_changedSamples[tile] + changed);
+			_stableSamples[tile] = (unsigned short)(_stableSamples[tile] + stable);
+		} // operator ()
+
+	private:
+		const unsigned short *_liveZData;
+		unsigned short _liveZnull;
+		const unsigned short *_bgZData;
+		unsigned short _bgZnull;
+		const unsigned short *_threshold, *_reference;
+		unsigned int _width, _tilesX;
+		float _epsilonPercent;
+		unsigned short _minimumDelta;
+		unsigned short *_changedSamples, *_stableSamples;
+}; // SceneChangeCount
+
+/** \brief Takes the live Z as the reference scene change detection compares later frames of a tile against. */
+class SceneChangeReference : public livescene::SpanCallback
+{
+	public:
+		SceneChangeReference(const unsigned short *liveZData, unsigned short *reference, const unsigned int &width)
+			: _liveZData(liveZData), _reference(reference), _width(width) {}
+
+		virtual void operator ()(const unsigned int &line, const unsigned int &beginColumn, const unsigned int &endColumn)
+		{
+			memcpy(_reference + line * _width + beginColumn, _liveZData + line * _width + beginColumn, (endColumn - beginColumn) * sizeof(unsigned short));
+		} // operator ()
+
+	private:
+		const unsigned short *_liveZData;
+		unsigned short *_reference;
+		unsigned int _width;
+}; // SceneChangeReference
 
 
-// <<<>>> not yet implemented, accumulate non-changing pixels from live stream into background
 bool Background::accumulateBackgroundFromLive(const livescene::Image &liveRGB, const livescene::Image &liveZ)
 {
-	// <<<>>>
-	return(false);
+	bool successZ(false), successRGB(false);
+	successZ = accumulateZBackgroundFromLive(liveZ); // first, RGB uses its matches
+	successRGB = accumulateRGBBackgroundFromLive(liveRGB);
+	return(successRGB && successZ);
 } // Background::accumulateBackgroundFromLive
 
+// One live update of the RGB model: mean and mean absolute deviation each move the learning rate's
+// fraction of the way toward the live value and its distance from the mean. Everything is in 16-bit
+// fixed point so eight channels go per SSE2 step, and the background color and thresholds are written
+// in the same pass.
+class RGBLiveUpdate : public livescene::SpanCallback
+{
+	public:
+		enum {CHUNK_SAMPLES = 16}; // samples whose channels' learn flags are spread out at a time, 48 channels of RGB
+
+		RGBLiveUpdate(const unsigned char *liveRGBData, unsigned char *bgRGBData, unsigned short *mean, unsigned short *deviation,
+			unsigned char *threshold, const unsigned char *matched, const unsigned int &width, const unsigned int &depth,
+			const float &learningRate, const unsigned short &deviationScale, const unsigned char &minimumDelta)
+			: _liveRGBData(liveRGBData), _bgRGBData(bgRGBData), _mean(mean), _deviation(deviation), _threshold(threshold), _matched(matched),
+			_width(width), _depth(depth), _rateQ16((short)std::min(learningRate * 65536.0f, 32767.0f)),
+			_deviationScale(deviationScale), _minimumDelta(minimumDelta) {}
+
+		virtual void operator ()(const unsigned int &line, const unsigned int &beginColumn, const unsigned int &endColumn)
+		{
+			unsigned short learn[CHUNK_SAMPLES * 4]; // per channel, 0xffff where this learns
+			if(_depth > 4) return; // not a color format
+			for(unsigned int chunkColumn = beginColumn; chunkColumn < endColumn; chunkColumn += CHUNK_SAMPLES)
+			{
+				const unsigned int chunkSamples = std::min((unsigned int)CHUNK_SAMPLES, endColumn - chunkColumn), chunkChannels = chunkSamples * _depth;
+				const unsigned int firstSample = line * _width + chunkColumn;
+				for(unsigned int sample = 0, channel = 0; sample < chunkSamples; ++sample)
+				{ // only where Z matched, spread over the channels of each sample
+					const unsigned short learnSample = (!_matched || _matched[firstSample + sample]) ? 0xffff : 0;
+					for(unsigned int sampleChannel = 0; sampleChannel < _depth; ++sampleChannel) learn[channel++] = learnSample;
+				} // for
+				updateChannels(firstSample * _depth, chunkChannels, learn);
+			} // for
+		} // operator ()
+
+	private:
+		inline void updateChannels(const unsigned int &firstChannel, const unsigned int &numChannels, const unsigned short *learn)
+		{
+			unsigned int channel(0);
+#ifdef LIVESCENE_SSE2
+			const __m128i zero = _mm_setzero_si128(), rateV = _mm_set1_epi16(_rateQ16), halfV = _mm_set1_epi16(1 << (RGB_FRACTION_BITS - 1));
+			const __m128i scaleV = _mm_set1_epi16((short)_deviationScale), minimumDeltaV = _mm_set1_epi16(_minimumDelta);
+			for(; channel + 8 <= numChannels; channel += 8)
+			{
+				const unsigned int sub = firstChannel + channel;
+				const __m128i live = _mm_slli_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(_liveRGBData + sub)), zero), RGB_FRACTION_BITS);
+				const __m128i mean = _mm_loadu_si128((const __m128i *)(_mean + sub)), deviation = _mm_loadu_si128((const __m128i *)(_deviation + sub));
+				const __m128i learnV = _mm_loadu_si128((const __m128i *)(learn + channel));
+				const __m128i difference = _mm_sub_epi16(live, mean);
+				const __m128i distance = _mm_max_epi16(difference, _mm_sub_epi16(zero, difference));
+				const __m128i newMean = _mm_add_epi16(mean, _mm_and_si128(learnV, scaleRounded(difference, rateV)));
+				const __m128i newDeviation = _mm_add_epi16(deviation, _mm_and_si128(learnV, scaleRounded(_mm_sub_epi16(distance, deviation), rateV)));
+				_mm_storeu_si128((__m128i *)(_mean + sub), newMean);
+				_mm_storeu_si128((__m128i *)(_deviation + sub), newDeviation);
+				const __m128i bg = _mm_srli_epi16(_mm_add_epi16(newMean, halfV), RGB_FRACTION_BITS);
+				_mm_storel_epi64((__m128i *)(_bgRGBData + sub), _mm_packus_epi16(bg, bg));
+				const __m128i threshold = _mm_max_epi16(_mm_mulhi_epu16(newDeviation, scaleV), minimumDeltaV);
+				_mm_storel_epi64((__m128i *)(_threshold + sub), _mm_packus_epi16(threshold, threshold)); // saturates at 255
+			} // for
+#endif // LIVESCENE_SSE2
+
+			// scalar for the remainder, or everything without SSE2. Same arithmetic as the SIMD lanes.
+			for(; channel < numChannels; ++channel)
+			{
+				if(!learn[channel]) continue;
+				const unsigned int sub = firstChannel + channel;
+				const int difference = (int)(_liveRGBData[sub] << RGB_FRACTION_BITS) - _mean[sub];
+				const int distance = abs(difference);
+				_mean[sub] = (unsigned short)(_mean[sub] + scaleRounded(difference, _rateQ16));
+				_deviation[sub] = (unsigned short)(_deviation[sub] + scaleRounded(distance - _deviation[sub], _rateQ16));
+				_bgRGBData[sub] = (unsigned char)((_mean[sub] + (1 << (RGB_FRACTION_BITS - 1))) >> RGB_FRACTION_BITS);
+				_threshold[sub] = colorThreshold(_deviation[sub], _deviationScale, _minimumDelta);
+			} // for
+		} // updateChannels
+
+		const unsigned char *_liveRGBData;
+		unsigned char *_bgRGBData;
+		unsigned short *_mean, *_deviation;
+		unsigned char *_threshold;
+		const unsigned char *_matched;
+		unsigned int _width, _depth;
+		short _rateQ16; // the learning rate as a signed multiplier, so below 0.5
+		unsigned short _deviationScale;
+		unsigned char _minimumDelta;
+}; // RGBLiveUpdate
+
+
+/** \brief Relearns the RGB mean outright from the live frame, for tiles after a scene change. The noise, and so the thresholds, stay. */
+class RGBRelearn : public livescene::SpanCallback
+{
+	public:
+		RGBRelearn(const unsigned char *liveRGBData, unsigned char *bgRGBData, unsigned short *mean, const unsigned int &width, const unsigned int &depth)
+			: _liveRGBData(liveRGBData), _bgRGBData(bgRGBData), _mean(mean), _width(width), _depth(depth) {}
+
+		virtual void operator ()(const unsigned int &line, const unsigned int &beginColumn, const unsigned int &endColumn)
+		{
+			const unsigned int endChannel = (line * _width + endColumn) * _depth;
+			for(unsigned int channel = (line * _width + beginColumn) * _depth; channel < endChannel; ++channel)
+			{
+				_mean[channel] = (unsigned short)(_liveRGBData[channel] << RGB_FRACTION_BITS);
+				_bgRGBData[channel] = _liveRGBData[channel];
+			} // for
+		} // operator ()
+
+	private:
+		const unsigned char *_liveRGBData;
+		unsigned char *_bgRGBData;
+		unsigned short *_mean;
+		unsigned int _width, _depth;
+}; // RGBRelearn
+
+
 bool Background::accumulateRGBBackgroundFromLive(const livescene::Image &liveRGB)
 {
-	// <<<>>>
-	return(false);
+	if(!_bgRGB.getData())
+	{
+		return(loadRGBBackgroundFromCleanPlate(liveRGB));
+	} // if
+	if(liveRGB.getFormat() != _bgRGB.getFormat() || liveRGB.getImageBytes() != _bgRGB.getImageBytes() || !liveRGB.getData())
+	{
+		return(false);
+	} // if
+	++_modelVersion; // see publishSnapshot()
+
+	const unsigned int width(_bgRGB.getWidth()), height(_bgRGB.getHeight());
+	const unsigned char *liveRGBData = (const unsigned char *)liveRGB.getData();
+	unsigned char *bgRGBData = (unsigned char *)_bgRGB.getData();
+	const unsigned short deviationScale = colorDeviationScale(_colorDeviations);
+	// Z's matches are only good for its tiles, so RGB follows the same tiles when it uses them
+	if(_zMatched.size() == (unsigned int)_bgRGB.getSamples())
+	{
+		RGBLiveUpdate update(liveRGBData, bgRGBData, &_rgbMean.front(), &_rgbDeviation.front(), &_rgbThreshold.front(), &_zMatched.front(),
+			width, _bgRGB.getDepth(), _learningRate, deviationScale, _colorMinimumDelta);
+		runTilesParallel(update, _changedTiles, TILE_SIZE, width, height);
+		RGBLiveUpdate refresh(liveRGBData, bgRGBData, &_rgbMean.front(), &_rgbDeviation.front(), &_rgbThreshold.front(), &_zMatched.front(),
+			width, _bgRGB.getDepth(), refreshLearningRate(_learningRate, _tileRefreshInterval), deviationScale, _colorMinimumDelta);
+		runTilesParallel(refresh, _refreshTiles, TILE_SIZE, width, height);
+		RGBRelearn relearn(liveRGBData, bgRGBData, &_rgbMean.front(), width, _bgRGB.getDepth());
+		runTilesParallel(relearn, _relearnTiles, TILE_SIZE, width, height);
+	} // if
+	else
+	{
+		std::vector<unsigned int> tiles;
+		listTiles(width, height, tiles);
+		RGBLiveUpdate update(liveRGBData, bgRGBData, &_rgbMean.front(), &_rgbDeviation.front(), &_rgbThreshold.front(), 0,
+			width, _bgRGB.getDepth(), _learningRate, deviationScale, _colorMinimumDelta);
+		runTilesParallel(update, tiles, TILE_SIZE, width, height);
+	} // else
+	_rgbModelWeight = 1;
+	_rgbAccumulatorsValid = false; // clean-plate averaging restarts from the learned model
+	return(true);
 } // Background::accumulateRGBBackgroundFromLive
 
 bool Background::accumulateZBackgroundFromLive(const livescene::Image &liveZ)
 {
-	// <<<>>>
-	return(false);
+	if(!_bgZ.getData())
+	{
+		return(loadZBackgroundFromCleanPlate(liveZ));
+	} // if
+	if(liveZ.getWidth() != _bgZ.getWidth() || liveZ.getHeight() != _bgZ.getHeight() || liveZ.getFormat() != _bgZ.getFormat() || !liveZ.getData())
+	{
+		return(false);
+	} // if
+	++_modelVersion; // see publishSnapshot()
+	if(!_liveModelValid)
+	{
+		initLiveModel();
+	} // if
+	_zMatched.resize(_bgZ.getSamples());
+
+	// changed tiles every frame, the rest in turn. Without tile flags for this background, everything.
+	// After a scene change, the tiles that have been steadily changed throughout are relearned instead.
+	const unsigned int width(_bgZ.getWidth()), height(_bgZ.getHeight());
+	listTiles(width, height, _changedTiles);
+	_refreshTiles.clear();
+	_relearnTiles.clear();
+	const bool sceneChange = detectSceneChange(liveZ);
+	const bool useFlags = _tileFlagsValid && _tileFlags.size() == _changedTiles.size();
+	if(useFlags || sceneChange)
+	{
+		const unsigned int numTiles = _changedTiles.size();
+		_changedTiles.clear();
+		for(unsigned int tile = 0; tile < numTiles; ++tile)
+		{
+			if(sceneChange && _tileStableFrames[tile] >= _sceneChangeFrames)
+			{
+				_relearnTiles.push_back(tile);
+				_tileStableFrames[tile] = 0;
+			} // if
+			else if(!useFlags || (_tileFlags[tile] & TILE_CHANGED)) _changedTiles.push_back(tile);
+			else if(tile % _tileRefreshInterval == _tileRefreshPhase) _refreshTiles.push_back(tile);
+		} // for
+		if(useFlags) _tileRefreshPhase = (_tileRefreshPhase + 1) % _tileRefreshInterval;
+	} // if
+
+	const unsigned short *liveZData = (const unsigned short *)liveZ.getData();
+	ZLiveUpdate update(liveZData, (unsigned short)liveZ.getNull(), (unsigned short *)_bgZ.getData(),
+		&_zMean.front(), &_zVariance.front(), &_zCandidate.front(), &_zPersistence.front(), &_zMatched.front(), &_zThreshold.front(), width,
+		_learningRate, _matchStdDevs, _discriminationEpsilonPercent, _minimumDiscriminationDelta, _absorbFrames, _revealFrames);
+	runTilesParallel(update, _changedTiles, TILE_SIZE, width, height);
+	ZLiveUpdate refresh(liveZData, (unsigned short)liveZ.getNull(), (unsigned short *)_bgZ.getData(),
+		&_zMean.front(), &_zVariance.front(), &_zCandidate.front(), &_zPersistence.front(), &_zMatched.front(), &_zThreshold.front(), width,
+		refreshLearningRate(_learningRate, _tileRefreshInterval), _matchStdDevs, _discriminationEpsilonPercent, _minimumDiscriminationDelta,
+		_absorbFrames, _revealFrames);
+	runTilesParallel(refresh, _refreshTiles, TILE_SIZE, width, height);
+	if(!_relearnTiles.empty())
+	{
+		ZRelearn relearn(liveZData, (unsigned short)liveZ.getNull(), (unsigned short *)_bgZ.getData(), (unsigned short)_bgZ.getNull(),
+			&_zMean.front(), &_zVariance.front(), &_zCandidate.front(), &_zPersistence.front(), &_zMatched.front(), &_zThreshold.front(), width,
+			_matchStdDevs, _discriminationEpsilonPercent, _minimumDiscriminationDelta);
+		runTilesParallel(relearn, _relearnTiles, TILE_SIZE, width, height);
+		if(_sceneChangeCallback)
+		{
+			(*_sceneChangeCallback)(*this, _relearnTiles.size());
+		} // if
+	} // if
+	_zAccumulatorsValid = false; // clean-plate averaging restarts from the learned background
+	return(true);
 } // Background::accumulateZBackgroundFromLive
 
 
+// Counts the live Z update's frames that each tile has spent mostly changed from the background, and mostly where it was
+// when that began, so that only a scene which has changed and then held still counts, not someone moving about in it.
+// True once enough tiles have done so for long enough. Only tiles the latest extraction found changed are looked at.
+bool Background::detectSceneChange(const livescene::Image &liveZ)
+{
+	const unsigned int width(_bgZ.getWidth()), height(_bgZ.getHeight()), tilesX(getTilesX()), numTiles(tilesX * getTilesY());
+	if(_sceneChangeFraction > 1.0f)
+	{
+		_tileStableFrames.clear();
+		return(false);
+	} // if
+	if(_tileStableFrames.size() != numTiles)
+	{
+		_tileStableFrames.assign(numTiles, 0);
+		_sceneChangeReference.resize(_bgZ.getSamples());
+	} // if
+	const bool useFlags = _tileFlagsValid && _tileFlags.size() == numTiles;
+	_sceneChangeTiles.clear();
+	for(unsigned int tile = 0; tile < numTiles; ++tile)
+	{
+		if(!useFlags || (_tileFlags[tile] & TILE_CHANGED)) _sceneChangeTiles.push_back(tile);
+		else _tileStableFrames[tile] = 0;
+	} // for
+	_tileChangedSamples.assign(numTiles, 0);
+	_tileStableSamples.assign(numTiles, 0);
+	const unsigned short *liveZData = (const unsigned short *)liveZ.getData();
+	SceneChangeCount count(liveZData, (unsigned short)liveZ.getNull(), (const unsigned short *)_bgZ.getData(), (unsigned short)_bgZ.getNull(),
+		&_zThreshold.front(), &_sceneChangeReference.front(), width, _discriminationEpsilonPercent, _minimumDiscriminationDelta,
+		&_tileChangedSamples.front(), &_tileStableSamples.front());
+	runTilesParallel(count, _sceneChangeTiles, TILE_SIZE, width, height);
+
+	// a tile's run carries on while enough of it is still where it was, otherwise one starts from this frame if enough of it has changed
+	_sceneChangeRestartTiles.clear();
+	unsigned int steadyTiles(0);
+	for(std::vector<unsigned int>::const_iterator tileIt = _sceneChangeTiles.begin(); tileIt != _sceneChangeTiles.end(); ++tileIt)
+	{
+		const unsigned int tile = *tileIt, tileX = (tile % tilesX) * TILE_SIZE, tileY = (tile / tilesX) * TILE_SIZE;
+		const unsigned int tileSamples = std::min((unsigned int)TILE_SIZE, width - tileX) * std::min((unsigned int)TILE_SIZE, height - tileY);
+		const float minimumSamples = std::max(_sceneChangeSampleFraction * tileSamples, 1.0f);
+		unsigned short &stableFrames = _tileStableFrames[tile];
+		if(stableFrames > 0 && _tileStableSamples[tile] >= minimumSamples)
+		{
+			if(stableFrames < 0xffff) ++stableFrames;
+		} // if
+		else
+		{
+			stableFrames = (_tileChangedSamples[tile] >= minimumSamples) ? 1 : 0;
+			if(stableFrames) _sceneChangeRestartTiles.push_back(tile);
+		} // else
+		if(stableFrames >= _sceneChangeFrames) ++steadyTiles;
+	} // for
+	SceneChangeReference reference(liveZData, &_sceneChangeReference.front(), width);
+	runTilesParallel(reference, _sceneChangeRestartTiles, TILE_SIZE, width, height);
+	return(steadyTiles > 0 && steadyTiles >= _sceneChangeFraction * numTiles);
+} // Background::detectSceneChange
+
+
 // extracts the foreground from the background plate
 bool Background::extractZBackground(const livescene::Image &liveZ, livescene::Image &foregroundZ)
 {
-	if(!_backgroundAvailable) return(false);
+	foregroundZ.setTimestamp(liveZ.getTimestamp()); // foreground belongs to the same frame
+	return(extractZBackground(liveZ.getView(), foregroundZ));
+} // Background::extractZBackground
 
-	unsigned short *bgZData = (unsigned short *)_bgZ.getData();
-	unsigned short *liveZData = (unsigned short *)liveZ.getData();
-	unsigned short *foreZData = (unsigned short *)foregroundZ.getData();
-	unsigned short foreZnull = (unsigned short)foregroundZ.getNull();
-	
-	const int maxSample = _bgZ.getSamples();
-	for(int sample = 0; sample < maxSample; ++sample)
-	{
-		const int liveZsample = liveZData[sample];
-		const int liveZepsilon = (int)(liveZsample * _discriminationEpsilonPercent); // margin of noise/error
-		// is current sample at, beyond or just in front of known background depth?
-		if(liveZsample + liveZepsilon >= bgZData[sample])
-		{ // it's background
-			foreZData[sample] = foreZnull; // mark it as null
+/** \brief Totals of the foreground found on one line by extractZRow(). */
+struct ExtractionRowTotals
+{
+	ExtractionRowTotals() : count(0), sumX(0), sumXX(0), sumZ(0), sumZZ(0), firstColumn(-1), lastColumn(-1), minZ(0xffff), maxZ(0) {}
+	unsigned long count;
+	double sumX, sumXX, sumZ, sumZZ;
+	int firstColumn, lastColumn; // -1 if nothing found
+	unsigned short minZ, maxZ;
+}; // ExtractionRowTotals
+
+
+// Marks, per sample of one line, whether any channel of the live color is farther from the background
+// color than that channel's threshold. channelChanges is scratch of a line's channels.
+static void findColorChangesRow(const unsigned char *liveRow, const unsigned char *bgRow, const unsigned char *thresholdRow,
+	const unsigned int &width, const unsigned int &depth, unsigned char *channelChanges, unsigned char *colorRow)
+{
+	const unsigned int lineChannels = width * depth;
+	unsigned int channel(0);
+#ifdef LIVESCENE_SSE2
+	const __m128i zero = _mm_setzero_si128(), allOnes = _mm_set1_epi8(-1);
+	for(; channel + 16 <= lineChannels; channel += 16)
+	{
+		const __m128i live = _mm_loadu_si128((const __m128i *)(liveRow + channel)), bg = _mm_loadu_si128((const __m128i *)(bgRow + channel));
+		const __m128i distance = _mm_or_si128(_mm_subs_epu8(live, bg), _mm_subs_epu8(bg, live));
+		const __m128i withinThreshold = _mm_cmpeq_epi8(_mm_subs_epu8(distance, _mm_loadu_si128((const __m128i *)(thresholdRow + channel))), zero);
+		_mm_storeu_si128((__m128i *)(channelChanges + channel), _mm_xor_si128(withinThreshold, allOnes));
+	} // for
+#endif // LIVESCENE_SSE2
+	for(; channel < lineChannels; ++channel)
+	{
+		channelChanges[channel] = (abs((int)liveRow[channel] - (int)bgRow[channel]) > thresholdRow[channel]) ? 0xff : 0;
+	} // for
+
+	for(unsigned int column = 0; column < width; ++column)
+	{
+		unsigned char changed(0);
+		for(unsigned int sampleChannel = 0; sampleChannel < depth; ++sampleChannel) changed |= channelChanges[column * depth + sampleChannel];
+		colorRow[column] = changed;
+	} // for
+} // findColorChangesRow
+
+
+// ORs flag into the tiles of tileRow under eight samples starting at absColumn, for the samples with bits set
+// in a _mm_movemask_epi8() of 16-bit lanes. Eight samples span at most two tiles.
+static inline void markTiles(unsigned char *tileRow, const unsigned int &absColumn, const unsigned int &bits, const unsigned char &flag)
+{
+	if(!bits) return;
+	const unsigned int firstTile = absColumn / Background::TILE_SIZE, lanesInFirst = (firstTile + 1) * Background::TILE_SIZE - absColumn;
+	if(lanesInFirst >= 8 || (bits & ((1U << (2 * lanesInFirst)) - 1))) tileRow[firstTile] |= flag;
+	if(lanesInFirst < 8 && (bits >> (2 * lanesInFirst))) tileRow[firstTile + 1] |= flag;
+} // markTiles
+
+
+// Classifies one line of live Z against the background and writes the foreground and mask.
+// A live sample is foreground if it is valid and nearer than the background by more than the
+// background sample's threshold (thresholdRow), or if the background has no data there (NULL or zero counts as infinitely far).
+// With COLOR, colorRow (from findColorChangesRow) decides instead where live and background are both valid and
+// within (threshold * bandFactorQ12) >> 12 of each other, and marks NULL live samples that changed color as MASK_FOREGROUND_NO_Z.
+// columnOffset is added to column numbers for the X totals and tiles. tileRow is the tile flags of the line's
+// tile row: tiles with valid live samples beyond the threshold either way, or foreground, are marked TILE_CHANGED,
+// and tiles with foreground TILE_OCCUPIED. Samples must be below 32768, which covers raw and millimeter depth.
+template <bool COLOR>
+static void extractZRow(const unsigned short *liveRow, const unsigned short *bgRow, unsigned short *foreRow, unsigned char *maskRow,
+	const unsigned int &width, const unsigned int &columnOffset, const unsigned short &liveNull, const unsigned short &bgNull, const unsigned short &foreNull,
+	const unsigned short *thresholdRow, const unsigned char *colorRow, const unsigned short &bandFactorQ12, unsigned char *tileRow, ExtractionRowTotals &totals)
+{
+	unsigned int column(0);
+#ifdef LIVESCENE_SSE2
+	const __m128i zero = _mm_setzero_si128(), ones16 = _mm_set1_epi16(1), eight16 = _mm_set1_epi16(8), farthest16 = _mm_set1_epi16(0x7fff);
+	const __m128i liveNullV = _mm_set1_epi16((short)liveNull), bgNullV = _mm_set1_epi16((short)bgNull), foreNullV = _mm_set1_epi16((short)foreNull);
+	const __m128i bandFactorV = _mm_set1_epi16((short)bandFactorQ12);
+	const __m128i noZBytes = _mm_set1_epi8((char)Background::MASK_FOREGROUND_NO_Z);
+	__m128i columnV = _mm_add_epi16(_mm_set1_epi16((short)columnOffset), _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7));
+	// 32-bit lanes can't overflow within one line; sums of squared Z can, so those go straight to 64-bit lanes
+	__m128i sumX32 = zero, sumXX32 = zero, sumZ32 = zero, sumZZ64 = zero, minZV = farthest16, maxZV = zero;
+	int lastColumnBase(-1);
+	unsigned int lastColumnBits(0);
+	for(; column + 8 <= width; column += 8)
+	{
+		const __m128i live = _mm_loadu_si128((const __m128i *)(liveRow + column));
+		const __m128i bg = _mm_loadu_si128((const __m128i *)(bgRow + column));
+		const __m128i liveInvalid = _mm_or_si128(_mm_cmpeq_epi16(live, liveNullV), _mm_cmpeq_epi16(live, zero));
+		const __m128i bgFar = _mm_or_si128(_mm_cmpeq_epi16(bg, bgNullV), _mm_cmpeq_epi16(bg, zero));
+		const __m128i threshold = _mm_loadu_si128((const __m128i *)(thresholdRow + column));
+		__m128i decided = _mm_cmplt_epi16(_mm_add_epi16(live, threshold), bg); // nearer
+		const __m128i changed = _mm_andnot_si128(liveInvalid, _mm_or_si128(_mm_or_si128(bgFar, decided), _mm_cmplt_epi16(_mm_add_epi16(bg, threshold), live)));
+		__m128i colorOnly = zero;
+		if(COLOR)
+		{
+			const __m128i colorBytes = _mm_loadl_epi64((const __m128i *)(colorRow + column));
+			const __m128i colorChanged = _mm_unpacklo_epi8(colorBytes, colorBytes);
+			const __m128i band = _mm_mulhi_epu16(_mm_slli_epi16(threshold, 4), bandFactorV);
+			const __m128i unambiguous = _mm_or_si128(_mm_cmplt_epi16(_mm_add_epi16(live, band), bg), _mm_cmplt_epi16(_mm_add_epi16(bg, band), live));
+			decided = _mm_or_si128(_mm_and_si128(unambiguous, decided), _mm_andnot_si128(unambiguous, colorChanged));
+			colorOnly = _mm_and_si128(liveInvalid, colorChanged);
 		} // if
-		else
+		const __m128i foreground = _mm_andnot_si128(liveInvalid, _mm_or_si128(bgFar, decided));
+		const __m128i foregroundZ = _mm_and_si128(foreground, live);
+
+		_mm_storeu_si128((__m128i *)(foreRow + column), _mm_or_si128(foregroundZ, _mm_andnot_si128(foreground, foreNullV)));
+		__m128i maskBytes = _mm_packs_epi16(foreground, foreground); // 0xffff/0 lanes to 0xff/0 bytes
+		if(COLOR)
+		{
+			maskBytes = _mm_or_si128(maskBytes, _mm_and_si128(_mm_packs_epi16(colorOnly, colorOnly), noZBytes));
+		} // if
+		_mm_storel_epi64((__m128i *)(maskRow + column), maskBytes);
+
+		const unsigned int foregroundBits = _mm_movemask_epi8(foreground); // two bits per lane
+		const unsigned int occupiedBits = COLOR ? (foregroundBits | _mm_movemask_epi8(colorOnly)) : foregroundBits;
+		markTiles(tileRow, columnOffset + column, _mm_movemask_epi8(changed) | occupiedBits, Background::TILE_CHANGED);
+		markTiles(tileRow, columnOffset + column, occupiedBits, Background::TILE_OCCUPIED);
+		if(foregroundBits)
+		{
+			totals.count += countBits(foregroundBits) >> 1;
+			if(totals.firstColumn < 0)
+			{
+				totals.firstColumn = column + (lowestBit(foregroundBits) >> 1);
+			} // if
+			lastColumnBase = column;
+			lastColumnBits = foregroundBits;
+
+			const __m128i foregroundX = _mm_and_si128(foreground, columnV);
+			sumX32 = _mm_add_epi32(sumX32, _mm_madd_epi16(foregroundX, ones16));
+			sumXX32 = _mm_add_epi32(sumXX32, _mm_madd_epi16(foregroundX, foregroundX));
+			sumZ32 = _mm_add_epi32(sumZ32, _mm_madd_epi16(foregroundZ, ones16));
+			const __m128i squaresZ = _mm_madd_epi16(foregroundZ, foregroundZ);
+			sumZZ64 = _mm_add_epi64(sumZZ64, _mm_add_epi64(_mm_unpacklo_epi32(squaresZ, zero), _mm_unpackhi_epi32(squaresZ, zero)));
+			minZV = _mm_min_epi16(minZV, _mm_or_si128(foregroundZ, _mm_andnot_si128(foreground, farthest16)));
+			maxZV = _mm_max_epi16(maxZV, foregroundZ);
+		} // if
+		columnV = _mm_add_epi16(columnV, eight16);
+	} // for
+	if(lastColumnBase >= 0)
+	{
+		totals.lastColumn = lastColumnBase + (highestBit(lastColumnBits) >> 1);
+	} // if
+
+	// fold the lanes down
+	unsigned int lanes32[4];
+	_mm_storeu_si128((__m128i *)lanes32, sumX32);
+	totals.sumX = (double)lanes32[0] + lanes32[1] + lanes32[2] + lanes32[3];
+	_mm_storeu_si128((__m128i *)lanes32, sumXX32);
+	totals.sumXX = (double)lanes32[0] + lanes32[1] + lanes32[2] + lanes32[3];
+	_mm_storeu_si128((__m128i *)lanes32, sumZ32);
+	totals.sumZ = (double)lanes32[0] + lanes32[1] + lanes32[2] + lanes32[3];
+	unsigned int lanes64[4]; // two 64-bit lanes, read as halves to stay within C++98 types
+	_mm_storeu_si128((__m128i *)lanes64, sumZZ64);
+	totals.sumZZ = (double)lanes64[0] + (double)lanes64[1] * 4294967296.0 + (double)lanes64[2] + (double)lanes64[3] * 4294967296.0;
+	short lanes16[8];
+	_mm_storeu_si128((__m128i *)lanes16, minZV);
+	for(unsigned int lane = 0; lane < 8; ++lane) totals.minZ = std::min(totals.minZ, (unsigned short)lanes16[lane]);
+	_mm_storeu_si128((__m128i *)lanes16, maxZV);
+	for(unsigned int lane = 0; lane < 8; ++lane) totals.maxZ = std::max(totals.maxZ, (unsigned short)lanes16[lane]);
+#endif // LIVESCENE_SSE2
+
+	// scalar for the remainder, or the whole line without SSE2
+	for(; column < width; ++column)
+	{
+		const unsigned short liveZsample = liveRow[column], bgZsample = bgRow[column];
+		const bool liveValid = (liveZsample != liveNull && liveZsample != 0);
+		const bool bgFar = (bgZsample == bgNull || bgZsample == 0);
+		const unsigned int threshold = thresholdRow[column]; // margin of noise/error
+		// is current sample nearer than known background depth, by more than the margin?
+		bool decided = (liveZsample + threshold < bgZsample);
+		unsigned char tileFlags = (liveValid && (bgFar || decided || bgZsample + threshold < liveZsample)) ? (unsigned char)Background::TILE_CHANGED : 0;
+		if(COLOR)
+		{ // too close to call by depth, go by color
+			const unsigned int band = (threshold * bandFactorQ12) >> 12;
+			if(!(liveZsample + band < bgZsample) && !(bgZsample + band < liveZsample)) decided = (colorRow[column] != 0);
+		} // if
+		if(liveValid && (bgFar || decided))
 		{ // it's foreground
-			foreZData[sample] = liveZsample; // copy it over
+			foreRow[column] = liveZsample; // copy it over
+			maskRow[column] = 0xff;
+			const double X = columnOffset + column;
+			++totals.count;
+			totals.sumX += X;
+			totals.sumXX += X * X;
+			totals.sumZ += liveZsample;
+			totals.sumZZ += (double)liveZsample * liveZsample;
+			if(totals.firstColumn < 0) totals.firstColumn = column;
+			totals.lastColumn = column;
+			totals.minZ = std::min(totals.minZ, liveZsample);
+			totals.maxZ = std::max(totals.maxZ, liveZsample);
+			tileFlags = Background::TILE_CHANGED | Background::TILE_OCCUPIED;
+		} // if
+		else
+		{ // it's background
+			foreRow[column] = foreNull; // mark it as null
+			// unless the color says otherwise where there's no depth to go by
+			maskRow[column] = (COLOR && !liveValid && colorRow[column]) ? (unsigned char)Background::MASK_FOREGROUND_NO_Z : 0;
+			if(maskRow[column]) tileFlags = Background::TILE_CHANGED | Background::TILE_OCCUPIED;
 		} // else
+		tileRow[(columnOffset + column) / Background::TILE_SIZE] |= tileFlags;
 	} // for
+} // extractZRow
+
 
-	return(false);
+bool Background::extractZBackground(const livescene::ImageView &liveZ, livescene::Image &foregroundZ)
+{
+	return(extractForeground(liveZ, 0, foregroundZ));
+} // Background::extractZBackground
+
+bool Background::extractZBackground(const livescene::Image &liveZ, const livescene::Image &liveRGB, livescene::Image &foregroundZ)
+{
+	return(extractForeground(liveZ.getView(), &liveRGB, foregroundZ));
 } // Background::extractZBackground
 
+bool Background::extractZBackground(const livescene::ImageView &liveZ, const livescene::Image &liveRGB, livescene::Image &foregroundZ)
+{
+	return(extractForeground(liveZ, &liveRGB, foregroundZ));
+} // Background::extractZBackground
+
+bool Background::extractZBackground(const livescene::BackgroundSnapshot &snapshot, const livescene::Image &liveZ,
+	livescene::Image &foregroundZ, livescene::BackgroundExtraction &extraction)
+{
+	foregroundZ.setTimestamp(liveZ.getTimestamp());
+	return(extractZBackground(snapshot, liveZ.getView(), foregroundZ, extraction));
+} // Background::extractZBackground
+
+bool Background::extractZBackground(const livescene::BackgroundSnapshot &snapshot, const livescene::ImageView &liveZ,
+	livescene::Image &foregroundZ, livescene::BackgroundExtraction &extraction)
+{
+	return(extractForeground(snapshot._bgZ, snapshot._bgRGB, snapshot._zThreshold, snapshot._rgbThreshold, snapshot._colorAmbiguityFactor,
+		liveZ, 0, foregroundZ, extraction));
+} // Background::extractZBackground
+
+bool Background::extractZBackground(const livescene::BackgroundSnapshot &snapshot, const livescene::Image &liveZ, const livescene::Image &liveRGB,
+	livescene::Image &foregroundZ, livescene::BackgroundExtraction &extraction)
+{
+	foregroundZ.setTimestamp(liveZ.getTimestamp());
+	return(extractZBackground(snapshot, liveZ.getView(), liveRGB, foregroundZ, extraction));
+} // Background::extractZBackground
+
+bool Background::extractZBackground(const livescene::BackgroundSnapshot &snapshot, const livescene::ImageView &liveZ, const livescene::Image &liveRGB,
+	livescene::Image &foregroundZ, livescene::BackgroundExtraction &extraction)
+{
+	return(extractForeground(snapshot._bgZ, snapshot._bgRGB, snapshot._zThreshold, snapshot._rgbThreshold, snapshot._colorAmbiguityFactor,
+		liveZ, &liveRGB, foregroundZ, extraction));
+} // Background::extractZBackground
+
+bool Background::extractForeground(const livescene::ImageView &liveZ, const livescene::Image *liveRGB, livescene::Image &foregroundZ)
+{
+	if(!_backgroundAvailable) return(false);
+	if(!_liveModelValid)
+	{
+		initLiveModel(); // for the thresholds
+	} // if
+	if(!extractForeground(_bgZ, _bgRGB, _zThreshold, _rgbThreshold, _colorAmbiguityFactor, liveZ, liveRGB, foregroundZ, _extraction))
+	{
+		return(false);
+	} // if
+	useExtraction(_extraction);
+	return(true);
+} // Background::extractForeground
+
+void Background::useExtraction(const livescene::BackgroundExtraction &extraction)
+{
+	const unsigned int tilesX = getTilesX();
+	if(extraction._tileFlags.size() != tilesX * getTilesY())
+	{
+		return; // of another background
+	} // if
+	_tileFlags = extraction._tileFlags;
+	_tileFlagsValid = true;
+} // Background::useExtraction
+
+// Reads only the planes and thresholds it is given, and writes only foregroundZ and extraction, so it is the
+// same against the Background and against a snapshot, and any number can run at once with their own extraction.
+bool Background::extractForeground(const livescene::Image &bgZ, const livescene::Image &bgRGB, const std::vector<unsigned short> &zThreshold,
+	const std::vector<unsigned char> &rgbThreshold, const float &colorAmbiguityFactor,
+	const livescene::ImageView &liveZ, const livescene::Image *liveRGB, livescene::Image &foregroundZ, livescene::BackgroundExtraction &extraction)
+{
+	if(!bgZ.getData() || zThreshold.size() != (unsigned int)bgZ.getSamples() || !foregroundZ.getData() || liveZ.isEmpty()) return(false);
+	// background, foreground and the live frame share one layout
+	if(liveZ.getParentWidth() != bgZ.getWidth() || liveZ.getParentHeight() != bgZ.getHeight()
+		|| foregroundZ.getWidth() != bgZ.getWidth() || foregroundZ.getHeight() != bgZ.getHeight())
+	{
+		return(false);
+	} // if
+	// and so does the color, when there is any
+	if(liveRGB && (!liveRGB->getData() || !bgRGB.getData() || liveRGB->getWidth() != bgZ.getWidth() || liveRGB->getHeight() != bgZ.getHeight()
+		|| liveRGB->getFormat() != bgRGB.getFormat() || liveRGB->getImageBytes() != bgRGB.getImageBytes()
+		|| rgbThreshold.size() != (unsigned int)bgRGB.getImageBytes()))
+	{
+		return(false);
+	} // if
+	if(extraction._foregroundMask.size() != (unsigned int)bgZ.getSamples())
+	{
+		extraction._foregroundMask.assign(bgZ.getSamples(), 0);
+	} // if
+	// tiles outside the view keep whatever they had, so start out changed in case the view never covers them
+	const unsigned int tilesX = (bgZ.getWidth() + TILE_SIZE - 1) / TILE_SIZE, tilesY = (bgZ.getHeight() + TILE_SIZE - 1) / TILE_SIZE;
+	std::vector<unsigned char> &tileFlags = extraction._tileFlags;
+	if(tileFlags.size() != tilesX * tilesY)
+	{
+		tileFlags.assign(tilesX * tilesY, (unsigned char)TILE_CHANGED);
+	} // if
+	const unsigned int firstTileX = liveZ.getOriginX() / TILE_SIZE, endTileX = (liveZ.getOriginX() + liveZ.getWidth() + TILE_SIZE - 1) / TILE_SIZE;
+	const unsigned int firstTileY = liveZ.getOriginY() / TILE_SIZE, endTileY = (liveZ.getOriginY() + liveZ.getHeight() + TILE_SIZE - 1) / TILE_SIZE;
+	for(unsigned int tileY = firstTileY; tileY < endTileY; ++tileY)
+	{
+		std::fill(tileFlags.begin() + tileY * tilesX + firstTileX, tileFlags.begin() + tileY * tilesX + endTileX, (unsigned char)0);
+	} // for
+	extraction._firstTileX = firstTileX; extraction._endTileX = endTileX;
+	extraction._firstTileY = firstTileY; extraction._endTileY = endTileY;
+
+	const unsigned short *bgZData = (const unsigned short *)bgZ.getData();
+	unsigned short *foreZData = (unsigned short *)foregroundZ.getData();
+	const unsigned short liveZnull = (unsigned short)liveZ.getNull(), bgZnull = (unsigned short)bgZ.getNull(), foreZnull = (unsigned short)foregroundZ.getNull();
+	const unsigned int stride = liveZ.getStride();
+	const unsigned short bandFactorQ12 = (unsigned short)std::min(colorAmbiguityFactor * 4096.0f, 65535.0f);
+	const unsigned int depthRGB = liveRGB ? bgRGB.getDepth() : 0;
+	if(liveRGB)
+	{
+		extraction._colorChannelChanges.resize(liveZ.getWidth() * depthRGB);
+		extraction._colorChanges.resize(liveZ.getWidth());
+	} // if
+
+	unsigned long count(0);
+	double sumX(0.0), sumY(0.0), sumZ(0.0), sumXX(0.0), sumYY(0.0), sumZZ(0.0);
+	unsigned int minX(liveZ.getParentWidth()), maxX(0), minY(liveZ.getParentHeight()), maxY(0);
+	unsigned short minZ(0xffff), maxZ(0);
+	for(unsigned int line = 0; line < liveZ.getHeight(); ++line)
+	{
+		// background and foreground share the live frame's layout, so step them to the same region
+		const unsigned int rowSub = (liveZ.getOriginY() + line) * stride + liveZ.getOriginX();
+		unsigned char *tileRow = &tileFlags[((liveZ.getOriginY() + line) / TILE_SIZE) * tilesX];
+		ExtractionRowTotals rowTotals;
+		if(liveRGB)
+		{
+			const unsigned int rowSubRGB = rowSub * depthRGB;
+			findColorChangesRow((const unsigned char *)liveRGB->getData() + rowSubRGB, (const unsigned char *)bgRGB.getData() + rowSubRGB,
+				&rgbThreshold[rowSubRGB], liveZ.getWidth(), depthRGB, &extraction._colorChannelChanges.front(), &extraction._colorChanges.front());
+			extractZRow<true>(liveZ.getRow(line), bgZData + rowSub, foreZData + rowSub, &extraction._foregroundMask[rowSub],
+				liveZ.getWidth(), liveZ.getOriginX(), liveZnull, bgZnull, foreZnull, &zThreshold[rowSub], &extraction._colorChanges.front(),
+				bandFactorQ12, tileRow, rowTotals);
+		} // if
+		else
+		{
+			extractZRow<false>(liveZ.getRow(line), bgZData + rowSub, foreZData + rowSub, &extraction._foregroundMask[rowSub],
+				liveZ.getWidth(), liveZ.getOriginX(), liveZnull, bgZnull, foreZnull, &zThreshold[rowSub], 0, 0, tileRow, rowTotals);
+		} // else
+		if(rowTotals.count)
+		{
+			const double Y = liveZ.getOriginY() + line;
+			count += rowTotals.count;
+			sumX += rowTotals.sumX;
+			sumXX += rowTotals.sumXX;
+			sumY += Y * rowTotals.count;
+			sumYY += Y * Y * rowTotals.count;
+			sumZ += rowTotals.sumZ;
+			sumZZ += rowTotals.sumZZ;
+			minX = std::min(minX, liveZ.getOriginX() + rowTotals.firstColumn);
+			maxX = std::max(maxX, liveZ.getOriginX() + rowTotals.lastColumn);
+			minY = std::min(minY, (unsigned int)Y);
+			maxY = (unsigned int)Y;
+			minZ = std::min(minZ, rowTotals.minZ);
+			maxZ = std::max(maxZ, rowTotals.maxZ);
+		} // if
+	} // for lines
+
+	extraction._foregroundCount = count;
+	if(count)
+	{
+		extraction._foregroundMinX = minX; extraction._foregroundMinY = minY;
+		extraction._foregroundMaxX = maxX; extraction._foregroundMaxY = maxY;
+	} // if
+	else
+	{
+		extraction._foregroundMinX = extraction._foregroundMinY = extraction._foregroundMaxX = extraction._foregroundMaxY = 0;
+	} // else
+
+	// the totals only describe the whole foreground image if the whole frame was extracted
+	if(liveZ.getWidth() == foregroundZ.getWidth() && liveZ.getHeight() == foregroundZ.getHeight())
+	{
+		livescene::ImageStatistics statX, statY, statZ;
+		statX.setFromSums(count, sumX, sumXX, minX, maxX);
+		statY.setFromSums(count, sumY, sumYY, minY, maxY);
+		statZ.setFromSums(count, sumZ, sumZZ, minZ, maxZ);
+		foregroundZ.setInternalStatsXYZ(statX, statY, statZ);
+	} // if
+	else
+	{
+		foregroundZ.invalidateInternalStats();
+	} // else
+
+	return(true);
+} // Background::extractForeground
+
+
+
+// Saved model file layout, all in the saving machine's byte order (the header's byteOrder field catches a mismatch):
+//   BackgroundFileHeader
+//   BackgroundFileChunk table, numChunks entries
+//   chunk data, each chunk starting on a BACKGROUND_FILE_ALIGNMENT boundary so planes can be used straight from a mapping
+// Readers skip chunks they don't know, so new chunks don't need a new version. The version only changes when
+// the meaning of an existing chunk does.
+
+static const char BACKGROUND_FILE_MAGIC[8] = {'L', 'S', 'B', 'G', 'M', 'D', 'L', 0};
+static const unsigned int BACKGROUND_FILE_VERSION = 1, BACKGROUND_FILE_BYTE_ORDER = 0x01020304, BACKGROUND_FILE_ALIGNMENT = 4096;
+
+#define LIVESCENE_CHUNK_ID(a, b, c, d) ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+enum BackgroundChunkID {
+	CHUNK_PARAMETERS = LIVESCENE_CHUNK_ID('P', 'A', 'R', 'M'),
+	CHUNK_Z_IMAGE = LIVESCENE_CHUNK_ID('Z', 'I', 'M', 'G'), // BackgroundFileImage
+	CHUNK_Z_DATA = LIVESCENE_CHUNK_ID('Z', 'D', 'A', 'T'),
+	CHUNK_RGB_IMAGE = LIVESCENE_CHUNK_ID('C', 'I', 'M', 'G'), // BackgroundFileImage
+	CHUNK_RGB_DATA = LIVESCENE_CHUNK_ID('C', 'D', 'A', 'T'),
+	CHUNK_Z_MEAN = LIVESCENE_CHUNK_ID('Z', 'M', 'E', 'A'),
+	CHUNK_Z_VARIANCE = LIVESCENE_CHUNK_ID('Z', 'V', 'A', 'R'),
+	CHUNK_Z_CANDIDATE = LIVESCENE_CHUNK_ID('Z', 'C', 'A', 'N'),
+	CHUNK_Z_PERSISTENCE = LIVESCENE_CHUNK_ID('Z', 'P', 'E', 'R'),
+	CHUNK_Z_MATCHED = LIVESCENE_CHUNK_ID('Z', 'M', 'A', 'T'),
+	CHUNK_Z_SUMS = LIVESCENE_CHUNK_ID('Z', 'S', 'U', 'M'),
+	CHUNK_Z_COUNTS = LIVESCENE_CHUNK_ID('Z', 'C', 'N', 'T'),
+	CHUNK_RGB_MEAN = LIVESCENE_CHUNK_ID('C', 'M', 'E', 'A'),
+	CHUNK_RGB_DEVIATION = LIVESCENE_CHUNK_ID('C', 'D', 'E', 'V'),
+	CHUNK_RGB_SUMS = LIVESCENE_CHUNK_ID('C', 'S', 'U', 'M'),
+	CHUNK_RGB_SUM_SQUARES = LIVESCENE_CHUNK_ID('C', 'S', 'S', 'Q'),
+};
+#undef LIVESCENE_CHUNK_ID
+
+// every field is four bytes, so the layout is the same for every compiler
+struct BackgroundFileHeader
+{
+	char magic[8];
+	unsigned int version, byteOrder, numChunks, reserved;
+}; // BackgroundFileHeader
+
+struct BackgroundFileChunk
+{
+	unsigned int id, elementBytes, numElements, offset;
+}; // BackgroundFileChunk
+
+struct BackgroundFileImage
+{
+	unsigned int width, height, depth, format, nullValue, accumulation;
+}; // BackgroundFileImage
+
+// the tuning fields record how the model was learned, load() leaves the caller's own tuning alone
+struct BackgroundFileParameters
+{
+	enum {LIVE_MODEL_VALID = 1, Z_ACCUMULATORS_VALID = 2, RGB_ACCUMULATORS_VALID = 4};
+	float discriminationEpsilonPercent, learningRate, matchStdDevs, colorDeviations, colorAmbiguityFactor;
+	unsigned int absorbFrames, revealFrames, colorMinimumDelta, rgbModelWeight, rgbAccumulations, flags;
+}; // BackgroundFileParameters
+
+
+// collects the chunks to save, then lays them out and writes them
+class BackgroundFileWriter
+{
+	public:
+		void add(const unsigned int &id, const void *data, const unsigned int &elementBytes, const unsigned int &numElements)
+		{
+			if(numElements == 0) return; // an empty plane is the same as a missing one
+			BackgroundFileChunk chunk = {id, elementBytes, numElements, 0};
+			_chunks.push_back(chunk);
+			_data.push_back(data);
+		} // add
+		template <typename T>
+		void add(const unsigned int &id, const std::vector<T> &plane) {if(!plane.empty()) add(id, &plane.front(), sizeof(T), plane.size());}
+
+		bool write(const std::string &fileName)
+		{
+			BackgroundFileHeader header;
+			memcpy(header.magic, BACKGROUND_FILE_MAGIC, sizeof(header.magic));
+			header.version = BACKGROUND_FILE_VERSION;
+			header.byteOrder = BACKGROUND_FILE_BYTE_ORDER;
+			header.numChunks = _chunks.size();
+			header.reserved = 0;
+			unsigned int offset = sizeof(header) + _chunks.size() * sizeof(BackgroundFileChunk);
+			for(std::vector<BackgroundFileChunk>::iterator chunkIt = _chunks.begin(); chunkIt != _chunks.end(); ++chunkIt)
+			{
+				offset = alignUp(offset);
+				chunkIt->offset = offset;
+				offset += chunkIt->elementBytes * chunkIt->numElements;
+			} // for
+
+			// written beside the target and renamed over it once complete, so a crash mid-save leaves the last good model
+			const std::string tempFileName = fileName + ".tmp";
+			FILE *file = fopen(tempFileName.c_str(), "wb");
+			if(!file)
+			{
+				return(false);
+			} // if
+			bool success = (fwrite(&header, sizeof(header), 1, file) == 1)
+				&& (_chunks.empty() || fwrite(&_chunks.front(), sizeof(BackgroundFileChunk), _chunks.size(), file) == _chunks.size());
+			unsigned int position = sizeof(header) + _chunks.size() * sizeof(BackgroundFileChunk);
+			const std::vector<char> padding(BACKGROUND_FILE_ALIGNMENT, 0);
+			for(unsigned int chunk = 0; success && chunk < _chunks.size(); ++chunk)
+			{
+				const unsigned int chunkBytes = _chunks[chunk].elementBytes * _chunks[chunk].numElements;
+				success = fwrite(&padding.front(), 1, _chunks[chunk].offset - position, file) == _chunks[chunk].offset - position
+					&& fwrite(_data[chunk], 1, chunkBytes, file) == chunkBytes;
+				position = _chunks[chunk].offset + chunkBytes;
+			} // for
+			success = (fflush(file) == 0) && success;
+#ifndef WIN32
+			success = success && (fsync(fileno(file)) == 0); // on the disk before it replaces the old one
+#endif // WIN32
+			success = (fclose(file) == 0) && success;
+#ifdef WIN32
+			// rename() won't replace an existing file here
+			if(success)
+			{
+				remove(fileName.c_str());
+			} // if
+#endif // WIN32
+			success = success && (rename(tempFileName.c_str(), fileName.c_str()) == 0);
+			if(!success)
+			{
+				remove(tempFileName.c_str());
+			} // if
+			return(success);
+		} // write
+
+	private:
+		static unsigned int alignUp(const unsigned int &offset) {return((offset + BACKGROUND_FILE_ALIGNMENT - 1) / BACKGROUND_FILE_ALIGNMENT * BACKGROUND_FILE_ALIGNMENT);}
+
+		std::vector<BackgroundFileChunk> _chunks;
+		std::vector<const void *> _data;
+}; // BackgroundFileWriter
+
+
+// a read-only view of a whole file: memory-mapped where that's available, otherwise read into memory
+class BackgroundFileReader
+{
+	public:
+		BackgroundFileReader(const std::string &fileName) : _contents(0), _size(0), _mapped(false)
+		{
+#ifndef WIN32
+			const int descriptor = open(fileName.c_str(), O_RDONLY);
+			if(descriptor >= 0)
+			{
+				struct stat status;
+				if(fstat(descriptor, &status) == 0 && status.st_size > 0)
+				{
+					void *mapping = mmap(0, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+					if(mapping != MAP_FAILED)
+					{
+						_contents = (const char *)mapping;
+						_size = status.st_size;
+						_mapped = true;
+					} // if
+				} // if
+				close(descriptor);
+			} // if
+			if(_mapped) return;
+#endif // WIN32
+			FILE *file = fopen(fileName.c_str(), "rb");
+			if(!file) return;
+			if(fseek(file, 0, SEEK_END) == 0)
+			{
+				const long size = ftell(file);
+				if(size > 0 && fseek(file, 0, SEEK_SET) == 0)
+				{
+					_buffer.resize(size);
+					if(fread(&_buffer.front(), 1, size, file) == (size_t)size)
+					{
+						_contents = &_buffer.front();
+						_size = size;
+					} // if
+				} // if
+			} // if
+			fclose(file);
+		} // BackgroundFileReader
+
+		~BackgroundFileReader()
+		{
+#ifndef WIN32
+			if(_mapped) munmap((void *)_contents, _size);
+#endif // WIN32
+		} // ~BackgroundFileReader
+
+		// checks the header and chunk table, false if this isn't a file we can read
+		bool parse(void)
+		{
+			if(!_contents || _size < sizeof(BackgroundFileHeader)) return(false);
+			BackgroundFileHeader header;
+			memcpy(&header, _contents, sizeof(header));
+			if(memcmp(header.magic, BACKGROUND_FILE_MAGIC, sizeof(header.magic)) != 0 || header.byteOrder != BACKGROUND_FILE_BYTE_ORDER
+				|| header.version == 0 || header.version > BACKGROUND_FILE_VERSION)
+			{
+				return(false);
+			} // if
+			if(header.numChunks > (_size - sizeof(header)) / sizeof(BackgroundFileChunk)) return(false);
+			_chunks.resize(header.numChunks);
+			if(header.numChunks) memcpy(&_chunks.front(), _contents + sizeof(header), header.numChunks * sizeof(BackgroundFileChunk));
+			for(std::vector<BackgroundFileChunk>::const_iterator chunkIt = _chunks.begin(); chunkIt != _chunks.end(); ++chunkIt)
+			{ // every chunk must lie inside the file
+				if(chunkIt->elementBytes == 0 || chunkIt->numElements > (_size / chunkIt->elementBytes) || chunkIt->offset > _size
+					|| chunkIt->elementBytes * chunkIt->numElements > _size - chunkIt->offset)
+				{
+					return(false);
+				} // if
+			} // for
+			return(true);
+		} // parse
+
+		// the chunk's data if it's there with exactly the expected element size and count. Otherwise NULL.
+		const void *find(const unsigned int &id, const unsigned int &elementBytes, const unsigned int &numElements) const
+		{
+			for(std::vector<BackgroundFileChunk>::const_iterator chunkIt = _chunks.begin(); chunkIt != _chunks.end(); ++chunkIt)
+			{
+				if(chunkIt->id == id)
+				{
+					const bool matches = (chunkIt->elementBytes == elementBytes && chunkIt->numElements == numElements);
+					return(matches ? _contents + chunkIt->offset : 0);
+				} // if
+			} // for
+			return(0);
+		} // find
+
+		// copies a chunk into plane, which ends up empty if the chunk is missing or doesn't have numElements of T
+		template <typename T>
+		bool read(const unsigned int &id, const unsigned int &numElements, std::vector<T> &plane) const
+		{
+			const T *data = (const T *)find(id, sizeof(T), numElements);
+			if(data) plane.assign(data, data + numElements);
+			else plane.clear();
+			return(data != 0);
+		} // read
+
+	private:
+		const char *_contents;
+		size_t _size;
+		bool _mapped;
+		std::vector<char> _buffer;
+		std::vector<BackgroundFileChunk> _chunks;
+}; // BackgroundFileReader
+
+
+static BackgroundFileImage describeImage(const livescene::Image &image)
+{
+	BackgroundFileImage description = {image.getWidth(), image.getHeight(), image.getDepth(), (unsigned int)image.getFormat(),
+		(unsigned int)image.getNull(), (unsigned int)image.getAccumulation()};
+	return(description);
+} // describeImage
+
+// rebuilds a saved image, false if the description or data is missing or they don't agree.
+// depth is the bytes per sample the image must have; the format is left for the caller to check.
+static bool readImage(const BackgroundFileReader &reader, const unsigned int &imageID, const unsigned int &dataID,
+	const unsigned int &depth, livescene::Image &image)
+{
+	const BackgroundFileImage *description = (const BackgroundFileImage *)reader.find(imageID, sizeof(BackgroundFileImage), 1);
+	if(!description || description->depth != depth)
+	{
+		return(false);
+	} // if
+	// in 64 bits, so a corrupt width or height can't wrap around to a size that happens to match the data
+	const unsigned long long imageBytes = (unsigned long long)description->width * description->height * description->depth;
+	if(imageBytes == 0 || imageBytes > (unsigned long long)INT_MAX)
+	{ // Image keeps its sizes in ints
+		return(false);
+	} // if
+	const void *data = reader.find(dataID, 1, (unsigned int)imageBytes);
+	if(!data)
+	{
+		return(false);
+	} // if
+	image = livescene::Image(description->width, description->height, description->depth, (livescene::VideoFormat)description->format);
+	image.preAllocate();
+	memcpy(image.getData(), data, (size_t)imageBytes);
+	image.setNull(description->nullValue);
+	image.setAccumulation((unsigned short)description->accumulation);
+	return(true);
+} // readImage
+
+
+bool Background::save(const std::string &fileName) const
+{
+	if(!_backgroundAvailable || !_bgZ.getData())
+	{
+		return(false);
+	} // if
+
+	BackgroundFileParameters parameters;
+	parameters.discriminationEpsilonPercent = _discriminationEpsilonPercent;
+	parameters.learningRate = _learningRate;
+	parameters.matchStdDevs = _matchStdDevs;
+	parameters.colorDeviations = _colorDeviations;
+	parameters.colorAmbiguityFactor = _colorAmbiguityFactor;
+	parameters.absorbFrames = _absorbFrames;
+	parameters.revealFrames = _revealFrames;
+	parameters.colorMinimumDelta = _colorMinimumDelta;
+	parameters.rgbModelWeight = _rgbModelWeight;
+	parameters.rgbAccumulations = _rgbAccumulations;
+	parameters.flags = (_liveModelValid ? BackgroundFileParameters::LIVE_MODEL_VALID : 0)
+		| (_zAccumulatorsValid ? BackgroundFileParameters::Z_ACCUMULATORS_VALID : 0)
+		| (_rgbAccumulatorsValid ? BackgroundFileParameters::RGB_ACCUMULATORS_VALID : 0);
+	const BackgroundFileImage imageZ = describeImage(_bgZ), imageRGB = describeImage(_bgRGB);
+
+	BackgroundFileWriter writer;
+	writer.add(CHUNK_PARAMETERS, &parameters, sizeof(parameters), 1);
+	writer.add(CHUNK_Z_IMAGE, &imageZ, sizeof(imageZ), 1);
+	writer.add(CHUNK_Z_DATA, _bgZ.getData(), 1, _bgZ.getImageBytes());
+	if(_bgRGB.getData())
+	{
+		writer.add(CHUNK_RGB_IMAGE, &imageRGB, sizeof(imageRGB), 1);
+		writer.add(CHUNK_RGB_DATA, _bgRGB.getData(), 1, _bgRGB.getImageBytes());
+	} // if
+	if(_liveModelValid)
+	{
+		writer.add(CHUNK_Z_MEAN, _zMean);
+		writer.add(CHUNK_Z_VARIANCE, _zVariance);
+		writer.add(CHUNK_Z_CANDIDATE, _zCandidate);
+		writer.add(CHUNK_Z_PERSISTENCE, _zPersistence);
+		writer.add(CHUNK_Z_MATCHED, _zMatched);
+	} // if
+	if(_zAccumulatorsValid)
+	{
+		writer.add(CHUNK_Z_SUMS, _zSums);
+		writer.add(CHUNK_Z_COUNTS, _zCounts);
+	} // if
+	writer.add(CHUNK_RGB_MEAN, _rgbMean);
+	writer.add(CHUNK_RGB_DEVIATION, _rgbDeviation);
+	if(_rgbAccumulatorsValid)
+	{
+		writer.add(CHUNK_RGB_SUMS, _rgbSums);
+		writer.add(CHUNK_RGB_SUM_SQUARES, _rgbSumSquares);
+	} // if
+	return(writer.write(fileName));
+} // Background::save
+
+
+bool Background::load(const std::string &fileName)
+{
+	BackgroundFileReader reader(fileName);
+	if(!reader.parse())
+	{
+		return(false);
+	} // if
+	livescene::Image bgZ, bgRGB;
+	const BackgroundFileParameters *parameters = (const BackgroundFileParameters *)reader.find(CHUNK_PARAMETERS, sizeof(BackgroundFileParameters), 1);
+	if(!parameters || !readImage(reader, CHUNK_Z_IMAGE, CHUNK_Z_DATA, 2, bgZ) || !livescene::isDepthFormat(bgZ.getFormat()))
+	{
+		return(false);
+	} // if
+	// RGB is optional, but if the file has it, it must be usable alongside Z
+	const bool haveRGB = (reader.find(CHUNK_RGB_IMAGE, sizeof(BackgroundFileImage), 1) != 0);
+	if(haveRGB && (!readImage(reader, CHUNK_RGB_IMAGE, CHUNK_RGB_DATA, 3, bgRGB) || bgRGB.getFormat() != livescene::VIDEO_RGB
+		|| bgRGB.getWidth() != bgZ.getWidth() || bgRGB.getHeight() != bgZ.getHeight()))
+	{
+		return(false);
+	} // if
+
+	// everything needed is there, from here on the current model is replaced.
+	// Only the model: the saved tuning parameters are left to the caller, who may have changed them since.
+	_bgZ = bgZ;
+	if(haveRGB)
+	{ // not through ?:, whose temporary copy wouldn't own its data
+		_bgRGB = bgRGB;
+	} // if
+	else
+	{
+		_bgRGB = livescene::Image();
+	} // else
+	_backgroundAvailable = true;
+	++_modelVersion; // see publishSnapshot()
+
+	const unsigned int numSamples = _bgZ.getSamples();
+	_liveModelValid = (parameters->flags & BackgroundFileParameters::LIVE_MODEL_VALID)
+		&& reader.read(CHUNK_Z_MEAN, numSamples, _zMean) && reader.read(CHUNK_Z_VARIANCE, numSamples, _zVariance)
+		&& reader.read(CHUNK_Z_CANDIDATE, numSamples, _zCandidate) && reader.read(CHUNK_Z_PERSISTENCE, numSamples, _zPersistence);
+	reader.read(CHUNK_Z_MATCHED, numSamples, _zMatched); // RGB learns everywhere if this is missing, as it would after a reseed
+	updateZThresholds(); // derived from the variance, so not saved
+	_zAccumulatorsValid = (parameters->flags & BackgroundFileParameters::Z_ACCUMULATORS_VALID)
+		&& reader.read(CHUNK_Z_SUMS, numSamples, _zSums) && reader.read(CHUNK_Z_COUNTS, numSamples, _zCounts);
+
+	if(haveRGB)
+	{
+		const unsigned int numChannels = _bgRGB.getImageBytes();
+		if(reader.read(CHUNK_RGB_MEAN, numChannels, _rgbMean) && reader.read(CHUNK_RGB_DEVIATION, numChannels, _rgbDeviation))
+		{
+			_rgbModelWeight = (unsigned short)parameters->rgbModelWeight;
+			_rgbAccumulations = (unsigned short)parameters->rgbAccumulations;
+			_rgbAccumulatorsValid = (parameters->flags & BackgroundFileParameters::RGB_ACCUMULATORS_VALID)
+				&& reader.read(CHUNK_RGB_SUMS, numChannels, _rgbSums) && reader.read(CHUNK_RGB_SUM_SQUARES, numChannels, _rgbSumSquares);
+			updateRGBThresholds();
+		} // if
+		else
+		{
+			initRGBModel();
+		} // else
+	} // if
+	else
+	{
+		_rgbMean.clear();
+		_rgbDeviation.clear();
+		_rgbThreshold.clear();
+		_rgbAccumulatorsValid = false;
+	} // else
+	_extraction = livescene::BackgroundExtraction();
+	_tileFlags.clear();
+	invalidateTiles();
+	return(true);
+} // Background::load
+
+
+
+// whether a snapshot's copy of a plane can be overwritten with the plane as it is now
+static bool sameLayout(const livescene::Image &copy, const livescene::Image &plane)
+{
+	return(copy.getWidth() == plane.getWidth() && copy.getHeight() == plane.getHeight() && copy.getDepth() == plane.getDepth()
+		&& copy.getFormat() == plane.getFormat() && (copy.getData() != 0) == (plane.getData() != 0));
+} // sameLayout
+
+// copies a plane into a snapshot, into the buffer already there if there is one
+static void copyPlane(const livescene::Image &plane, livescene::Image &copy)
+{
+	if(!plane.getData())
+	{
+		return; // and a fresh snapshot hasn't any either
+	} // if
+	if(copy.getData())
+	{
+		memcpy(copy.getData(), plane.getData(), plane.getImageBytes());
+	} // if
+	else
+	{
+		copy = livescene::Image(plane, true);
+	} // else
+	copy.setNull(plane.getNull());
+	copy.setTimestamp(plane.getTimestamp());
+	copy.setAccumulation((unsigned short)plane.getAccumulation());
+	copy.invalidateInternalStats();
+} // copyPlane
+
+BackgroundSnapshot::BackgroundSnapshot() : _colorAmbiguityFactor(0.0f), _version(0), _modelVersion(0), _retired(false), _references(new OpenThreads::Atomic(0))
+{
+} // BackgroundSnapshot::BackgroundSnapshot
+
+BackgroundSnapshot::~BackgroundSnapshot()
+{
+	delete _references;
+} // BackgroundSnapshot::~BackgroundSnapshot
+
+void BackgroundSnapshot::release(void) const
+{
+	--*_references;
+} // BackgroundSnapshot::release
+
+unsigned long Background::publishSnapshot(void)
+{
+	if(!_backgroundAvailable)
+	{
+		return(0);
+	} // if
+	if(!_liveModelValid)
+	{
+		initLiveModel(); // so the snapshot has thresholds to extract with
+	} // if
+	livescene::BackgroundSnapshot *current = (livescene::BackgroundSnapshot *)_currentSnapshot->get(), *snapshot(0);
+	if(current && current->_modelVersion == _modelVersion)
+	{
+		return(current->_version); // nothing to copy
+	} // if
+
+	// any snapshot that isn't current and that nobody holds is free. Readers can only get to the current one,
+	// and acquireSnapshot() gives up on one that stopped being current, so nothing can take hold of it meanwhile.
+	// A reader still inside acquireSnapshot() may have read an older one just before it was replaced, though,
+	// so retired snapshots are only deleted when no reader is.
+	const bool noneAcquiring = ((unsigned int)*_acquiring == 0);
+	std::vector<livescene::BackgroundSnapshot *>::iterator snapshotIt = _snapshots.begin();
+	while(snapshotIt != _snapshots.end())
+	{
+		if(*snapshotIt == current || (unsigned int)*(*snapshotIt)->_references != 0)
+		{
+			++snapshotIt;
+			continue;
+		} // if
+		if((*snapshotIt)->_version && (!sameLayout((*snapshotIt)->_bgZ, _bgZ) || !sameLayout((*snapshotIt)->_bgRGB, _bgRGB)))
+		{ // made for a background of another size or format
+			(*snapshotIt)->_retired = true;
+		} // if
+		if((*snapshotIt)->_retired)
+		{
+			if(noneAcquiring)
+			{
+				delete *snapshotIt;
+				snapshotIt = _snapshots.erase(snapshotIt);
+			} // if
+			else ++snapshotIt;
+			continue;
+		} // if
+		if(!snapshot) snapshot = *snapshotIt;
+		++snapshotIt;
+	} // while
+	if(!snapshot)
+	{ // everything else is still being read
+		snapshot = new livescene::BackgroundSnapshot;
+		_snapshots.push_back(snapshot);
+	} // if
+
+	copyPlane(_bgZ, snapshot->_bgZ);
+	copyPlane(_bgRGB, snapshot->_bgRGB);
+	snapshot->_zThreshold = _zThreshold;
+	snapshot->_rgbThreshold = _rgbThreshold;
+	snapshot->_colorAmbiguityFactor = _colorAmbiguityFactor;
+	snapshot->_version = ++_snapshotVersion;
+	snapshot->_modelVersion = _modelVersion;
+	_currentSnapshot->assign(snapshot, current); // only this thread publishes, so it can't have changed
+	return(snapshot->_version);
+} // Background::publishSnapshot
+
+const livescene::BackgroundSnapshot *Background::acquireSnapshot(void) const
+{
+	++*_acquiring; // until this holds a reference, or has let go of the one it tried, publishSnapshot() deletes nothing
+	for(;;)
+	{
+		livescene::BackgroundSnapshot *snapshot = (livescene::BackgroundSnapshot *)_currentSnapshot->get();
+		if(!snapshot)
+		{
+			--*_acquiring;
+			return(0);
+		} // if
+		++*snapshot->_references;
+		// still current with the reference in place, so it can't be reused until released
+		if(_currentSnapshot->get() == snapshot)
+		{
+			--*_acquiring;
+			return(snapshot);
+		} // if
+		--*snapshot->_references; // a newer one was published meanwhile, take that instead
+	} // for
+} // Background::acquireSnapshot
+
 
 
 
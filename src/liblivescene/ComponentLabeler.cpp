@@ -0,0 +1,240 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#include "liblivescene/ComponentLabeler.h"
+#include <algorithm> // std::min/max/fill
+
+namespace livescene {
+
+// sum of squares of 0...n-1, used to total X*X over a run without visiting its samples
+static inline double sumOfSquaresBelow(const double n)
+{
+	return(n * (n - 1.0) * (2.0 * n - 1.0) / 6.0);
+} // sumOfSquaresBelow
+
+
+unsigned int ComponentLabeler::findRoot(unsigned int provisional)
+{
+	// path halving: every other node on the way up is pointed at its grandparent
+	while(_parents[provisional] != provisional)
+	{
+		_parents[provisional] = _parents[_parents[provisional]];
+		provisional = _parents[provisional];
+	} // while
+	return(provisional);
+} // ComponentLabeler::findRoot
+
+
+void ComponentLabeler::unite(const unsigned int &provisionalA, const unsigned int &provisionalB)
+{
+	const unsigned int rootA = findRoot(provisionalA), rootB = findRoot(provisionalB);
+	// the lower provisional label always wins, so the root of a component is its earliest run
+	if(rootA < rootB)
+	{
+		_parents[rootB] = rootA;
+	} // if
+	else if(rootB < rootA)
+	{
+		_parents[rootA] = rootB;
+	} // else if
+} // ComponentLabeler::unite
+
+
+bool ComponentLabeler::runsConnect(const livescene::ImageView &foreZ, const Run &above, const Run &below) const
+{
+	const unsigned short *aboveRow = foreZ.getRow(above.line), *belowRow = foreZ.getRow(below.line);
+	// only the columns of below that touch above, diagonals included
+	const unsigned int firstColumn = std::max(below.start, above.start > 0 ? above.start - 1 : 0);
+	const unsigned int endColumn = std::min(below.end, above.end + 1);
+	for(unsigned int column = firstColumn; column < endColumn; ++column)
+	{
+		const int belowZ = belowRow[column];
+		const unsigned int aboveFirst = std::max(above.start, column > 0 ? column - 1 : 0);
+		const unsigned int aboveEnd = std::min(above.end, column + 2);
+		for(unsigned int aboveColumn = aboveFirst; aboveColumn < aboveEnd; ++aboveColumn)
+		{
+			const int deltaZ = belowZ - (int)aboveRow[aboveColumn];
+			if(deltaZ <= _depthContinuity && -deltaZ <= _depthContinuity)
+			{
+				return(true);
+			} // if
+		} // for
+	} // for
+	return(false);
+} // ComponentLabeler::runsConnect
+
+
+unsigned int ComponentLabeler::label(const livescene::ImageView &foreZ)
+{
+	// clear what the previous view wrote, the new view is rewritten entirely below
+	for(unsigned int line = 0; line < _viewHeight; ++line)
+	{
+		unsigned int *labelRow = &_labels[(_originY + line) * _labelsWidth + _originX];
+		std::fill(labelRow, labelRow + _viewWidth, 0);
+	} // for
+	_components.clear();
+	_viewWidth = _viewHeight = 0;
+
+	if(!foreZ.isZ() || foreZ.isEmpty())
+	{
+		return(0);
+	} // if
+
+	if(_labelsWidth != foreZ.getParentWidth() || _labelsHeight != foreZ.getParentHeight())
+	{
+		_labelsWidth = foreZ.getParentWidth();
+		_labelsHeight = foreZ.getParentHeight();
+		_labels.assign(_labelsWidth * _labelsHeight, 0);
+	} // if
+	_originX = foreZ.getOriginX();
+	_originY = foreZ.getOriginY();
+	_viewWidth = foreZ.getWidth();
+	_viewHeight = foreZ.getHeight();
+
+	_runs.clear();
+	_parents.clear();
+	const int depthContinuity(_depthContinuity);
+	const unsigned short nullValue = (unsigned short)foreZ.getNull();
+
+	// pass 1: extract runs row by row and merge them with touching runs on the previous row
+	unsigned int previousRowBegin(0), previousRowEnd(0);
+	for(unsigned int line = 0; line < _viewHeight; ++line)
+	{
+		const unsigned short *depthRow = foreZ.getRow(line);
+		const unsigned int rowBegin = _runs.size();
+		unsigned int previousSub = previousRowBegin; // first run above that could still touch
+		for(unsigned int column = 0; column < _viewWidth; )
+		{
+			if(depthRow[column] == nullValue)
+			{
+				++column;
+				continue;
+			} // if
+
+			Run run;
+			run.line = line;
+			run.start = column;
+			run.provisional = _parents.size();
+			run.sumZ = run.minZ = run.maxZ = depthRow[column];
+			run.sumZZ = (double)depthRow[column] * depthRow[column];
+			// extend while the next sample is valid and continuous with this one
+			for(++column; column < _viewWidth; ++column)
+			{
+				const int currentZ = depthRow[column];
+				const int deltaZ = currentZ - (int)depthRow[column - 1];
+				if(currentZ == nullValue || deltaZ > depthContinuity || -deltaZ > depthContinuity)
+				{
+					break;
+				} // if
+				run.sumZ += currentZ;
+				run.sumZZ += (double)currentZ * currentZ;
+				run.minZ = std::min(run.minZ, (unsigned int)currentZ);
+				run.maxZ = std::max(run.maxZ, (unsigned int)currentZ);
+			} // for
+			run.end = column;
+			_parents.push_back(run.provisional);
+
+			// runs above are in column order, so skip the ones that end too far left to touch, diagonally or not
+			while(previousSub < previousRowEnd && _runs[previousSub].end < run.start)
+			{
+				++previousSub;
+			} // while
+			for(unsigned int aboveSub = previousSub; aboveSub < previousRowEnd && _runs[aboveSub].start <= run.end; ++aboveSub)
+			{
+				if(runsConnect(foreZ, _runs[aboveSub], run))
+				{
+					unite(_runs[aboveSub].provisional, run.provisional);
+				} // if
+			} // for
+			_runs.push_back(run);
+		} // for column
+		previousRowBegin = rowBegin;
+		previousRowEnd = _runs.size();
+	} // for lines
+
+	// pass 2: resolve roots and total statistics per component, visiting runs only
+	_allComponents.clear();
+	_rootComponents.assign(_parents.size(), 0); // component index + 1, 0 for not seen yet
+	for(std::vector<Run>::iterator runIt = _runs.begin(); runIt != _runs.end(); ++runIt)
+	{
+		const unsigned int root = findRoot(runIt->provisional);
+		if(_rootComponents[root] == 0)
+		{
+			ComponentStats newComponent;
+			newComponent.minX = runIt->start + _originX;
+			newComponent.minY = runIt->line + _originY;
+			newComponent.maxX = newComponent.minX;
+			newComponent.maxY = newComponent.minY;
+			newComponent.minZ = runIt->minZ;
+			newComponent.maxZ = runIt->maxZ;
+			_allComponents.push_back(newComponent);
+			_rootComponents[root] = _allComponents.size();
+		} // if
+		runIt->provisional = _rootComponents[root] - 1; // from here on, the component index
+
+		ComponentStats &component = _allComponents[runIt->provisional];
+		const unsigned int runLength = runIt->end - runIt->start;
+		const double parentStart = runIt->start + _originX, parentEnd = runIt->end + _originX, parentLine = runIt->line + _originY;
+		component.count += runLength;
+		component.sumX += (parentStart + parentEnd - 1.0) * runLength * 0.5;
+		component.sumXX += sumOfSquaresBelow(parentEnd) - sumOfSquaresBelow(parentStart);
+		component.sumY += parentLine * runLength;
+		component.sumYY += parentLine * parentLine * runLength;
+		component.sumZ += runIt->sumZ;
+		component.sumZZ += runIt->sumZZ;
+		component.minX = std::min(component.minX, (unsigned int)parentStart);
+		component.maxX = std::max(component.maxX, (unsigned int)parentEnd - 1);
+		component.maxY = std::max(component.maxY, (unsigned int)parentLine); // runs are in raster order, minY is already right
+		component.minZ = std::min(component.minZ, (unsigned short)runIt->minZ);
+		component.maxZ = std::max(component.maxZ, (unsigned short)runIt->maxZ);
+	} // for
+
+	// reject small components, and number the rest 1...N
+	_keptLabels.assign(_allComponents.size(), 0);
+	for(unsigned int componentSub = 0; componentSub < _allComponents.size(); ++componentSub)
+	{
+		if(_allComponents[componentSub].count >= _minComponentSamples)
+		{
+			_allComponents[componentSub].label = _components.size() + 1;
+			_keptLabels[componentSub] = _allComponents[componentSub].label;
+			_components.push_back(_allComponents[componentSub]);
+		} // if
+	} // for
+
+	// pass 3: write the label plane, and NULL out rejected samples if asked
+	for(std::vector<Run>::const_iterator runIt = _runs.begin(); runIt != _runs.end(); ++runIt)
+	{
+		const unsigned int runLabel = _keptLabels[runIt->provisional];
+		if(runLabel)
+		{
+			unsigned int *labelRow = &_labels[(_originY + runIt->line) * _labelsWidth + _originX];
+			std::fill(labelRow + runIt->start, labelRow + runIt->end, runLabel);
+		} // if
+		else if(_nullRejected)
+		{
+			unsigned short *depthRow = foreZ.getRow(runIt->line);
+			std::fill(depthRow + runIt->start, depthRow + runIt->end, nullValue);
+		} // else if
+	} // for
+
+	return(_components.size());
+} // ComponentLabeler::label
+
+
+int ComponentLabeler::getLargestComponent(void) const
+{
+	int largest(-1);
+	unsigned long largestCount(0);
+	for(unsigned int componentSub = 0; componentSub < _components.size(); ++componentSub)
+	{
+		if(_components[componentSub].count > largestCount)
+		{
+			largestCount = _components[componentSub].count;
+			largest = componentSub;
+		} // if
+	} // for
+	return(largest);
+} // ComponentLabeler::getLargestComponent
+
+
+// namespace livescene
+}
@@ -0,0 +1,100 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#include "liblivescene/DepthConversion.h"
+#include <algorithm> // std::min/max
+
+namespace livescene {
+
+// raw disparity to meters is 1 / (raw * a + b)
+static const double RawToMetersA(-0.0030711016);
+static const double RawToMetersB(3.3309495161);
+
+
+DepthConversion::DepthConversion(const unsigned int width, const unsigned int height,
+	const float fx, const float fy, const float cx, const float cy)
+{
+	buildRawTable();
+	setIntrinsics(width, height, fx, fy, cx, cy);
+} // DepthConversion::DepthConversion
+
+
+void DepthConversion::buildRawTable(void)
+{
+	for(unsigned int raw = 0; raw < 2048; ++raw)
+	{
+		const double denominator = raw * RawToMetersA + RawToMetersB;
+		// zero is a dropout (see Image::rewriteZeroToNull), 2047 is the sensor's NULL, and
+		// the curve goes asymptotic (and then negative) near the top of the raw range anyway
+		if(raw == 0 || raw == 2047 || denominator <= 0.0)
+		{
+			_rawToMillimeters[raw] = getMillimetersNull();
+			continue;
+		} // if
+		const double millimeters = 1000.0 / denominator;
+		_rawToMillimeters[raw] = (millimeters > getMaxRangeMillimeters()) ? getMillimetersNull() : (unsigned short)(millimeters + 0.5);
+	} // for
+} // DepthConversion::buildRawTable
+
+
+void DepthConversion::setIntrinsics(const unsigned int width, const unsigned int height, const float fx, const float fy, const float cx, const float cy)
+{
+	_rayX.resize(width);
+	_rayY.resize(height);
+	// fold the millimeters to meters scale into the rays so placing a sample is one multiply per axis
+	const float scaleX(0.001f / fx), scaleY(0.001f / fy);
+	for(unsigned int column = 0; column < width; ++column)
+	{
+		_rayX[column] = (column - cx) * scaleX;
+	} // for
+	for(unsigned int line = 0; line < height; ++line)
+	{
+		_rayY[line] = -(line - cy) * scaleY; // raster Y is down, eye Y is up
+	} // for
+} // DepthConversion::setIntrinsics
+
+
+unsigned short DepthConversion::millimetersToRaw(const unsigned short &millimeters, const VideoFormat &format) const
+{
+	if(millimeters == getMillimetersNull())
+	{
+		return(0);
+	} // if
+	const double raw11 = (1000.0 / millimeters - RawToMetersB) / RawToMetersA;
+	// clamp into the placeable range, below the NULL value
+	const double clamped = std::max(0.0, std::min(raw11 + 0.5, 2046.0));
+	if(format == DEPTH_10BIT)
+	{
+		return((unsigned short)std::min(clamped * 0.5, 1022.0));
+	} // if
+	return((unsigned short)clamped);
+} // DepthConversion::millimetersToRaw
+
+
+bool DepthConversion::convertToMillimeters(const livescene::Image &rawZ, livescene::Image &millimetersZ) const
+{
+	const VideoFormat rawFormat = rawZ.getFormat();
+	if(!(rawFormat == DEPTH_10BIT || rawFormat == DEPTH_11BIT) || !rawZ.getData() || !millimetersZ.getData()
+		|| millimetersZ.getFormat() != DEPTH_MM_16 || rawZ.getWidth() != millimetersZ.getWidth() || rawZ.getHeight() != millimetersZ.getHeight())
+	{
+		return(false);
+	} // if
+
+	const unsigned short *rawData = (const unsigned short *)rawZ.getData();
+	unsigned short *millimetersData = (unsigned short *)millimetersZ.getData();
+	const unsigned int rawShift = (rawFormat == DEPTH_10BIT) ? 1 : 0; // 10-bit is looked up at twice its value
+	const unsigned int numSamples = rawZ.getSamples();
+	for(unsigned int sampleSub = 0; sampleSub < numSamples; ++sampleSub)
+	{
+		// mask keeps corrupt samples inside the table, they'd be NULL either way
+		millimetersData[sampleSub] = _rawToMillimeters[(rawData[sampleSub] << rawShift) & 2047];
+	} // for
+
+	millimetersZ.setNull(getMillimetersNull());
+	millimetersZ.setTimestamp(rawZ.getTimestamp());
+	millimetersZ.invalidateInternalStats();
+	return(true);
+} // DepthConversion::convertToMillimeters
+
+
+// namespace livescene
+}
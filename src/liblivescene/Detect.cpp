@@ -1,238 +1,364 @@
 // Copyright 2011 Skew Matrix Software and AlphaPixel
 
 #include "liblivescene/Detect.h"
+#include "liblivescene/Parallel.h"
 #include <algorithm> // std::min/max
-#include <limits> // numeric_limits::max
 #include <cassert>
 #include <iostream>
 
 namespace livescene {
 
+const float BodyMass::_none[3] = {0.0f, 0.0f, 0.0f};
+
 const float *BodyMass::getHandCentroid(unsigned int bodyNum, unsigned int handNum) const
-{ // ignore bodyNum
+{
+	if(bodyNum >= _bodies.size())
+	{
+		return(_none);
+	} // if
 	if(handNum == 1)
 	{
-		return(_handCentroid[1]);
+		return(_bodies[bodyNum].handCentroid[1]);
 	} // if
 	else // all other hand values give you hand 0, you octopods.
 	{
-		return(_handCentroid[0]);
+		return(_bodies[bodyNum].handCentroid[0]);
 	} // else
 } // BodyMass::getHandCentroid
 
-unsigned int BodyMass::detect(livescene::Image &foreZ)
+
+// orders bodies largest first
+static bool largerComponent(const livescene::ComponentStats &left, const livescene::ComponentStats &right)
 {
-unsigned int BodiesDetected(0);
-livescene::ImageStatistics statsBodyX, statsBodyY, statsBodyZ;
-
-// calculate foreground stats
-foreZ.calcInternalStatsXYZ();
-
-// recalculate stats of body, using bounds of nth standard deviation of foreground to exclude extraneous noise
-const float nthStdDev(2.8f);
-const float
-	xmin(foreZ.getInternalStatsX().getMean() - foreZ.getInternalStatsX().getStdDev() * nthStdDev),
-	ymin(foreZ.getInternalStatsY().getMean() - foreZ.getInternalStatsY().getStdDev() * nthStdDev), 
-	zmin(foreZ.getInternalStatsZ().getMean() - foreZ.getInternalStatsZ().getStdDev() * nthStdDev), 
-	xmax(foreZ.getInternalStatsX().getMean() + foreZ.getInternalStatsX().getStdDev() * nthStdDev), 
-	ymax(foreZ.getInternalStatsY().getMean() + foreZ.getInternalStatsY().getStdDev() * nthStdDev), 
-	zmax(foreZ.getInternalStatsZ().getMean() + foreZ.getInternalStatsZ().getStdDev() * nthStdDev);
-const signed int // std::min and max get angry if the type of the two args is not identical
-	xminIntSigned(xmin),
-	yminIntSigned(ymin),
-	xmaxIntSigned(xmax),
-	ymaxIntSigned(ymax);
-const signed int
-	xminIntClamped(std::max(xminIntSigned, 0)),
-	yminIntClamped(std::max(yminIntSigned, 0)),
-	xmaxIntClamped(std::min(xmaxIntSigned, (signed)foreZ.getWidth() - 1)),
-	ymaxIntClamped(std::min(ymaxIntSigned, (signed)foreZ.getHeight() - 1));
-ZApproveCallback stdDevZApprove(zmin, zmax);
-
-// troubleshooting asserts, remove later
-assert(xminIntClamped >= 0);
-assert(yminIntClamped >= 0);
-assert(xmaxIntClamped >= 0);
-assert(ymaxIntClamped >= 0);
-assert(xminIntClamped < (signed)foreZ.getWidth());
-assert(yminIntClamped < (signed)foreZ.getHeight());
-assert(xmaxIntClamped < (signed)foreZ.getWidth());
-assert(ymaxIntClamped < (signed)foreZ.getHeight());
-
-// find the actual body mass using filtered input
-// this is faster by passing the XY bounding box as a limiter
-foreZ.calcStatsXYZBounded(xminIntClamped, yminIntClamped, xmaxIntClamped, ymaxIntClamped,
-	&statsBodyX, &statsBodyY, &statsBodyZ, &stdDevZApprove);
-
-if(statsBodyZ.getNumSamples() >= OSG_LIVESCENEVIEW_DETECT_BODY_SAMPLES)
+	return(left.count > right.count);
+} // largerComponent
+
+// turns sums of coarse coordinates into sums of the image coordinates at the centers of the blocks they stand for
+static void scaleCoordinateSums(double &sum, double &sumSquares, const unsigned long &count, const unsigned int &scale)
 {
-	_centroid[0] = statsBodyX.getMean();
-	_centroid[1] = statsBodyY.getMean();
-	_centroid[2] = statsBodyZ.getMean();
-	_stdDev[0] = statsBodyX.getStdDev();
-	_stdDev[1] = statsBodyY.getStdDev();
-	_stdDev[2] = statsBodyZ.getStdDev();
-	_bodyPresent = true;
-	BodiesDetected = 1;
-} // if
-else
+	const double offset(0.5 * (scale - 1.0));
+	sumSquares = scale * scale * sumSquares + 2.0 * scale * offset * sum + offset * offset * count;
+	sum = scale * sum + offset * count;
+} // scaleCoordinateSums
+
+
+unsigned int BodyMass::detect(const livescene::ImageView &foreZ)
 {
 	clear();
-} // else
+	_labelLevel = 0;
+	_labelMinX = foreZ.getOriginX(); _labelEndX = foreZ.getOriginX() + foreZ.getWidth();
+	_labelMinY = foreZ.getOriginY(); _labelEndY = foreZ.getOriginY() + foreZ.getHeight();
+	_detectFinished = true;
+
+	// one labelling pass finds every body. Components too small to be a body are rejected by the labeller.
+	_labeler.label(foreZ);
+	setBodies(_labeler.getComponents(), 0, foreZ.getParentWidth(), foreZ.getParentHeight());
 
-return(BodiesDetected);
+	return(_bodies.size());
 } // BodyMass::detect
 
 
-unsigned int BodyMass::detectHands(const livescene::Image &foreZ)
-{ // this currently only understands one body and its two hands
-unsigned int HandsDetected(0);
-// for the following constants:
-// M is the horizontal distance from the center of the body to the outside of one side
-// regardless of whether the hands are extended to the sides or not.
-// aka half of the body mass width
-// N is the vertical distance from the waist to the top of the head (or bottom of feet)
-// aka half of the body mass height
-// These outlying search ratios are used to determine how far around/above the nominal body
-// mass should be searched for extended hands.
-const float outlyingSearchRatioM(2.2f * 2.0f), // 2.2 times M distance to either side of body centroid
-			outlyingSearchRatioN(1.5f * 2.0f), // 1.5 times N above centroid is an additional half of N distance above top of head
-			outlyingSearchRatioO(0.5f * 2.0f); // .5 times N below centroid allows hands to extend just below the belt
-
-if(!getBodyPresent()) return(0); // need to know where the body is to start detecting hands
-
-// determine body-plausible region bounds
-const signed int
-	bodySearchMinX(getBodyCentroid(0)[0] - (getBodyHalfExtent(0)[0] * outlyingSearchRatioM)),
-	bodySearchMaxX(getBodyCentroid(0)[0] + (getBodyHalfExtent(0)[0] * outlyingSearchRatioM)),
-	bodySearchMinY(getBodyCentroid(0)[1] - (getBodyHalfExtent(0)[1] * outlyingSearchRatioN)),
-	bodySearchMaxY(getBodyCentroid(0)[1] + (getBodyHalfExtent(0)[1] * outlyingSearchRatioO)),
-	bodyThresholdZ(getBodyCentroid(0)[2] - (getBodyHalfExtent(0)[2] * 2.5)); // anything nearer than body front Z margin qualifies
-
-// clamp to image edge bounds
-const signed int
-	bodySearchMinXClamped(std::max(bodySearchMinX, 0)),
-	bodySearchMaxXClamped(std::min(bodySearchMaxX, (signed)foreZ.getWidth())),
-	bodySearchMinYClamped(std::max(bodySearchMinY, 0)),
-	bodySearchMaxYClamped(std::min(bodySearchMaxY, (signed)foreZ.getHeight())),
-	bodyThresholdZClamped(std::max(bodyThresholdZ, 0));
-
-// make an expendable copy of the foreground buffer
-livescene::Image foreZtoDeplete(foreZ);
-
-for(unsigned int handSearch = 0; handSearch < 2; handSearch++)
+unsigned int BodyMass::detect(const livescene::Image &foreZ, const livescene::ImageView &window, const livescene::Deadline &deadline)
 {
-	unsigned int resultX(0), resultY(0), resultZ(0);
-	// search body region for nearest remaining Z point closer than body front
-	if(findMinimumZLocation(foreZtoDeplete, bodySearchMinXClamped, bodySearchMinYClamped,
-		bodySearchMaxXClamped, bodySearchMaxYClamped, bodyThresholdZClamped, resultX, resultY, resultZ))
+	const unsigned int level(OSG_LIVESCENEVIEW_DETECT_COARSE_LEVEL);
+	if(!deadline.isLimited() || window.isEmpty())
 	{
-		// ensure there's at least a little bit of range between resultZ and bodyThresholdZClamped
-		// avoids divide-by-zero and poor weighting later
-		if((signed)resultZ < bodyThresholdZClamped - 2)
-		{
-			static int count;
-			if(sampleAndDepleteAdjacentThresholded(foreZtoDeplete, bodyThresholdZClamped,
-				resultX, resultY, resultZ,
-				_handCentroid[handSearch][0], _handCentroid[handSearch][1], _handCentroid[handSearch][2]))
-			{
-				++HandsDetected;
-			} // if
-		} // if
+		return(detect(window));
+	} // if
+	// no need to look coarse first if the whole window comfortably fits at the last full resolution rate
+	if(_fullLabelRate > 0.0 && 2.0 * _fullLabelRate * window.getSamples() < deadline.getRemaining())
+	{
+		return(detectMeasured(window, deadline));
+	} // if
+	// just the window's part of the pyramid, built afresh as foreZ is usually rewritten in place from frame to frame
+	if(!_pyramid.build(foreZ, window) || _pyramid.getNumLevelsBuilt() <= level)
+	{
+		return(detectMeasured(window, deadline));
 	} // if
-} // for
+	clear();
 
-return(HandsDetected);
-} // BodyMass::detectHands
+	// coarse pass over the window's part of the reduced frame, with the full resolution labeller's settings scaled to suit
+	const double coarseStart(deadline.getElapsed());
+	const livescene::ImageView coarseWindow(livescene::ImageView::fromBounds(_pyramid.getLevel(level),
+		window.getOriginX() >> level, window.getOriginY() >> level,
+		((window.getOriginX() + window.getWidth() - 1) >> level) + 1, ((window.getOriginY() + window.getHeight() - 1) >> level) + 1));
+	_coarseLabeler.setDepthContinuity(_labeler.getDepthContinuity() << level);
+	_coarseLabeler.setMinComponentSamples(_labeler.getMinComponentSamples() >> (2 * level));
+	_coarseLabeler.label(coarseWindow);
+	const double coarseTime(deadline.getElapsed() - coarseStart);
+	_labelLevel = level;
+	_labelMinX = coarseWindow.getOriginX() << level;
+	_labelEndX = std::min((coarseWindow.getOriginX() + coarseWindow.getWidth()) << level, foreZ.getWidth());
+	_labelMinY = coarseWindow.getOriginY() << level;
+	_labelEndY = std::min((coarseWindow.getOriginY() + coarseWindow.getHeight()) << level, foreZ.getHeight());
+	setBodies(_coarseLabeler.getComponents(), level, foreZ.getWidth(), foreZ.getHeight());
+	if(_bodies.empty())
+	{
+		_detectFinished = true; // every body would have shown up at the coarse level too
+		return(0);
+	} // if
+	_detectFinished = false;
+
+	// refine around the coarse bodies, if labelling that many samples at the coarse pass's rate will fit in the time left
+	const unsigned int margin(1 << level);
+	unsigned int refineMinX(foreZ.getWidth()), refineMinY(foreZ.getHeight()), refineMaxX(0), refineMaxY(0);
+	for(std::vector<Body>::const_iterator bodyIt = _bodies.begin(); bodyIt != _bodies.end(); ++bodyIt)
+	{
+		refineMinX = std::min(refineMinX, bodyIt->component.minX);
+		refineMinY = std::min(refineMinY, bodyIt->component.minY);
+		refineMaxX = std::max(refineMaxX, bodyIt->component.maxX);
+		refineMaxY = std::max(refineMaxY, bodyIt->component.maxY);
+	} // for
+	refineMinX = std::max(refineMinX, window.getOriginX() + margin) - margin;
+	refineMinY = std::max(refineMinY, window.getOriginY() + margin) - margin;
+	refineMaxX = std::min(refineMaxX + margin + 1, window.getOriginX() + window.getWidth());
+	refineMaxY = std::min(refineMaxY + margin + 1, window.getOriginY() + window.getHeight());
+	const double refineEstimate(coarseTime * (refineMaxX - refineMinX) * (refineMaxY - refineMinY) / std::max(coarseWindow.getSamples(), 1));
+	if(refineEstimate > deadline.getRemaining())
+	{
+		return(_bodies.size());
+	} // if
+	const unsigned int labelMinX(_labelMinX), labelMinY(_labelMinY), labelEndX(_labelEndX), labelEndY(_labelEndY);
+	detectMeasured(livescene::ImageView::fromBounds(foreZ, refineMinX, refineMinY, refineMaxX, refineMaxY), deadline);
+	// the coarse pass found no body in the rest of its window, so labels are still known over all of it
+	_labelMinX = labelMinX; _labelMinY = labelMinY; _labelEndX = labelEndX; _labelEndY = labelEndY;
+	return(_bodies.size());
+} // BodyMass::detect
+
+unsigned int BodyMass::detectMeasured(const livescene::ImageView &foreZ, const livescene::Deadline &deadline)
+{
+	const double start(deadline.getElapsed());
+	detect(foreZ);
+	_fullLabelRate = (deadline.getElapsed() - start) / std::max(foreZ.getSamples(), 1);
+	return(_bodies.size());
+} // BodyMass::detectMeasured
 
 
-bool BodyMass::findMinimumZLocation(const livescene::Image &foreZ,
-									const unsigned int &Xlow, const unsigned int &Ylow, const unsigned int &Xhigh, const unsigned int &Yhigh,
-									const short &zThreshold, unsigned int &minZlocX, unsigned int &minZlocY, unsigned int &minZvalueZ)
+void BodyMass::setBodies(const std::vector<livescene::ComponentStats> &components, const unsigned int &level,
+	const unsigned int &parentWidth, const unsigned int &parentHeight)
 {
-	bool thresholdFound(false);
-	short minDistance(std::numeric_limits<short>::max());
-	unsigned int width(foreZ.getWidth()), height(foreZ.getHeight());
-	short *depthBuffer = (short *)foreZ.getData();
+	std::vector<livescene::ComponentStats> sorted(components);
+	std::stable_sort(sorted.begin(), sorted.end(), largerComponent);
 
-	unsigned int lineSub(0);
-	for(unsigned int line = Ylow; line < Yhigh; ++line)
+	const unsigned int scale(1 << level);
+	_bodies.resize(sorted.size());
+	for(unsigned int bodyNum = 0; bodyNum < sorted.size(); ++bodyNum)
 	{
-		lineSub = line * width;
-		for(unsigned int column = Xlow; column < Xhigh; ++column)
+		Body &body = _bodies[bodyNum];
+		livescene::ComponentStats &component = sorted[bodyNum];
+		if(level)
 		{
-			short originalDepth = depthBuffer[lineSub + column];
-			// the order of these tests is immaterial, but they've been arranged in the order
-			// of most likely to fail first to speed things up
-			if(originalDepth <= zThreshold && originalDepth < minDistance && foreZ.isCellValueValid(originalDepth)) // is it valid, nearer than the threshold AND nearer than previous result?
-			{
-				// record it as the best location seen so far
-				minDistance = originalDepth;
-				thresholdFound = true;
-				minZlocX = column;
-				minZlocY = line;
-			} // if
+			// each coarse sample stands for a scale x scale block of the image
+			scaleCoordinateSums(component.sumX, component.sumXX, component.count, scale);
+			scaleCoordinateSums(component.sumY, component.sumYY, component.count, scale);
+			const unsigned int blockSamples(scale * scale);
+			component.count *= blockSamples;
+			component.sumX *= blockSamples; component.sumXX *= blockSamples;
+			component.sumY *= blockSamples; component.sumYY *= blockSamples;
+			component.sumZ *= blockSamples; component.sumZZ *= blockSamples;
+			component.minX *= scale;
+			component.minY *= scale;
+			component.maxX = std::min(component.maxX * scale + scale - 1, parentWidth - 1);
+			component.maxY = std::min(component.maxY * scale + scale - 1, parentHeight - 1);
+		} // if
+		body.component = component;
+		body.centroid[0] = component.getCentroidX();
+		body.centroid[1] = component.getCentroidY();
+		body.centroid[2] = component.getCentroidZ();
+		body.halfExtent[0] = component.getStdDevX();
+		body.halfExtent[1] = component.getStdDevY();
+		body.halfExtent[2] = component.getStdDevZ();
+		for(unsigned int handNum = 0; handNum < 2; ++handNum)
+		{
+			body.handCentroid[handNum][0] = body.handCentroid[handNum][1] = body.handCentroid[handNum][2] = 0.0f;
 		} // for
-	} // for lines
-
-	if(thresholdFound)
-	{
-		minZvalueZ = minDistance;
-	} // if
+		body.numHands = 0;
+		body.handsSearched = false;
+	} // for
+} // BodyMass::setBodies
 
-	return(thresholdFound);
-} // BodyMass::findMinimumZLocation
 
-bool BodyMass::sampleAndDepleteAdjacentThresholded(livescene::Image &foreZtoDeplete, const signed int &thresholdZ, 
-									const unsigned int &X, const unsigned int &Y, const short &Z,
-									float &weightedX, float &weightedY, float &weightedZ)
+/** \brief Runs detectBodyHands() on a band of bodies. */
+class HandSearch : public livescene::BandCallback
 {
+	public:
+		HandSearch(BodyMass &bodyMass, const livescene::Image &foreZ, const livescene::Deadline &deadline)
+			: _bodyMass(bodyMass), _foreZ(foreZ), _deadline(deadline) {}
+		virtual void operator ()(const unsigned int &begin, const unsigned int &end)
+		{
+			for(unsigned int bodyNum = begin; bodyNum < end; ++bodyNum)
+			{
+				_bodyMass.detectBodyHands(bodyNum, _foreZ, _deadline);
+			} // for
+		} // operator ()
+	private:
+		BodyMass &_bodyMass;
+		const livescene::Image &_foreZ;
+		const livescene::Deadline &_deadline;
+}; // HandSearch
+
+unsigned int BodyMass::detectHands(const livescene::Image &foreZ, const livescene::Deadline &deadline)
+{
+	_handsFinished = true;
+	if(!getBodyPresent()) return(0); // need to know where the bodies are to start detecting hands
 
-	bool result(false);
-	CoordStack searchStack;
-	float runningX(0.0f), runningY(0.0f), runningZ(0.0f), runningWeight(0.0f);
-	short minDistance(std::numeric_limits<short>::max());
-	unsigned int width(foreZtoDeplete.getWidth()), height(foreZtoDeplete.getHeight());
-	short *depthBuffer = (short *)foreZtoDeplete.getData();
+	// every body has its own visited mask and seed stack, so the searches are independent
+	if(_searchScratch.size() < _bodies.size())
+	{
+		_searchScratch.resize(_bodies.size());
+	} // if
+	HandSearch handSearch(*this, foreZ, deadline);
+	runBandsParallel(handSearch, _bodies.size(), 0, 1);
 
-	// seed the sampling/depletion recursive search
-	addToCoordStack(searchStack, X, Y, Z);
-	// obliterate this cell so it won't be re-processed or re-added to the stack in the future
-	depthBuffer[Y * foreZtoDeplete.getWidth() + X] = foreZtoDeplete.getNull();
+	unsigned int HandsDetected(0);
+	for(std::vector<Body>::const_iterator bodyIt = _bodies.begin(); bodyIt != _bodies.end(); ++bodyIt)
+	{
+		HandsDetected += bodyIt->numHands;
+		_handsFinished = _handsFinished && bodyIt->handsSearched;
+	} // for
+	return(HandsDetected);
+} // BodyMass::detectHands
 
 
-	while(!searchStack.empty())
+/** \brief Rejects hand seeds already taken by a hand, belonging to another body, or outside what detect() labelled. */
+class HandSeedApprove : public livescene::ApproveCallback
+{
+	public:
+		HandSeedApprove(const livescene::VisitedMask &visited, const livescene::BodyMass &bodies, const unsigned int &bodyLabel)
+			: _visited(visited), _bodies(bodies), _bodyLabel(bodyLabel) {}
+		bool operator ()(const unsigned int &xCoord, const unsigned int &yCoord, const unsigned short &)
+		{
+			if(_visited.test(xCoord, yCoord) || !_bodies.getLabelled(xCoord, yCoord)) return(false);
+			const unsigned int label(_bodies.getBodyLabel(xCoord, yCoord));
+			return(label == 0 || label == _bodyLabel);
+		} // operator ()
+	private:
+		const livescene::VisitedMask &_visited;
+		const livescene::BodyMass &_bodies;
+		unsigned int _bodyLabel;
+}; // HandSeedApprove
+
+void BodyMass::detectBodyHands(const unsigned int &bodyNum, const livescene::Image &foreZ, const livescene::Deadline &deadline)
+{
+	Body &body = _bodies[bodyNum];
+	body.numHands = 0;
+	body.handsSearched = false;
+	if(deadline.expired())
 	{
-		coordTriplet currentElement = searchStack.entries[searchStack.size() - 1]; // get next element for processing
-		searchStack.pop_back(); // remove it from stack before processing it
-		// process this cell and add any neighbors that need processing
-		sampleAndDepleteOneCell(foreZtoDeplete, searchStack,
-			currentElement.X, currentElement.Y, currentElement.Z, 
-			thresholdZ, Z,
-			runningX, runningY, runningZ, runningWeight);
-	} // while
+		return;
+	} // if
 
-	// normalize by runningWeight
-	if(runningWeight > 0.0f)
+	// for the following constants:
+	// M is the horizontal distance from the center of the body to the outside of one side
+	// regardless of whether the hands are extended to the sides or not.
+	// aka half of the body mass width
+	// N is the vertical distance from the waist to the top of the head (or bottom of feet)
+	// aka half of the body mass height
+	// These outlying search ratios are used to determine how far around/above the nominal body
+	// mass should be searched for extended hands.
+	const float outlyingSearchRatioM(2.2f * 2.0f), // 2.2 times M distance to either side of body centroid
+				outlyingSearchRatioN(1.5f * 2.0f), // 1.5 times N above centroid is an additional half of N distance above top of head
+				outlyingSearchRatioO(0.5f * 2.0f); // .5 times N below centroid allows hands to extend just below the belt
+
+	// determine body-plausible region bounds
+	const signed int
+		bodySearchMinX(body.centroid[0] - (body.halfExtent[0] * outlyingSearchRatioM)),
+		bodySearchMaxX(body.centroid[0] + (body.halfExtent[0] * outlyingSearchRatioM)),
+		bodySearchMinY(body.centroid[1] - (body.halfExtent[1] * outlyingSearchRatioN)),
+		bodySearchMaxY(body.centroid[1] + (body.halfExtent[1] * outlyingSearchRatioO)),
+		bodyThresholdZ(body.centroid[2] - (body.halfExtent[2] * 2.5)); // anything nearer than body front Z margin qualifies
+
+	// clamp to what the last detect() labelled, which is at most the image. Outside it there are no labels
+	// to tell this body's samples from another's.
+	const signed int
+		bodySearchMinXClamped(std::max(bodySearchMinX, (signed)_labelMinX)),
+		bodySearchMaxXClamped(std::min(bodySearchMaxX, (signed)std::min(_labelEndX, foreZ.getWidth()))),
+		bodySearchMinYClamped(std::max(bodySearchMinY, (signed)_labelMinY)),
+		bodySearchMaxYClamped(std::min(bodySearchMaxY, (signed)std::min(_labelEndY, foreZ.getHeight()))),
+		bodyThresholdZClamped(std::max(bodyThresholdZ, 0));
+	if(bodySearchMaxXClamped <= bodySearchMinXClamped || bodySearchMaxYClamped <= bodySearchMinYClamped)
 	{
-		float runningWeightInv = (1.0f / runningWeight);
-		// multiply by inverse is faster
-		weightedX = runningX * runningWeightInv;
-		weightedY = runningY * runningWeightInv;
-		weightedZ = runningZ * runningWeightInv;
-		result = true; // success
+		body.handsSearched = true;
+		return;
 	} // if
 
-	return(result);
-} // BodyMass::sampleAndDepleteAdjacentThresholded
+	// the search reads foreZ directly and marks what it takes in this body's visited mask, so foreZ
+	// is left intact and no copy is needed. The mask is cleared again over just the marked area.
+	SearchScratch &scratch = _searchScratch[bodyNum];
+	livescene::VisitedMask &visited = scratch.visited;
+	visited.reset(foreZ.getWidth(), foreZ.getHeight());
+	const livescene::ImageView region(livescene::ImageView::fromBounds(foreZ, bodySearchMinXClamped, bodySearchMinYClamped,
+		bodySearchMaxXClamped, bodySearchMaxYClamped));
+
+	body.handsSearched = true;
+	for(unsigned int handSearch = 0; handSearch < 2; handSearch++)
+	{
+		if(handSearch > 0 && deadline.expired())
+		{
+			body.handsSearched = false; // no time for the second hand
+			break;
+		} // if
+		unsigned int resultX(0), resultY(0);
+		unsigned short resultZ(0);
+		// search body region for nearest remaining Z point closer than body front. Bodies already run in parallel.
+		HandSeedApprove handSeedApprove(visited, *this, body.component.label);
+		if(region.findMinZ((unsigned short)std::min(bodyThresholdZClamped, 0xffff), resultX, resultY, resultZ, &handSeedApprove, 1, &scratch.rowMins))
+		{
+			// ensure there's at least a little bit of range between resultZ and bodyThresholdZClamped
+			// avoids divide-by-zero and poor weighting later
+			if((signed)resultZ < bodyThresholdZClamped - 2)
+			{
+				float *handCentroid = body.handCentroid[body.numHands];
+				if(sampleAdjacentThresholded(foreZ, scratch, body.component.label, bodyThresholdZClamped,
+					resultX, resultY, resultZ,
+					handCentroid[0], handCentroid[1], handCentroid[2]))
+				{
+					++body.numHands;
+				} // if
+			} // if
+		} // if
+	} // for
+
+	visited.clear();
+} // BodyMass::detectBodyHands
 
-void BodyMass::sampleAndDepleteOneCell(livescene::Image &foreZtoDeplete, CoordStack &searchStack,
-									   const unsigned int &X, const unsigned int &Y, const short &Z, 
-									   const signed int &thresholdZ, const signed int &maxZ,
-									   float &runningX, float &runningY, float &runningZ, float &runningWeight)
+
+/** \brief Tells whether a sample belongs to the hand being gathered: valid, nearer than the threshold,
+not taken yet, inside what detect() labelled and not part of another body.
+*/
+class HandSampleTest
 {
-	short *depthBuffer = (short *)foreZtoDeplete.getData();
+	public:
+		HandSampleTest(const livescene::Image &foreZ, const livescene::VisitedMask &visited, const livescene::BodyMass &bodies,
+			const unsigned int &bodyLabel, const signed int &thresholdZ)
+			: _depth((const short *)foreZ.getData()), _width(foreZ.getWidth()), _nullValue((short)foreZ.getNull()),
+			_visited(visited), _bodies(bodies), _bodyLabel(bodyLabel), _thresholdZ(thresholdZ) {}
 
+		inline bool operator ()(const unsigned int &X, const unsigned int &Y) const
+		{
+			const short depth(_depth[Y * _width + X]);
+			if(depth >= _thresholdZ || depth == _nullValue || _visited.test(X, Y) || !_bodies.getLabelled(X, Y)) return(false);
+			const unsigned int label(_bodies.getBodyLabel(X, Y));
+			return(label == 0 || label == _bodyLabel);
+		} // operator ()
+		short getDepth(const unsigned int &X, const unsigned int &Y) const {return(_depth[Y * _width + X]);}
+
+	private:
+		const short *_depth;
+		unsigned int _width;
+		short _nullValue;
+		const livescene::VisitedMask &_visited;
+		const livescene::BodyMass &_bodies;
+		unsigned int _bodyLabel;
+		signed int _thresholdZ;
+}; // HandSampleTest
+
+
+// adds one sample to the weighted centroid accumulators
+static inline void accumulateHandSample(const unsigned int &X, const unsigned int &Y, const short &Z,
+	const signed int &thresholdZ, const signed int &maxZ,
+	float &runningX, float &runningY, float &runningZ, float &runningWeight)
+{
 	// calculate weight of this sample
 	// samples nearer to the maxZ (the most-extended part of the limb) get more
 	// weight, samples near the threshold plane get much less.
@@ -245,42 +371,110 @@ void BodyMass::sampleAndDepleteOneCell(livescene::Image &foreZtoDeplete, CoordSt
 	runningZ += (Z * weight);
 	// add the weight to the running total for later normalization
 	runningWeight += weight;
+} // accumulateHandSample
 
-	// now, flag any valid neighbors for processing
-	const int spreadMargin(10);
 
-	for(int xNeighbor = -spreadMargin; xNeighbor <= spreadMargin; xNeighbor++)
+bool BodyMass::sampleAdjacentThresholded(const livescene::Image &foreZ, SearchScratch &scratch,
+									const unsigned int &bodyLabel, const signed int &thresholdZ, 
+									const unsigned int &X, const unsigned int &Y, const short &Z,
+									float &weightedX, float &weightedY, float &weightedZ) const
+{
+	// span flood fill: each seed grows into a run along its row, bridging gaps of up to _handGapBridge samples,
+	// and the rows within reach above and below the run are scanned once for hand samples to seed further runs.
+	// That gathers exactly the samples a (2 * reach + 1) square neighborhood spread would, but reads each
+	// row segment a few times instead of reading the whole neighborhood of every sample.
+	bool result(false);
+	float runningX(0.0f), runningY(0.0f), runningZ(0.0f), runningWeight(0.0f);
+	const unsigned int width(foreZ.getWidth()), height(foreZ.getHeight());
+	const unsigned int gap(_handGapBridge), reach(_handGapBridge + 1);
+	livescene::VisitedMask &visited = scratch.visited;
+	std::vector<unsigned int> &seeds = scratch.seeds;
+	const HandSampleTest isHandSample(foreZ, visited, *this, bodyLabel, thresholdZ);
+
+	// seed the search. The seed itself is taken unconditionally, it was found by ImageView::findMinZ().
+	seeds.clear();
+	visited.set(X, Y);
+	accumulateHandSample(X, Y, Z, thresholdZ, Z, runningX, runningY, runningZ, runningWeight);
+	bool seedTaken(true);
+	seeds.push_back(Y * width + X);
+
+	while(!seeds.empty())
 	{
-		for(int yNeighbor = -spreadMargin; yNeighbor <= spreadMargin; yNeighbor++)
+		const unsigned int seed(seeds.back());
+		seeds.pop_back();
+		const unsigned int seedX(seed % width), line(seed / width);
+		if(seedTaken)
+		{
+			seedTaken = false; // only the first seed arrives already taken
+		} // if
+		else
+		{
+			if(!isHandSample(seedX, line)) continue; // taken by another run since it was pushed
+			visited.set(seedX, line);
+			accumulateHandSample(seedX, line, isHandSample.getDepth(seedX, line), thresholdZ, Z, runningX, runningY, runningZ, runningWeight);
+		} // else
+
+		// grow the run both ways along the row
+		unsigned int runBegin(seedX), runEnd(seedX + 1);
+		for(unsigned int column = seedX, gapRun = 0; column > 0 && gapRun <= gap; )
 		{
-			const int currentNeighborX(X + xNeighbor), currentNeighborY(Y + yNeighbor);
-			if(currentNeighborX > 0 && currentNeighborX < (signed)foreZtoDeplete.getWidth()
-				&& currentNeighborY > 0 && currentNeighborY < (signed)foreZtoDeplete.getHeight())
+			--column;
+			if(isHandSample(column, line))
 			{
-				short neighborDepth = depthBuffer[currentNeighborY * foreZtoDeplete.getWidth() + currentNeighborX];
-				if(neighborDepth < thresholdZ && foreZtoDeplete.isCellValueValid(neighborDepth))
-				{
-					addToCoordStack(searchStack, currentNeighborX, currentNeighborY, neighborDepth);
-					// obliterate this cell so it won't be re-processed or re-added to the stack in the future
-					depthBuffer[currentNeighborY * foreZtoDeplete.getWidth() + currentNeighborX] = foreZtoDeplete.getNull();
-
-				} // if
+				visited.set(column, line);
+				accumulateHandSample(column, line, isHandSample.getDepth(column, line), thresholdZ, Z, runningX, runningY, runningZ, runningWeight);
+				runBegin = column;
+				gapRun = 0;
 			} // if
+			else ++gapRun;
+		} // for
+		for(unsigned int column = seedX + 1, gapRun = 0; column < width && gapRun <= gap; ++column)
+		{
+			if(isHandSample(column, line))
+			{
+				visited.set(column, line);
+				accumulateHandSample(column, line, isHandSample.getDepth(column, line), thresholdZ, Z, runningX, runningY, runningZ, runningWeight);
+				runEnd = column + 1;
+				gapRun = 0;
+			} // if
+			else ++gapRun;
 		} // for
-	} // for
-
-
-} // BodyMass::sampleAndDepleteOneCell
-
 
-void BodyMass::addToCoordStack(CoordStack &stack, const unsigned int &X, const unsigned int &Y, const short &Z)
-{
+		// one seed for each group of hand samples within reach of the run on the neighboring rows
+		const unsigned int scanBegin(runBegin > reach ? runBegin - reach : 0), scanEnd(std::min(runEnd + reach, width));
+		const unsigned int neighborBegin(line > reach ? line - reach : 0), neighborEnd(std::min(line + reach + 1, height));
+		for(unsigned int neighbor = neighborBegin; neighbor < neighborEnd; ++neighbor)
+		{
+			if(neighbor == line) continue;
+			unsigned int gapRun(reach); // not in a group yet
+			for(unsigned int column = scanBegin; column < scanEnd; ++column)
+			{
+				if(isHandSample(column, neighbor))
+				{
+					if(gapRun > gap)
+					{
+						seeds.push_back(neighbor * width + column); // its run will bridge to the rest of the group
+					} // if
+					gapRun = 0;
+				} // if
+				else ++gapRun;
+			} // for
+		} // for
+	} // while
 
-	if(stack.size() < OSG_LIVESCENEVIEW_DETECT_MAX_STACK)
+	// normalize by runningWeight
+	if(runningWeight > 0.0f)
 	{
-		stack.push_back(coordTriplet(X, Y, Z));
+		float runningWeightInv = (1.0f / runningWeight);
+		// multiply by inverse is faster
+		weightedX = runningX * runningWeightInv;
+		weightedY = runningY * runningWeightInv;
+		weightedZ = runningZ * runningWeightInv;
+		result = true; // success
 	} // if
-} // BodyMass::addToCoordStack
+
+	return(result);
+} // BodyMass::sampleAdjacentThresholded
 
 
 // namespace livescene
@@ -42,6 +42,7 @@ _numUnits(0), _allocatedUnits(0), _f_ctx(NULL)
 	_currentCapabilities.push_back("IMAGE_Z_DEPTH_11_BIT");
 	_currentCapabilities.push_back("IMAGE_Z_DEPTH_11_BIT_RLEDIFF");
 	_currentCapabilities.push_back("IMAGE_Z_DEPTH_16_BIT");
+	_currentCapabilities.push_back("IMAGE_Z_DEPTH_MM_16");
 	_currentCapabilities.push_back("IMAGE_Z_FPS_30");
 	_currentCapabilities.push_back("IMAGE_Z_SMOOTHING");
 	_currentCapabilities.push_back("IMAGE_Z_FLIP_H");
@@ -224,6 +225,22 @@ bool DeviceFreenect::getImageSync(livescene::Image &image)
 			return(true);
 		} // if
 	} // else if
+	else if(image.getFormat() == livescene::DEPTH_MM_16)
+	{
+        uint32_t ts;
+        unsigned short* buffer( NULL );
+        if(freenect_sync_get_depth( (void**)&buffer, &ts, getUnit(), FREENECT_DEPTH_11BIT ) == 0)
+		{
+			// convert through the lookup table into our own buffer, which lives as long as the device,
+			// the same way the sync interface's buffers do
+			livescene::Image rawZ(_defaultWidth, _defaultHeight, _defaultZdepth, livescene::DEPTH_11BIT);
+			rawZ.setData(buffer);
+			rawZ.setTimestamp(ts);
+			_millimetersBuffer.resize(_defaultWidth * _defaultHeight);
+			image.setData(&_millimetersBuffer.front());
+			return(_depthConversion.convertToMillimeters(rawZ, image));
+		} // if
+	} // else if
 return(false);
 } // DeviceFreenect::getImageSync
 
@@ -261,6 +278,8 @@ int DeviceFreenect::getCurrentImageDepth(const VideoFormat format)
 	{
 	case livescene::VIDEO_RGB: return(_defaultRGBdepth); break;
 	case livescene::DEPTH_10BIT: return(_defaultZdepth); break;
+	case livescene::DEPTH_11BIT: return(_defaultZdepth); break;
+	case livescene::DEPTH_MM_16: return(_defaultZdepth); break;
 	default: return(0); break;
 	} // switch format
 } // DeviceFreenect::getCurrentImageDepth
@@ -0,0 +1,214 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#include "liblivescene/Extremities.h"
+#include "liblivescene/Detect.h"
+#include <algorithm> // std::min/max/fill
+#include <cstdlib> // abs
+#include <cmath> // fabs
+
+namespace livescene {
+
+// step costs of the bucket queue, roughly 2 and 2 * sqrt(2)
+const unsigned int EXTREMITY_ORTHOGONAL_STEP(2), EXTREMITY_DIAGONAL_STEP(3);
+// ring size, one more than the largest step, so a bucket is empty again before it is reused
+const unsigned int EXTREMITY_NUM_BUCKETS(4);
+
+
+unsigned int ExtremityDetector::detect(const livescene::Image &foreZ, const livescene::BodyMass &bodies, const unsigned int &bodyNum)
+{
+	const livescene::ComponentStats *body = bodies.getBodyComponent(bodyNum);
+	if(!body || bodies.getLabelLevel() != 0) // coarse bodies have no full resolution labels to walk
+	{
+		_extremities.clear();
+		return(0);
+	} // if
+	return(detect(foreZ, bodies.getLabeler(), *body));
+} // ExtremityDetector::detect
+
+
+unsigned int ExtremityDetector::detect(const livescene::Image &foreZ, const livescene::ComponentLabeler &labeler, const livescene::ComponentStats &body)
+{
+	_extremities.clear();
+	if(!foreZ.getData() || body.count == 0 || body.maxX >= foreZ.getWidth() || body.maxY >= foreZ.getHeight())
+	{
+		_boundsWidth = _boundsHeight = 0;
+		return(0);
+	} // if
+
+	// the distance buffer only covers the body
+	_boundsX = body.minX;
+	_boundsY = body.minY;
+	_boundsWidth = body.maxX - body.minX + 1;
+	_boundsHeight = body.maxY - body.minY + 1;
+	_distances.resize(_boundsWidth * _boundsHeight);
+	std::fill(_distances.begin(), _distances.end(), (unsigned int)UNREACHED);
+
+	// start from the body sample nearest the centroid, which may itself be a hole
+	const float centroidX(body.getCentroidX()), centroidY(body.getCentroidY());
+	unsigned int sourceIndex(0);
+	float nearestDistanceSquared(-1.0f);
+	for(unsigned int line = 0; line < _boundsHeight; ++line)
+	{
+		for(unsigned int column = 0; column < _boundsWidth; ++column)
+		{
+			if(labeler.getLabel(_boundsX + column, _boundsY + line) == body.label)
+			{
+				const float deltaX(_boundsX + column - centroidX), deltaY(_boundsY + line - centroidY);
+				const float distanceSquared(deltaX * deltaX + deltaY * deltaY);
+				if(nearestDistanceSquared < 0.0f || distanceSquared < nearestDistanceSquared)
+				{
+					nearestDistanceSquared = distanceSquared;
+					sourceIndex = line * _boundsWidth + column;
+				} // if
+			} // if
+		} // for
+	} // for
+	if(nearestDistanceSquared < 0.0f)
+	{
+		return(0); // labels don't belong to this body
+	} // if
+	propagate(foreZ, labeler, body.label, sourceIndex);
+
+	// each extremity is the farthest sample from the centroid and every extremity before it
+	const unsigned int minDistance((unsigned int)(_minExtremityDistance * _boundsHeight * EXTREMITY_ORTHOGONAL_STEP));
+	const unsigned short *depthBuffer = (const unsigned short *)foreZ.getData();
+	while(_extremities.size() < _maxExtremities)
+	{
+		unsigned int farthestDistance(0);
+		const unsigned int farthestIndex(findFarthest(farthestDistance));
+		if(farthestDistance == 0 || farthestDistance < minDistance)
+		{
+			break;
+		} // if
+		const unsigned int farthestX(_boundsX + farthestIndex % _boundsWidth), farthestY(_boundsY + farthestIndex / _boundsWidth);
+		livescene::Extremity extremity;
+		extremity.position[0] = farthestX;
+		extremity.position[1] = farthestY;
+		extremity.position[2] = depthBuffer[farthestY * foreZ.getWidth() + farthestX];
+		extremity.geodesicDistance = (float)farthestDistance / EXTREMITY_ORTHOGONAL_STEP;
+		_extremities.push_back(extremity);
+		propagate(foreZ, labeler, body.label, farthestIndex);
+	} // while
+
+	// type them by where they are around the body
+	const float stdDevX(body.getStdDevX()), stdDevY(body.getStdDevY());
+	int head(-1);
+	for(unsigned int extremityNum = 0; extremityNum < _extremities.size(); ++extremityNum)
+	{
+		livescene::Extremity &extremity = _extremities[extremityNum];
+		if(extremity.position[1] > centroidY + 1.2f * stdDevY)
+		{
+			extremity.type = livescene::Extremity::FOOT;
+		} // if
+		else
+		{
+			extremity.type = livescene::Extremity::HAND;
+			// only the highest extremity above the shoulders and over the centroid is the head, any others up there are raised hands
+			if(extremity.position[1] < centroidY - stdDevY && fabs(extremity.position[0] - centroidX) < stdDevX
+				&& (head < 0 || extremity.position[1] < _extremities[head].position[1]))
+			{
+				head = extremityNum;
+			} // if
+		} // else
+	} // for
+	if(head >= 0)
+	{
+		_extremities[head].type = livescene::Extremity::HEAD;
+	} // if
+
+	return(_extremities.size());
+} // ExtremityDetector::detect
+
+
+void ExtremityDetector::propagate(const livescene::Image &foreZ, const livescene::ComponentLabeler &labeler, const unsigned int &bodyLabel,
+	const unsigned int &sourceIndex)
+{
+	const unsigned short *depthBuffer = (const unsigned short *)foreZ.getData();
+	const unsigned int imageWidth(foreZ.getWidth());
+	const int depthContinuity(labeler.getDepthContinuity());
+	static const int neighborX[8] = {-1, 0, 1, -1, 1, -1, 0, 1}, neighborY[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+	static const unsigned int neighborStep[8] = {EXTREMITY_DIAGONAL_STEP, EXTREMITY_ORTHOGONAL_STEP, EXTREMITY_DIAGONAL_STEP,
+		EXTREMITY_ORTHOGONAL_STEP, EXTREMITY_ORTHOGONAL_STEP, EXTREMITY_DIAGONAL_STEP, EXTREMITY_ORTHOGONAL_STEP, EXTREMITY_DIAGONAL_STEP};
+
+	for(unsigned int bucket = 0; bucket < EXTREMITY_NUM_BUCKETS; ++bucket)
+	{
+		_buckets[bucket].clear();
+	} // for
+	_distances[sourceIndex] = 0;
+	_buckets[0].push_back(sourceIndex);
+	unsigned int pending(1);
+
+	// every entry of the current bucket was pushed at exactly the current distance, since steps are
+	// shorter than the ring. Entries whose distance has dropped since are stale and skipped.
+	for(unsigned int distance = 0; pending > 0; ++distance)
+	{
+		std::vector<unsigned int> &bucket = _buckets[distance % EXTREMITY_NUM_BUCKETS];
+		// relaxing never pushes into the current bucket, so it can be walked by index while the others grow
+		for(unsigned int entry = 0; entry < bucket.size(); ++entry)
+		{
+			const unsigned int index(bucket[entry]);
+			if(_distances[index] != distance)
+			{
+				continue;
+			} // if
+			const int column(index % _boundsWidth), line(index / _boundsWidth);
+			const int depth(depthBuffer[(_boundsY + line) * imageWidth + _boundsX + column]);
+			for(unsigned int neighbor = 0; neighbor < 8; ++neighbor)
+			{
+				const int neighborColumn(column + neighborX[neighbor]), neighborLine(line + neighborY[neighbor]);
+				if(neighborColumn < 0 || neighborColumn >= (int)_boundsWidth || neighborLine < 0 || neighborLine >= (int)_boundsHeight)
+				{
+					continue;
+				} // if
+				const unsigned int neighborIndex(neighborLine * _boundsWidth + neighborColumn);
+				const unsigned int neighborDistance(distance + neighborStep[neighbor]);
+				if(neighborDistance >= _distances[neighborIndex])
+				{
+					continue;
+				} // if
+				const unsigned int parentX(_boundsX + neighborColumn), parentY(_boundsY + neighborLine);
+				if(labeler.getLabel(parentX, parentY) != bodyLabel
+					|| abs((int)depthBuffer[parentY * imageWidth + parentX] - depth) > depthContinuity)
+				{
+					continue;
+				} // if
+				_distances[neighborIndex] = neighborDistance;
+				_buckets[neighborDistance % EXTREMITY_NUM_BUCKETS].push_back(neighborIndex);
+				++pending;
+			} // for
+		} // for
+		pending -= bucket.size();
+		bucket.clear();
+	} // for
+} // ExtremityDetector::propagate
+
+
+unsigned int ExtremityDetector::findFarthest(unsigned int &farthestDistance) const
+{
+	unsigned int farthestIndex(0);
+	farthestDistance = 0;
+	for(unsigned int index = 0; index < _distances.size(); ++index)
+	{
+		if(_distances[index] != UNREACHED && _distances[index] > farthestDistance)
+		{
+			farthestDistance = _distances[index];
+			farthestIndex = index;
+		} // if
+	} // for
+	return(farthestIndex);
+} // ExtremityDetector::findFarthest
+
+
+float ExtremityDetector::getGeodesicDistance(const unsigned int &X, const unsigned int &Y) const
+{
+	if(X - _boundsX >= _boundsWidth || Y - _boundsY >= _boundsHeight) // unsigned wrap covers below-origin too
+	{
+		return(-1.0f);
+	} // if
+	const unsigned int distance(_distances[(Y - _boundsY) * _boundsWidth + X - _boundsX]);
+	return(distance == UNREACHED ? -1.0f : (float)distance / EXTREMITY_ORTHOGONAL_STEP);
+} // ExtremityDetector::getGeodesicDistance
+
+
+// namespace livescene
+}
@@ -1,8 +1,10 @@
 // Copyright 2011 Skew Matrix Software and AlphaPixel
 
 #include "liblivescene/GeometryBuilder.h"
+#include "liblivescene/Parallel.h"
 #include <limits>
 #include <cstring> // memset
+#include <vector>
 
 namespace livescene {
 
@@ -15,6 +17,7 @@ Geometry::~Geometry()
 void Geometry::freeTempBuffer(void)
 {
 	delete [] _indicesTempBuffer; _indicesTempBuffer = 0;
+	delete [] _cellsTempBuffer; _cellsTempBuffer = 0;
 } // Geometry::freeTempBuffer
 
 void Geometry::freeData(void)
@@ -54,12 +57,19 @@ void Geometry::allocTempBuffer(void)
 {
 	if(!_indicesTempBuffer)
 		_indicesTempBuffer = new unsigned int[getHeight() * getWidth()];
+	if(!_cellsTempBuffer)
+		_cellsTempBuffer = new unsigned char[getHeight() * getWidth()];
 } // Geometry::allocTempBuffer
 
 
-void Geometry::clearTempBuffer(const unsigned int &_clearValue)
+void Geometry::clearTempBuffer(const unsigned int &_clearValue, const livescene::ImageView &region)
 {
-	std::fill( _indicesTempBuffer, _indicesTempBuffer + (getHeight() * getWidth()), _clearValue );
+	// only the region being meshed can be referenced, so don't pay to clear the rest
+	for(unsigned int line = 0; line < region.getHeight(); ++line)
+	{
+		unsigned int *tempRow = _indicesTempBuffer + (region.getOriginY() + line) * getWidth() + region.getOriginX();
+		std::fill( tempRow, tempRow + region.getWidth(), _clearValue );
+	} // for
 
 } // Geometry::clearTempBuffer
 
@@ -67,10 +77,16 @@ void Geometry::clearTempBuffer(const unsigned int &_clearValue)
 
 
 bool Geometry::buildPointCloud(const livescene::Image &imageZ, const livescene::Image * const imageRGB)
+{
+	return(buildPointCloud(imageZ.getView(), imageRGB));
+} // buildPointCloud
+
+
+bool Geometry::buildPointCloud(const livescene::ImageView &imageZ, const livescene::Image * const imageRGB)
 {
 	_entityType = GEOMETRY_POINTS;
-	_width = imageZ.getWidth();
-	_height = imageZ.getHeight();
+	_width = imageZ.getParentWidth();
+	_height = imageZ.getParentHeight();
 
 	// we have to allocate for worst-case, all vertices/indices used
 	// but after the null processing loop below we'll reset these to
@@ -83,29 +99,29 @@ bool Geometry::buildPointCloud(const livescene::Image &imageZ, const livescene::
 	allocData(_numVertices, _numIndices, _numTexCoords, _numNormals);
 
 	int width(imageZ.getWidth()), height(imageZ.getHeight());
-	const float invWidth(1.0f/ width), invHeight(1.0f / height);
-	short *depthBuffer = (short *)imageZ.getData();
+	const int originX(imageZ.getOriginX()), originY(imageZ.getOriginY());
+	const float invWidth(1.0f/ _width), invHeight(1.0f / _height);
 
 	// loop logic taken from libfreenect glpclview, DrawGLScene()
-	unsigned int loopSub(0), vertSub(0), indexSub(0), texSub(0), normSub(0);
+	unsigned int vertSub(0), indexSub(0), texSub(0), normSub(0);
 	for(int line = 0; line < height; ++line)
 	{
-		const float lineTC = (float)line * invHeight; // inverse multiply
+		const float lineTC = (float)(originY + line) * invHeight; // inverse multiply
+		const short *depthRow = (const short *)imageZ.getRow(line);
 		for(int column = 0; column < width; ++column)
 		{
-			const float columnTC = (float)column * invWidth; // inverse multiply
-			short originalDepth = depthBuffer[loopSub];
+			const float columnTC = (float)(originX + column) * invWidth; // inverse multiply
+			short originalDepth = depthRow[column];
 			if(imageZ.isCellValueValid(originalDepth))
 			{
 				//_indices[indexSub] = vertSub;
-				_vertices[vertSub++] = column;
-				_vertices[vertSub++] = line;
+				_vertices[vertSub++] = originX + column;
+				_vertices[vertSub++] = originY + line;
 				_vertices[vertSub++] = originalDepth;
 				_texcoord[texSub++] = columnTC; // X
 				_texcoord[texSub++] = lineTC; // Y
 				indexSub++;
 			} // if
-			loopSub++;
 		} // for
 	} // for lines
 
@@ -118,305 +134,365 @@ bool Geometry::buildPointCloud(const livescene::Image &imageZ, const livescene::
 } // buildPointCloud
 
 
-bool Geometry::buildFaces(const livescene::Image &imageZ, const livescene::Image * const imageRGB)
+// fewest lines of mesh cells worth a band of their own, so small regions don't pay thread overhead for nothing
+const unsigned int GEOMETRY_LINES_PER_BAND_MIN(16);
+// temp buffer value for samples not yet given a vertex, since 0 is a valid index
+const unsigned int GEOMETRY_TEMP_BUFFER_UNUSED(std::numeric_limits<unsigned int>::max());
+// corners of each Geometry::CELL_ triangle in the order they are emitted: 0 UL, 1 UR, 2 LL, 3 LR
+const unsigned int GEOMETRY_TRIANGLE_CORNERS[4][3] = {{0, 2, 3}, {0, 3, 1}, {0, 2, 1}, {2, 1, 3}};
+
+
+/** \brief Meshes bands of lines for Geometry::buildFacesBanded().
+The COUNT pass classifies each band's cells, and counts its triangles and the vertices it uses first.
+The FILL pass writes them to the stretch of output assignOutput() gave the band. A band never writes
+the indices of vertices its first line of cells shares with the band above, since the band above
+numbers them; stitch() writes those once every band is filled. A lone band can skip counting.
+*/
+class FaceBands : public livescene::BandCallback
 {
-	// define our "unused" value, since 0 is a valid value
-	const unsigned int _tempBufferUnusedValue = std::numeric_limits<unsigned int>::max();
-	_entityType = GEOMETRY_FACES;
-	_width = imageZ.getWidth();
-	_height = imageZ.getHeight();
+	public:
+		enum Pass {COUNT, FILL};
+
+		FaceBands(Geometry &geometry, const livescene::ImageView &imageZ, const bool &simple, const unsigned int &numBands)
+			: _geometry(geometry), _imageZ(imageZ), _simple(simple), _pass(FILL), _counted(false),
+			_width(imageZ.getWidth()), _stride(imageZ.getStride()), _originX(imageZ.getOriginX()), _originY(imageZ.getOriginY()),
+			_invWidth(1.0f / geometry.getWidth()), _invHeight(1.0f / geometry.getHeight()),
+			_depthBuffer((const short *)imageZ.getData()),
+			_tempBuffer(geometry._indicesTempBuffer + imageZ.getOriginY() * imageZ.getStride() + imageZ.getOriginX()),
+			_cells(geometry._cellsTempBuffer + imageZ.getOriginY() * imageZ.getStride() + imageZ.getOriginX()),
+			_bands(numBands)
+		{
+			// spread the remainder over the first bands so they differ by at most one line
+			const unsigned int numLines(imageZ.getHeight() - 1), linesPerBand(numLines / numBands), extraLines(numLines % numBands);
+			for(unsigned int bandNum = 0, beginLine = 0; bandNum < numBands; ++bandNum)
+			{
+				_bands[bandNum].beginLine = beginLine;
+				beginLine += linesPerBand + (bandNum < extraLines ? 1 : 0);
+				_bands[bandNum].endLine = beginLine;
+			} // for
+		} // FaceBands
 
-	// we have to allocate for worst-case, all vertices/indices used
-	// but after the null processing loop below we'll reset these to
-	// indicate the number actually used.
-	// the resource tracking knows how many really need to be freed, so this is ok
+		void setPass(const Pass &pass) {_pass = pass;}
 
-	int width(imageZ.getWidth()), height(imageZ.getHeight());
-	const float invWidth(1.0f/ width), invHeight(1.0f / height);
+		virtual void operator ()(const unsigned int &begin, const unsigned int &end)
+		{
+			for(unsigned int bandNum = begin; bandNum < end; ++bandNum)
+			{
+				if(_pass == COUNT)
+					count(_bands[bandNum]);
+				else
+					fill(_bands[bandNum]);
+			} // for
+		} // operator ()
+
+		// gives each band its stretch of the output arrays, in band order, from the COUNT pass
+		void assignOutput(void)
+		{
+			for(unsigned int bandNum = 1; bandNum < _bands.size(); ++bandNum)
+			{
+				_bands[bandNum].firstVertex = _bands[bandNum - 1].firstVertex + _bands[bandNum - 1].numVertices;
+				_bands[bandNum].firstTriangle = _bands[bandNum - 1].firstTriangle + _bands[bandNum - 1].numTriangles;
+			} // for
+			_counted = true;
+		} // assignOutput
+
+		// writes the indices each band's first line of cells left for the band above to number. Call after the FILL pass.
+		void stitch(void)
+		{
+			for(unsigned int bandNum = 1; bandNum < _bands.size(); ++bandNum)
+			{
+				const int line(_bands[bandNum].beginLine);
+				unsigned int indexSub(_bands[bandNum].firstTriangle * 3);
+				for(int column = 0; column < _width - 1; ++column)
+				{
+					const unsigned int cell(_cells[line * _stride + column]);
+					for(unsigned int triangle = 0; triangle < 4; ++triangle)
+					{
+						if(!(cell & (1 << triangle)))
+							continue;
+						for(unsigned int cornerNum = 0; cornerNum < 3; ++cornerNum)
+						{
+							const unsigned int corner(GEOMETRY_TRIANGLE_CORNERS[triangle][cornerNum]);
+							_geometry._indices[indexSub++] = _tempBuffer[(line + (corner >> 1)) * _stride + column + (corner & 1)];
+						} // for
+					} // for
+				} // for
+			} // for
+		} // stitch
+
+		// totals over all bands, after the FILL pass
+		void getTotals(unsigned int &numVertices, unsigned int &numTriangles) const
+		{
+			numVertices = numTriangles = 0;
+			for(unsigned int bandNum = 0; bandNum < _bands.size(); ++bandNum)
+			{
+				numVertices += _bands[bandNum].numVertices;
+				numTriangles += _bands[bandNum].numTriangles;
+			} // for
+		} // getTotals
+
+	private:
+		// CELL_ triangles using each corner
+		enum
+		{
+			USES_UL = Geometry::CELL_UL_LL_LR | Geometry::CELL_UL_LR_UR | Geometry::CELL_UL_LL_UR,
+			USES_UR = Geometry::CELL_UL_LR_UR | Geometry::CELL_UL_LL_UR | Geometry::CELL_LL_UR_LR,
+			USES_LL = Geometry::CELL_UL_LL_LR | Geometry::CELL_UL_LL_UR | Geometry::CELL_LL_UR_LR,
+			USES_LR = Geometry::CELL_UL_LL_LR | Geometry::CELL_UL_LR_UR | Geometry::CELL_LL_UR_LR
+		};
 
-	// because each sample can be in up to 4 triangle polygons
-	const int vertsPerTri(3), maxTrisPerCell(2), totalSamples(width * height);
-	const int maxNumTris = (width - 1) * (height - 1) * maxTrisPerCell; // two tris per cell that spans two samples
-	_numVertices  = totalSamples; // one per sample
-	_numIndices   = maxNumTris * vertsPerTri; // we recycle vertices, but indices are not duplicated
-	_numTexCoords = totalSamples; // one per sample
-	_numNormals   = 0; // width * height; // may not need normals if we're not lighting it
-	allocData(_numVertices, _numIndices, _numTexCoords, _numNormals);
-	allocTempBuffer(); // will only allocate if not already allocated. Must be done after allocData
-	// we need to clear the array each time through, even if it's already allocated
-	clearTempBuffer(_tempBufferUnusedValue); // clear to "unused" value
+		struct Band
+		{
+			Band() : beginLine(0), endLine(0), numVertices(0), numTriangles(0), firstVertex(0), firstTriangle(0) {}
 
+			int beginLine, endLine; // lines of mesh cells, a cell spanning its line and the next
+			unsigned int numVertices, numTriangles;
+			unsigned int firstVertex, firstTriangle;
+			std::vector<unsigned char> shared; // samples on beginLine that the band above uses first
+		};
 
-	short *depthBuffer = (short *)imageZ.getData();
+		// records the CELL_ triangles of a line of cells in _cells
+		void classifyLine(const int &line)
+		{
+			// locals, since the byte stores could otherwise be taken to change anything
+			const Geometry &geometry(_geometry);
+			const livescene::ImageView imageZ(_imageZ);
+			const short *depthBuffer(_depthBuffer);
+			unsigned char *cells(_cells);
+			const int width(_width), stride(_stride);
+			const bool simple(_simple);
+			for(int column = 0, loopSub = line * stride; column < width - 1; ++column, ++loopSub)
+			{
+				cells[loopSub] = geometry.classifyCell(imageZ, depthBuffer[loopSub], depthBuffer[loopSub + 1],
+					depthBuffer[loopSub + stride], depthBuffer[loopSub + stride + 1], simple);
+			} // for
+		} // classifyLine
 
-	// loop logic taken from libfreenect glpclview, DrawGLScene()
-	// the meshing algorithm is excessively complicated because it normally splits
-	// four-point cells into two three-point triangle with the split running UL-LR.
-	// however, if that's not possible, but it can form one or the other triangle
-	// if the split runs LL-UR, it will try to do so. This reduces sawtooth edges
-	// along borders between data and no-data.
-	unsigned int loopSub(0), vertSub(0), vertCount(0), indexSub(0), texSub(0), normSub(0), polyCount(0);
-	for(int line = 0; line < height - 1; ++line) // NOTE: height - 1
-	{
-		const float lineTC = (float)line * invHeight; // inverse multiply
-		const float linePlusOneTC = (float)(line + 1) * invHeight; // inverse multiply
-		for(int column = 0; column < width - 1; ++column) // NOTE: width - 1
+		static inline void markUsed(unsigned char &used, unsigned int &numVertices)
 		{
-			const unsigned int loopSub = line * width + column;
-			const unsigned int loopSubPlusOneColumn = line * width + column + 1;
-			const unsigned int loopSubPlusOneRow = (line + 1)* width + column;
-			const unsigned int loopSubPlusOneRowColumn = (line + 1)* width + column + 1;
-
-			const float columnTC = (float)column * invWidth; // inverse multiply
-			const float columnPlusOneTC = (float)(column + 1) * invWidth; // inverse multiply
-			// preread these four since we'll need them repeatedly
-			short depthUL = depthBuffer[loopSub];
-			short depthUR = depthBuffer[loopSubPlusOneColumn];
-			short depthLL = depthBuffer[loopSubPlusOneRow];
-			short depthLR = depthBuffer[loopSubPlusOneRowColumn];
-			// is top-left sample of mesh cell (at loop subscripts) non-rejected?
-			if(imageZ.isCellValueValid(depthUL))
+			if(!used)
 			{
-				// is LR vertex valid, allowing for potentially both polygons split UL<->LR?
-				if(imageZ.isCellValueValid(depthLR))
-				{ // try to form two triangles, UL, LL, LR and UL, LR, UR
-					// is LL valid, allowing UL, LL, LR?
-					if(imageZ.isCellValueValid(depthLL)
-						&& isTriRangeMeshable(depthUL, depthLL, depthLR))
-					{
-						// form UL, LL, LR triangle
-						// UL
-						if(_indicesTempBuffer[loopSub] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSub] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column;
-							_vertices[vertSub++] = line;
-							_vertices[vertSub++] = depthUL;
-							_texcoord[texSub++] = columnTC; // X
-							_texcoord[texSub++] = lineTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSub];
-
-						// LL
-						if(_indicesTempBuffer[loopSubPlusOneRow] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSubPlusOneRow] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column;
-							_vertices[vertSub++] = line + 1;
-							_vertices[vertSub++] = depthLL;
-							_texcoord[texSub++] = columnTC; // X
-							_texcoord[texSub++] = linePlusOneTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneRow];
-
-						// LR
-						if(_indicesTempBuffer[loopSubPlusOneRowColumn] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSubPlusOneRowColumn] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column + 1;
-							_vertices[vertSub++] = line + 1;
-							_vertices[vertSub++] = depthLR;
-							_texcoord[texSub++] = columnPlusOneTC; // X
-							_texcoord[texSub++] = linePlusOneTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneRowColumn];
-
-						polyCount++;
-					} // if
-					
-					// is UR valid, allowing UL, LR, UR?
-					if(imageZ.isCellValueValid(depthUR)
-						&& isTriRangeMeshable(depthUL, depthLR, depthUR))
-					{
-						// form UL, LR, UR triangle
-						// UL
-						if(_indicesTempBuffer[loopSub] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSub] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column;
-							_vertices[vertSub++] = line;
-							_vertices[vertSub++] = depthUL;
-							_texcoord[texSub++] = columnTC; // X
-							_texcoord[texSub++] = lineTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSub];
-
-						// LR
-						if(_indicesTempBuffer[loopSubPlusOneRowColumn] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSubPlusOneRowColumn] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column + 1;
-							_vertices[vertSub++] = line + 1;
-							_vertices[vertSub++] = depthLR;
-							_texcoord[texSub++] = columnPlusOneTC; // X
-							_texcoord[texSub++] = linePlusOneTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneRowColumn];
-
-						// UR
-						if(_indicesTempBuffer[loopSubPlusOneColumn] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSubPlusOneColumn] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column + 1;
-							_vertices[vertSub++] = line;
-							_vertices[vertSub++] = depthUR;
-							_texcoord[texSub++] = columnPlusOneTC; // X
-							_texcoord[texSub++] = lineTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneColumn];
-
-						polyCount++;
-					} // if
-				} // if
-				// are at least UR and LL left valid, allowing one UL, LL, UR?
-				else if(imageZ.isCellValueValid(depthLL) && imageZ.isCellValueValid(depthUR)
-					&& isTriRangeMeshable(depthUL, depthLL, depthUR))
+				used = 1;
+				++numVertices;
+			} // if
+		} // markUsed
+
+		void count(Band &band)
+		{
+			// locals, since the byte stores below could otherwise be taken to change anything
+			const Geometry &geometry(_geometry);
+			const livescene::ImageView &imageZ(_imageZ);
+			const short *depthBuffer(_depthBuffer);
+			unsigned char *cells(_cells);
+			const int width(_width), stride(_stride), endLine(band.endLine);
+			const bool simple(_simple);
+
+			// the line of cells above the band uses some of its first line's samples before it does
+			band.shared.assign(width, 0);
+			if(band.beginLine > 0)
+			{
+				unsigned char *shared = &band.shared[0];
+				for(int column = 0, loopSub = (band.beginLine - 1) * stride; column < width - 1; ++column, ++loopSub)
 				{
-					// form UL, LL, UR triangle
-					// UL
-					if(_indicesTempBuffer[loopSub] == _tempBufferUnusedValue)
-					{
-						// record where we put this sample's vertex/texcoord for later reference
-						_indicesTempBuffer[loopSub] = vertCount++;
-						// and then add the vertex where we said we would
-						_vertices[vertSub++] = column;
-						_vertices[vertSub++] = line;
-						_vertices[vertSub++] = depthUL;
-						_texcoord[texSub++] = columnTC; // X
-						_texcoord[texSub++] = lineTC; // Y
-					} // if
-					// add a reference to where the vertex is already stored
-					_indices[indexSub++] = _indicesTempBuffer[loopSub];
-
-					// LL
-					if(_indicesTempBuffer[loopSubPlusOneRow] == _tempBufferUnusedValue)
-					{
-						// record where we put this sample's vertex/texcoord for later reference
-						_indicesTempBuffer[loopSubPlusOneRow] = vertCount++;
-						// and then add the vertex where we said we would
-						_vertices[vertSub++] = column;
-						_vertices[vertSub++] = line + 1;
-						_vertices[vertSub++] = depthLL;
-						_texcoord[texSub++] = columnTC; // X
-						_texcoord[texSub++] = linePlusOneTC; // Y
-					} // if
-					// add a reference to where the vertex is already stored
-					_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneRow];
-
-					// UR
-					if(_indicesTempBuffer[loopSubPlusOneColumn] == _tempBufferUnusedValue)
-					{
-						// record where we put this sample's vertex/texcoord for later reference
-						_indicesTempBuffer[loopSubPlusOneColumn] = vertCount++;
-						// and then add the vertex where we said we would
-						_vertices[vertSub++] = column + 1;
-						_vertices[vertSub++] = line;
-						_vertices[vertSub++] = depthUR;
-						_texcoord[texSub++] = columnPlusOneTC; // X
-						_texcoord[texSub++] = lineTC; // Y
-					} // if
-					// add a reference to where the vertex is already stored
-					_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneColumn];
-
-					polyCount++;
-				} // else if
+					const unsigned int cell(geometry.classifyCell(imageZ, depthBuffer[loopSub], depthBuffer[loopSub + 1],
+						depthBuffer[loopSub + stride], depthBuffer[loopSub + stride + 1], simple));
+					if(cell & USES_LL)
+						shared[column] = 1;
+					if(cell & USES_LR)
+						shared[column + 1] = 1;
+				} // for
 			} // if
-			// we still might make a triangle out of UR, LR, LL if all are valid even if UL is NULL
-			else if(imageZ.isCellValueValid(depthLL) && imageZ.isCellValueValid(depthUR) && imageZ.isCellValueValid(depthLR)
-				&& isTriRangeMeshable(depthLL, depthUR, depthLR))
+
+			// samples used so far on the upper and lower lines of the current line of cells
+			std::vector<unsigned char> usedLines(width * 2, 0);
+			unsigned char *upper = &usedLines[0], *lower = upper + width;
+			std::copy(band.shared.begin(), band.shared.end(), upper);
+			unsigned int numVertices(0), numTriangles(0);
+			for(int line = band.beginLine; line < endLine; ++line)
 			{
-				// form LL, UR, LR triangle
-				// LL
-				if(_indicesTempBuffer[loopSubPlusOneRow] == _tempBufferUnusedValue)
+				classifyLine(line);
+				for(int column = 0, loopSub = line * stride; column < width - 1; ++column, ++loopSub)
 				{
-					// record where we put this sample's vertex/texcoord for later reference
-					_indicesTempBuffer[loopSubPlusOneRow] = vertCount++;
-					// and then add the vertex where we said we would
-					_vertices[vertSub++] = column;
-					_vertices[vertSub++] = line + 1;
-					_vertices[vertSub++] = depthLL;
-					_texcoord[texSub++] = columnTC; // X
-					_texcoord[texSub++] = linePlusOneTC; // Y
-				} // if
-				// add a reference to where the vertex is already stored
-				_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneRow];
+					const unsigned int cell(cells[loopSub]);
+					if(!cell)
+						continue;
+					numTriangles += (cell & (cell - 1)) ? 2 : 1; // at most two triangles to a cell
+					if(cell & USES_UL)
+						markUsed(upper[column], numVertices);
+					if(cell & USES_UR)
+						markUsed(upper[column + 1], numVertices);
+					if(cell & USES_LL)
+						markUsed(lower[column], numVertices);
+					if(cell & USES_LR)
+						markUsed(lower[column + 1], numVertices);
+				} // for
+				std::swap(upper, lower);
+				std::fill(lower, lower + width, 0);
+			} // for
+			band.numVertices = numVertices;
+			band.numTriangles = numTriangles;
+		} // count
+
+		/** \brief Where fill() writes, copied into locals so stores to the output aren't taken to change it. */
+		struct Output
+		{
+			short *vertices;
+			float *texCoords;
+			unsigned int *indices, *tempBuffer;
+			const short *depthBuffer;
+			int originX, originY;
+			float invWidth, invHeight;
+			unsigned int vertCount, indexSub;
+		};
+
+		// adds a reference to the vertex of the sample at cornerSub, adding the vertex first if it has none yet
+		static inline void addCorner(Output &output, const unsigned int &cornerSub, const int &column, const int &line, const bool &shared)
+		{
+			if(shared)
+			{
+				// the band above numbers this one, see stitch()
+				++output.indexSub;
+				return;
+			} // if
+			unsigned int vertexNum(output.tempBuffer[cornerSub]);
+			if(vertexNum == GEOMETRY_TEMP_BUFFER_UNUSED)
+			{
+				// record where we put this sample's vertex/texcoord for later reference
+				vertexNum = output.vertCount++;
+				output.tempBuffer[cornerSub] = vertexNum;
+				// and then add the vertex where we said we would
+				short *vertex = output.vertices + vertexNum * 3;
+				vertex[0] = output.originX + column;
+				vertex[1] = output.originY + line;
+				vertex[2] = output.depthBuffer[cornerSub];
+				float *texCoord = output.texCoords + vertexNum * 2;
+				texCoord[0] = (float)(output.originX + column) * output.invWidth; // inverse multiply
+				texCoord[1] = (float)(output.originY + line) * output.invHeight; // inverse multiply
+			} // if
+			// add a reference to where the vertex is already stored
+			output.indices[output.indexSub++] = vertexNum;
+		} // addCorner
 
-				// UR
-				if(_indicesTempBuffer[loopSubPlusOneColumn] == _tempBufferUnusedValue)
+		// adds the triangles of one line of classified cells. With SHARED, leaves the corners marked in shared to stitch().
+		template <bool SHARED>
+		void fillLine(Output &output, const int &line, const unsigned char *shared) const
+		{
+			const int width(_width), stride(_stride);
+			const unsigned char *cells(_cells);
+			for(int column = 0, loopSub = line * stride; column < width - 1; ++column, ++loopSub)
+			{
+				const unsigned int cell(cells[loopSub]);
+				if(!cell)
+					continue;
+				const unsigned int loopSubPlusOneColumn(loopSub + 1), loopSubPlusOneRow(loopSub + stride), loopSubPlusOneRowColumn(loopSub + stride + 1);
+				const bool sharedUL(SHARED && shared[column]), sharedUR(SHARED && shared[column + 1]);
+				if(cell & Geometry::CELL_UL_LL_LR)
+				{
+					addCorner(output, loopSub, column, line, sharedUL);
+					addCorner(output, loopSubPlusOneRow, column, line + 1, false);
+					addCorner(output, loopSubPlusOneRowColumn, column + 1, line + 1, false);
+				} // if
+				if(cell & Geometry::CELL_UL_LR_UR)
+				{
+					addCorner(output, loopSub, column, line, sharedUL);
+					addCorner(output, loopSubPlusOneRowColumn, column + 1, line + 1, false);
+					addCorner(output, loopSubPlusOneColumn, column + 1, line, sharedUR);
+				} // if
+				if(cell & Geometry::CELL_UL_LL_UR)
 				{
-					// record where we put this sample's vertex/texcoord for later reference
-					_indicesTempBuffer[loopSubPlusOneColumn] = vertCount++;
-					// and then add the vertex where we said we would
-					_vertices[vertSub++] = column + 1;
-					_vertices[vertSub++] = line;
-					_vertices[vertSub++] = depthUR;
-					_texcoord[texSub++] = columnPlusOneTC; // X
-					_texcoord[texSub++] = lineTC; // Y
+					addCorner(output, loopSub, column, line, sharedUL);
+					addCorner(output, loopSubPlusOneRow, column, line + 1, false);
+					addCorner(output, loopSubPlusOneColumn, column + 1, line, sharedUR);
 				} // if
-				// add a reference to where the vertex is already stored
-				_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneColumn];
+				if(cell & Geometry::CELL_LL_UR_LR)
+				{
+					addCorner(output, loopSubPlusOneRow, column, line + 1, false);
+					addCorner(output, loopSubPlusOneColumn, column + 1, line, sharedUR);
+					addCorner(output, loopSubPlusOneRowColumn, column + 1, line + 1, false);
+				} // if
+			} // for
+		} // fillLine
 
-				// LR
-				if(_indicesTempBuffer[loopSubPlusOneRowColumn] == _tempBufferUnusedValue)
+		void fill(Band &band)
+		{
+			Output output;
+			output.vertices = _geometry._vertices;
+			output.texCoords = _geometry._texcoord;
+			output.indices = _geometry._indices;
+			output.tempBuffer = _tempBuffer;
+			output.depthBuffer = _depthBuffer;
+			output.originX = _originX;
+			output.originY = _originY;
+			output.invWidth = _invWidth;
+			output.invHeight = _invHeight;
+			output.vertCount = band.firstVertex;
+			output.indexSub = band.firstTriangle * 3;
+			for(int line = band.beginLine; line < band.endLine; ++line)
+			{
+				if(!_counted)
 				{
-					// record where we put this sample's vertex/texcoord for later reference
-					_indicesTempBuffer[loopSubPlusOneRowColumn] = vertCount++;
-					// and then add the vertex where we said we would
-					_vertices[vertSub++] = column + 1;
-					_vertices[vertSub++] = line + 1;
-					_vertices[vertSub++] = depthLR;
-					_texcoord[texSub++] = columnPlusOneTC; // X
-					_texcoord[texSub++] = linePlusOneTC; // Y
+					// a lone band classifies as it goes, a line at a time so the loop that follows has registers to spare
+					classifyLine(line);
 				} // if
-				// add a reference to where the vertex is already stored
-				_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneRowColumn];
+				if(line == band.beginLine && band.beginLine > 0)
+					fillLine<true>(output, line, &band.shared[0]);
+				else
+					fillLine<false>(output, line, 0);
+			} // for
+			band.numVertices = output.vertCount - band.firstVertex;
+			band.numTriangles = output.indexSub / 3 - band.firstTriangle;
+		} // fill
+
+		Geometry &_geometry;
+		const livescene::ImageView &_imageZ;
+		bool _simple;
+		Pass _pass;
+		bool _counted;
+		int _width, _stride, _originX, _originY;
+		float _invWidth, _invHeight;
+		const short *_depthBuffer;
+		unsigned int *_tempBuffer; // addressed like _depthBuffer
+		unsigned char *_cells; // addressed like _depthBuffer, by each cell's UL sample
+		std::vector<Band> _bands;
+}; // FaceBands
 
-				polyCount++;
-			} // else
-		} // for
-	} // for lines
 
-	_numVertices  = vertCount; // this is number of three-element vertices, not number of elements in the vertices array
-	_numIndices   = indexSub;
-	_numTexCoords = vertCount; // this is number of two-element texcoords, not number of elements in the texcoord array
+bool Geometry::buildFaces(const livescene::Image &imageZ, const livescene::Image * const imageRGB)
+{
+	return(buildFaces(imageZ.getView(), imageRGB));
+} // buildFaces
 
-	return(true);
+
+bool Geometry::buildFaces(const livescene::ImageView &imageZ, const livescene::Image * const imageRGB)
+{
+	return(buildFacesBanded(imageZ, false));
 } // buildFaces
 
 
 bool Geometry::buildFacesSimple(const livescene::Image &imageZ, const livescene::Image * const imageRGB)
 {
-	// define our "unused" value, since 0 is a valid value
-	const unsigned int _tempBufferUnusedValue = std::numeric_limits<unsigned int>::max();
+	return(buildFacesSimple(imageZ.getView(), imageRGB));
+} // buildFacesSimple
+
+
+bool Geometry::buildFacesSimple(const livescene::ImageView &imageZ, const livescene::Image * const imageRGB)
+{
+	return(buildFacesBanded(imageZ, true));
+} // buildFacesSimple
+
+
+bool Geometry::buildFacesBanded(const livescene::ImageView &imageZ, const bool &simple)
+{
 	_entityType = GEOMETRY_FACES;
-	_width = imageZ.getWidth();
-	_height = imageZ.getHeight();
+	_width = imageZ.getParentWidth();
+	_height = imageZ.getParentHeight();
 
 	// we have to allocate for worst-case, all vertices/indices used
-	// but after the null processing loop below we'll reset these to
+	// but after the meshing passes below we'll reset these to
 	// indicate the number actually used.
 	// the resource tracking knows how many really need to be freed, so this is ok
 
 	int width(imageZ.getWidth()), height(imageZ.getHeight());
-	const float invWidth(1.0f/ width), invHeight(1.0f / height);
 
 	// because each sample can be in up to 4 triangle polygons
 	const int vertsPerTri(3), maxTrisPerCell(2), totalSamples(width * height);
@@ -428,155 +504,36 @@ bool Geometry::buildFacesSimple(const livescene::Image &imageZ, const livescene:
 	allocData(_numVertices, _numIndices, _numTexCoords, _numNormals);
 	allocTempBuffer(); // will only allocate if not already allocated. Must be done after allocData
 	// we need to clear the array each time through, even if it's already allocated
-	clearTempBuffer(_tempBufferUnusedValue); // clear to "unused" value
-
+	clearTempBuffer(GEOMETRY_TEMP_BUFFER_UNUSED, imageZ); // clear to "unused" value
 
-	short *depthBuffer = (short *)imageZ.getData();
+	if(width < 2 || height < 2)
+	{
+		_numVertices = _numIndices = _numTexCoords = 0;
+		return(true);
+	} // if
 
-	// loop logic taken from libfreenect glpclview, DrawGLScene()
-	// This meshing algorithm is simpler because it only splits
-	// four-point cells into two three-point triangle with the split running UL-LR.
-	unsigned int loopSub(0), vertSub(0), vertCount(0), indexSub(0), texSub(0), normSub(0), polyCount(0);
-	for(int line = 0; line < height - 1; ++line) // NOTE: height - 1
+	// loop logic taken from libfreenect glpclview, DrawGLScene(), see classifyCell()
+	const unsigned int numBands(std::min(getDefaultNumThreads(), std::max((height - 1) / GEOMETRY_LINES_PER_BAND_MIN, 1U)));
+	FaceBands bands(*this, imageZ, simple, numBands);
+	if(numBands > 1)
 	{
-		const float lineTC = (float)line * invHeight; // inverse multiply
-		const float linePlusOneTC = (float)(line + 1) * invHeight; // inverse multiply
-		for(int column = 0; column < width - 1; ++column) // NOTE: width - 1
-		{
-			const unsigned int loopSub = line * width + column;
-			const unsigned int loopSubPlusOneColumn = line * width + column + 1;
-			const unsigned int loopSubPlusOneRow = (line + 1)* width + column;
-			const unsigned int loopSubPlusOneRowColumn = (line + 1)* width + column + 1;
-
-			const float columnTC = (float)column * invWidth; // inverse multiply
-			const float columnPlusOneTC = (float)(column + 1) * invWidth; // inverse multiply
-			// pre-read these four since we'll need them repeatedly
-			short depthUL = depthBuffer[loopSub];
-			short depthUR = depthBuffer[loopSubPlusOneColumn];
-			short depthLL = depthBuffer[loopSubPlusOneRow];
-			short depthLR = depthBuffer[loopSubPlusOneRowColumn];
-			// is top-left sample of mesh cell (at loop subscripts) non-rejected?
-			if(imageZ.isCellValueValid(depthUL))
-			{
-				// is LR vertex valid, allowing for potentially both polygons split UL<->LR?
-				if(imageZ.isCellValueValid(depthLR))
-				{ // try to form two triangles, UL, LL, LR and UL, LR, UR
-					// is LL valid, allowing UL, LL, LR?
-					if(imageZ.isCellValueValid(depthLL)
-						&& isTriRangeMeshable(depthUL, depthLL, depthLR))
-					{
-						// form UL, LL, LR triangle
-						// UL
-						if(_indicesTempBuffer[loopSub] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSub] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column;
-							_vertices[vertSub++] = line;
-							_vertices[vertSub++] = depthUL;
-							_texcoord[texSub++] = columnTC; // X
-							_texcoord[texSub++] = lineTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSub];
-
-						// LL
-						if(_indicesTempBuffer[loopSubPlusOneRow] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSubPlusOneRow] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column;
-							_vertices[vertSub++] = line + 1;
-							_vertices[vertSub++] = depthLL;
-							_texcoord[texSub++] = columnTC; // X
-							_texcoord[texSub++] = linePlusOneTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneRow];
-
-						// LR
-						if(_indicesTempBuffer[loopSubPlusOneRowColumn] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSubPlusOneRowColumn] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column + 1;
-							_vertices[vertSub++] = line + 1;
-							_vertices[vertSub++] = depthLR;
-							_texcoord[texSub++] = columnPlusOneTC; // X
-							_texcoord[texSub++] = linePlusOneTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneRowColumn];
-
-						polyCount++;
-					} // if
-
-					// is UR valid, allowing UL, LR, UR?
-					if(imageZ.isCellValueValid(depthUR)
-						&& isTriRangeMeshable(depthUL, depthLR, depthUR))
-					{
-						// form UL, LR, UR triangle
-						// UL
-						if(_indicesTempBuffer[loopSub] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSub] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column;
-							_vertices[vertSub++] = line;
-							_vertices[vertSub++] = depthUL;
-							_texcoord[texSub++] = columnTC; // X
-							_texcoord[texSub++] = lineTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSub];
-
-						// LR
-						if(_indicesTempBuffer[loopSubPlusOneRowColumn] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSubPlusOneRowColumn] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column + 1;
-							_vertices[vertSub++] = line + 1;
-							_vertices[vertSub++] = depthLR;
-							_texcoord[texSub++] = columnPlusOneTC; // X
-							_texcoord[texSub++] = linePlusOneTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneRowColumn];
-
-						// UR
-						if(_indicesTempBuffer[loopSubPlusOneColumn] == _tempBufferUnusedValue)
-						{
-							// record where we put this sample's vertex/texcoord for later reference
-							_indicesTempBuffer[loopSubPlusOneColumn] = vertCount++;
-							// and then add the vertex where we said we would
-							_vertices[vertSub++] = column + 1;
-							_vertices[vertSub++] = line;
-							_vertices[vertSub++] = depthUR;
-							_texcoord[texSub++] = columnPlusOneTC; // X
-							_texcoord[texSub++] = lineTC; // Y
-						} // if
-						// add a reference to where the vertex is already stored
-						_indices[indexSub++] = _indicesTempBuffer[loopSubPlusOneColumn];
-
-						polyCount++;
-					} // if
-				} // if
-			} // if
-		} // for
-	} // for lines
+		// a single band needs no counts, it starts at the beginning of the output
+		bands.setPass(FaceBands::COUNT);
+		runBandsParallel(bands, numBands, numBands, 1);
+		bands.assignOutput();
+	} // if
+	bands.setPass(FaceBands::FILL);
+	runBandsParallel(bands, numBands, numBands, 1);
+	bands.stitch();
 
+	unsigned int vertCount(0), polyCount(0);
+	bands.getTotals(vertCount, polyCount);
 	_numVertices  = vertCount; // this is number of three-element vertices, not number of elements in the vertices array
-	_numIndices   = indexSub;
+	_numIndices   = polyCount * vertsPerTri;
 	_numTexCoords = vertCount; // this is number of two-element texcoords, not number of elements in the texcoord array
 
 	return(true);
-} // buildFacesSimple
+} // buildFacesBanded
 
 
 // namespace livescene
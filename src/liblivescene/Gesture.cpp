@@ -0,0 +1,314 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#include "liblivescene/Gesture.h"
+#include "liblivescene/Parallel.h"
+#include <cmath> // sqrt, sin, cos
+#include <cfloat> // FLT_MAX
+#include <algorithm> // std::fill
+
+namespace livescene {
+
+// templates per band when updating them in parallel, a template step costs only a few operations
+const unsigned int GESTURE_TEMPLATES_PER_BAND(64);
+const float GESTURE_TWO_PI(6.28318531f);
+// motion within about 45 degrees of the direction a match ended in continues it
+const float GESTURE_CONTINUE_COST(0.3f);
+
+
+void GestureTemplate::addStep(const float &X, const float &Y, const float &Z)
+{
+	const float length(sqrt(X * X + Y * Y + Z * Z));
+	steps.push_back(length > 0.0f ? X / length : 0.0f);
+	steps.push_back(length > 0.0f ? Y / length : 0.0f);
+	steps.push_back(length > 0.0f ? Z / length : 0.0f);
+} // GestureTemplate::addStep
+
+
+GestureTemplate GestureTemplate::swipe(const std::string &name, const unsigned int &id, const float &X, const float &Y, const float &Z,
+	const unsigned int &frames, const float &minExtent)
+{
+	GestureTemplate gesture;
+	gesture.name = name;
+	gesture.id = id;
+	gesture.tolerance = 0.06f;
+	gesture.minExtent = minExtent;
+	for(unsigned int frame = 0; frame < frames; ++frame)
+	{
+		gesture.addStep(X, Y, Z);
+	} // for
+	return(gesture);
+} // GestureTemplate::swipe
+
+
+GestureTemplate GestureTemplate::circle(const std::string &name, const unsigned int &id, const bool &clockwise, const float &startAngle,
+	const unsigned int &frames, const float &minExtent)
+{
+	GestureTemplate gesture;
+	gesture.name = name;
+	gesture.id = id;
+	gesture.tolerance = 0.25f;
+	gesture.minExtent = minExtent;
+	for(unsigned int frame = 0; frame < frames; ++frame)
+	{
+		// tangent halfway through each frame's arc
+		const float turned(GESTURE_TWO_PI * (frame + 0.5f) / frames);
+		const float angle(clockwise ? startAngle + turned : startAngle - turned);
+		if(clockwise)
+		{
+			gesture.addStep(-sin(angle), cos(angle), 0.0f);
+		} // if
+		else
+		{
+			gesture.addStep(sin(angle), -cos(angle), 0.0f);
+		} // else
+	} // for
+	return(gesture);
+} // GestureTemplate::circle
+
+
+GestureTemplate GestureTemplate::pushPull(const std::string &name, const unsigned int &id, const unsigned int &frames, const float &minExtent)
+{
+	GestureTemplate gesture;
+	gesture.name = name;
+	gesture.id = id;
+	gesture.tolerance = 0.15f;
+	gesture.minExtent = minExtent;
+	for(unsigned int frame = 0; frame < frames; ++frame)
+	{
+		gesture.addStep(0.0f, 0.0f, frame < frames / 2 ? -1.0f : 1.0f);
+	} // for
+	return(gesture);
+} // GestureTemplate::pushPull
+
+
+/** \brief Runs GestureRecognizer::updateTemplate() on a band of templates. */
+class GestureBands : public livescene::BandCallback
+{
+	public:
+		GestureBands(GestureRecognizer &recognizer) : _recognizer(recognizer) {}
+		virtual void operator ()(const unsigned int &begin, const unsigned int &end)
+		{
+			for(unsigned int templateNum = begin; templateNum < end; ++templateNum)
+			{
+				_recognizer.updateTemplate(_recognizer._templates[templateNum]);
+			} // for
+		} // operator ()
+	private:
+		GestureRecognizer &_recognizer;
+}; // GestureBands
+
+
+GestureRecognizer::GestureRecognizer()
+	: _minStep(2.0f)
+{
+	_scale[0] = _scale[1] = _scale[2] = 1.0f;
+	reset();
+} // GestureRecognizer::GestureRecognizer
+
+
+unsigned int GestureRecognizer::addTemplate(const livescene::GestureTemplate &gestureTemplate)
+{
+	_templates.push_back(TemplateState());
+	TemplateState &state = _templates.back();
+	state.gesture = gestureTemplate;
+	resetTemplate(state);
+	return(_templates.size() - 1);
+} // GestureRecognizer::addTemplate
+
+
+void GestureRecognizer::clearTemplates(void)
+{
+	_templates.clear();
+	_matches.clear();
+	_lastMatchEnd.clear();
+} // GestureRecognizer::clearTemplates
+
+
+void GestureRecognizer::reset(void)
+{
+	_havePosition = false;
+	_lastPosition[0] = _lastPosition[1] = _lastPosition[2] = 0.0f;
+	_direction[0] = _direction[1] = _direction[2] = 0.0f;
+	_extent = _stepLength = 0.0f;
+	_frame = 0;
+	_matches.clear();
+	_lastMatchEnd.clear();
+	for(std::vector<TemplateState>::iterator stateIt = _templates.begin(); stateIt != _templates.end(); ++stateIt)
+	{
+		resetTemplate(*stateIt);
+	} // for
+} // GestureRecognizer::reset
+
+
+void GestureRecognizer::resetTemplate(TemplateState &state) const
+{
+	const unsigned int length(state.gesture.getLength());
+	for(unsigned int column = 0; column < 2; ++column)
+	{
+		state.distance[column].assign(length + 1, FLT_MAX);
+		state.startExtent[column].assign(length + 1, 0.0f);
+		state.start[column].assign(length + 1, 0);
+	} // for
+	state.column = 0;
+	state.haveCandidate = state.haveMatch = state.continuing = false;
+} // GestureRecognizer::resetTemplate
+
+
+unsigned int GestureRecognizer::update(const float *position)
+{
+	_matches.clear();
+	const float scaled[3] = {position[0] * _scale[0], position[1] * _scale[1], position[2] * _scale[2]};
+	if(!_havePosition)
+	{
+		// motion starts with the second position
+		_lastPosition[0] = scaled[0]; _lastPosition[1] = scaled[1]; _lastPosition[2] = scaled[2];
+		_havePosition = true;
+		_frame = 1;
+		return(0);
+	} // if
+
+	const float step[3] = {scaled[0] - _lastPosition[0], scaled[1] - _lastPosition[1], scaled[2] - _lastPosition[2]};
+	_lastPosition[0] = scaled[0]; _lastPosition[1] = scaled[1]; _lastPosition[2] = scaled[2];
+	_stepLength = sqrt(step[0] * step[0] + step[1] * step[1] + step[2] * step[2]);
+	_extent += _stepLength;
+	for(unsigned int axis = 0; axis < 3; ++axis)
+	{
+		_direction[axis] = _stepLength >= _minStep && _stepLength > 0.0f ? step[axis] / _stepLength : 0.0f;
+	} // for
+	++_frame;
+
+	GestureBands bands(*this);
+	runBandsParallel(bands, _templates.size(), 0, GESTURE_TEMPLATES_PER_BAND);
+
+	// in template order, once per id and stretch of motion
+	for(unsigned int templateNum = 0; templateNum < _templates.size(); ++templateNum)
+	{
+		if(!_templates[templateNum].haveMatch)
+		{
+			continue;
+		} // if
+		const livescene::GestureMatch &match = _templates[templateNum].match;
+		std::map<unsigned int, unsigned int>::iterator lastEnd = _lastMatchEnd.find(match.id);
+		if(lastEnd != _lastMatchEnd.end() && match.startFrame <= lastEnd->second)
+		{
+			continue;
+		} // if
+		_lastMatchEnd[match.id] = match.endFrame;
+		_matches.push_back(match);
+		_matches.back().templateNum = templateNum;
+	} // for
+	return(_matches.size());
+} // GestureRecognizer::update
+
+
+void GestureRecognizer::updateTemplate(TemplateState &state) const
+{
+	const unsigned int length(state.gesture.getLength());
+	state.haveMatch = false;
+	if(length == 0)
+	{
+		return;
+	} // if
+	const float *previousDistance = &state.distance[state.column][0], *previousExtent = &state.startExtent[state.column][0];
+	const unsigned int *previousStart = &state.start[state.column][0];
+	float *distance = &state.distance[1 - state.column][0], *startExtent = &state.startExtent[1 - state.column][0];
+	unsigned int *start = &state.start[1 - state.column][0];
+	const float *steps = &state.gesture.steps[0];
+	const bool still(_direction[0] == 0.0f && _direction[1] == 0.0f && _direction[2] == 0.0f);
+	// positions are numbered from 0, this frame's motion is from position _frame - 2 to _frame - 1
+	const unsigned int frameStart(_frame - 2), frameEnd(_frame - 1);
+
+	// step 0 is where a match may begin, at this frame
+	distance[0] = 0.0f;
+	start[0] = frameStart;
+	startExtent[0] = _extent - _stepLength;
+	for(unsigned int stepNum = 1; stepNum <= length; ++stepNum)
+	{
+		// repeat this step, advance one, or skip one. Coming from step 0 means beginning at this frame.
+		float best(FLT_MAX);
+		unsigned int from(0);
+		for(unsigned int back = 0; back <= 2 && back <= stepNum; ++back)
+		{
+			const float predecessor(stepNum == back ? 0.0f : previousDistance[stepNum - back]);
+			if(predecessor < best)
+			{
+				best = predecessor;
+				from = stepNum - back;
+			} // if
+		} // for
+		if(best == FLT_MAX)
+		{
+			distance[stepNum] = FLT_MAX;
+			continue;
+		} // if
+		const float *templateStep = &steps[(stepNum - 1) * 3];
+		const float cost(still ? 1.0f : 1.0f - (_direction[0] * templateStep[0] + _direction[1] * templateStep[1] + _direction[2] * templateStep[2]));
+		distance[stepNum] = best + cost;
+		if(from == 0)
+		{
+			start[stepNum] = frameStart;
+			startExtent[stepNum] = _extent - _stepLength;
+		} // if
+		else
+		{
+			start[stepNum] = previousStart[from];
+			startExtent[stepNum] = previousExtent[from];
+		} // else
+	} // for
+
+	// report the candidate once no partial match overlapping it could still beat it
+	if(state.haveCandidate)
+	{
+		bool improvable(false);
+		for(unsigned int stepNum = 1; stepNum <= length && !improvable; ++stepNum)
+		{
+			improvable = distance[stepNum] < state.candidate.distance && start[stepNum] <= state.candidate.endFrame;
+		} // for
+		if(!improvable)
+		{
+			state.match = state.candidate;
+			state.haveMatch = true;
+			state.haveCandidate = false;
+			for(unsigned int stepNum = 1; stepNum <= length; ++stepNum)
+			{
+				if(start[stepNum] <= state.candidate.endFrame)
+				{
+					distance[stepNum] = FLT_MAX;
+				} // if
+			} // for
+		} // if
+	} // if
+
+	// motion carrying on the way the last match ended is part of it, so nothing new may begin until it turns or stops
+	state.continuing = state.continuing || state.haveMatch;
+	if(state.continuing)
+	{
+		const float *lastStep = &steps[(length - 1) * 3];
+		if(!still && 1.0f - (_direction[0] * lastStep[0] + _direction[1] * lastStep[1] + _direction[2] * lastStep[2]) <= GESTURE_CONTINUE_COST)
+		{
+			std::fill(distance + 1, distance + length + 1, FLT_MAX);
+		} // if
+		else
+		{
+			state.continuing = false;
+		} // else
+	} // if
+
+	// a complete match good enough, and better than the one waiting
+	if(distance[length] <= state.gesture.tolerance * (frameEnd - start[length]) && _extent - startExtent[length] >= state.gesture.minExtent
+		&& (!state.haveCandidate || distance[length] < state.candidate.distance))
+	{
+		state.candidate.id = state.gesture.id;
+		state.candidate.startFrame = start[length];
+		state.candidate.endFrame = frameEnd;
+		state.candidate.distance = distance[length];
+		state.candidate.extent = _extent - startExtent[length];
+		state.haveCandidate = true;
+	} // if
+
+	state.column = 1 - state.column;
+} // GestureRecognizer::updateTemplate
+
+
+// namespace livescene
+}
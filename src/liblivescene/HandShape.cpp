@@ -0,0 +1,408 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#include "liblivescene/HandShape.h"
+#include "liblivescene/Detect.h"
+#include <algorithm> // std::min/max/sort/fill
+#include <cstdlib> // abs
+#include <cmath> // sqrt, cos
+
+namespace livescene {
+
+const float HandShape::_none[3] = {0.0f, 0.0f, 0.0f};
+
+// neighbors clockwise on screen (Y down), starting west
+static const int contourStepX[8] = {-1, -1, 0, 1, 1, 1, 0, -1}, contourStepY[8] = {0, -1, -1, -1, 0, 1, 1, 1};
+
+// fingertips closer together than this fraction of the hand radius are one fingertip
+const float HANDSHAPE_FINGERTIP_MERGE(0.3f);
+// a defect end nearer the hand centroid than this many hand radii is part of the palm, not a fingertip
+const float HANDSHAPE_FINGERTIP_MIN_DISTANCE(1.0f);
+
+
+/** \brief Orders contour indices by X, then Y, for the monotone chain. */
+class ContourPointLess
+{
+	public:
+		ContourPointLess(const std::vector<livescene::ContourPoint> &contour) : _contour(contour) {}
+		bool operator ()(const unsigned int &left, const unsigned int &right) const
+		{
+			return(_contour[left].x < _contour[right].x || (_contour[left].x == _contour[right].x && _contour[left].y < _contour[right].y));
+		} // operator ()
+	private:
+		const std::vector<livescene::ContourPoint> &_contour;
+}; // ContourPointLess
+
+
+// z of the cross product of (a - origin) and (b - origin)
+static int cross(const livescene::ContourPoint &origin, const livescene::ContourPoint &a, const livescene::ContourPoint &b)
+{
+	return((a.x - origin.x) * (b.y - origin.y) - (a.y - origin.y) * (b.x - origin.x));
+} // cross
+
+
+HandShape::HandShape(const unsigned int windowHalfSize, const unsigned short depthTolerance)
+	: _windowHalfSize(windowHalfSize), _depthTolerance(depthTolerance), _minDefectDepth(0.4f),
+	_pointingDistance(1.6f), _openFingertips(3), _minSamples(100),
+	_state(UNKNOWN), _solidity(0.0f), _handRadius(0.0f),
+	_windowX(0), _windowY(0), _windowWidth(0), _windowHeight(0)
+{
+	_handCentroid[0] = _handCentroid[1] = 0.0f;
+	setMaxDefectAngle(90.0f);
+} // HandShape::HandShape
+
+
+void HandShape::setMaxDefectAngle(const float maxDefectAngle)
+{
+	_maxDefectAngle = maxDefectAngle;
+	_maxDefectCos = cos(maxDefectAngle * 3.14159265f / 180.0f);
+} // HandShape::setMaxDefectAngle
+
+
+HandShape::State HandShape::analyze(const livescene::Image &foreZ, const livescene::BodyMass &bodies, const unsigned int &bodyNum, const unsigned int &handNum)
+{
+	if(handNum >= bodies.getNumHands(bodyNum))
+	{
+		_state = UNKNOWN;
+		_fingertips.clear();
+		_contour.clear();
+		_hull.clear();
+		_defects.clear();
+		return(_state);
+	} // if
+	return(analyze(foreZ, bodies.getHandCentroid(bodyNum, handNum)));
+} // HandShape::analyze
+
+
+HandShape::State HandShape::analyze(const livescene::Image &foreZ, const float *handCentroid)
+{
+	_state = UNKNOWN;
+	_solidity = _handRadius = 0.0f;
+	_fingertips.clear();
+	_contour.clear();
+	_hull.clear();
+	_defects.clear();
+
+	const unsigned int handSamples(extractHand(foreZ, handCentroid));
+	if(handSamples < std::max(_minSamples, 1U))
+	{
+		return(_state);
+	} // if
+	_handRadius = sqrt(handSamples / 3.14159265f);
+
+	traceContour();
+	buildHull();
+
+	// twice the shoelace areas, through sample centers, so a convex hand comes out at 1
+	int contourArea(0), hullArea(0);
+	for(unsigned int index = 0, previous = _contour.size() - 1; index < _contour.size(); previous = index++)
+	{
+		contourArea += _contour[previous].x * _contour[index].y - _contour[index].x * _contour[previous].y;
+	} // for
+	for(unsigned int index = 0, previous = _hull.size() - 1; index < _hull.size(); previous = index++)
+	{
+		hullArea += _contour[_hull[previous]].x * _contour[_hull[index]].y - _contour[_hull[index]].x * _contour[_hull[previous]].y;
+	} // for
+	_solidity = hullArea != 0 ? std::min((float)abs(contourArea) / abs(hullArea), 1.0f) : 1.0f;
+
+	findDefects();
+	findFingertips(foreZ);
+
+	if(getNumFingertips() >= _openFingertips)
+	{
+		_state = OPEN;
+	} // if
+	else if(getNumFingertips() == 0)
+	{
+		_state = CLOSED;
+	} // else if
+	return(_state);
+} // HandShape::analyze
+
+
+unsigned int HandShape::extractHand(const livescene::Image &foreZ, const float *handCentroid)
+{
+	const int centerX((int)(handCentroid[0] + 0.5f)), centerY((int)(handCentroid[1] + 0.5f)), centerZ((int)(handCentroid[2] + 0.5f));
+	_windowX = std::max(centerX - (int)_windowHalfSize, 0);
+	_windowY = std::max(centerY - (int)_windowHalfSize, 0);
+	_windowWidth = std::min(centerX + (int)_windowHalfSize + 1, (int)foreZ.getWidth()) - _windowX;
+	_windowHeight = std::min(centerY + (int)_windowHalfSize + 1, (int)foreZ.getHeight()) - _windowY;
+	if(!foreZ.getData() || _windowWidth <= 0 || _windowHeight <= 0)
+	{
+		_windowWidth = _windowHeight = 0;
+		return(0);
+	} // if
+
+	// candidates are in the depth band, and the nearest one to the centroid seeds the hand
+	const unsigned short *depthBuffer = (const unsigned short *)foreZ.getData();
+	const int nullValue(foreZ.getNull());
+	_mask.resize(_windowWidth * _windowHeight);
+	int seed(-1), seedDistanceSquared(0);
+	for(int line = 0; line < _windowHeight; ++line)
+	{
+		const unsigned short *depthRow = &depthBuffer[(_windowY + line) * foreZ.getWidth() + _windowX];
+		unsigned char *maskRow = &_mask[line * _windowWidth];
+		for(int column = 0; column < _windowWidth; ++column)
+		{
+			if(depthRow[column] != nullValue && abs((int)depthRow[column] - centerZ) <= (int)_depthTolerance)
+			{
+				maskRow[column] = CANDIDATE;
+				const int deltaX(_windowX + column - centerX), deltaY(_windowY + line - centerY);
+				if(seed < 0 || deltaX * deltaX + deltaY * deltaY < seedDistanceSquared)
+				{
+					seed = line * _windowWidth + column;
+					seedDistanceSquared = deltaX * deltaX + deltaY * deltaY;
+				} // if
+			} // if
+			else
+			{
+				maskRow[column] = OUTSIDE;
+			} // else
+		} // for
+	} // for
+	if(seed < 0)
+	{
+		return(0);
+	} // if
+
+	// 8-connected fill from the seed, so other things in the depth band stay out
+	unsigned int handSamples(0);
+	float sumX(0.0f), sumY(0.0f);
+	_stack.clear();
+	_stack.push_back(seed);
+	_mask[seed] = HAND_SAMPLE;
+	while(!_stack.empty())
+	{
+		const unsigned int index(_stack.back());
+		_stack.pop_back();
+		const int column(index % _windowWidth), line(index / _windowWidth);
+		++handSamples;
+		sumX += column;
+		sumY += line;
+		for(unsigned int neighbor = 0; neighbor < 8; ++neighbor)
+		{
+			const int neighborColumn(column + contourStepX[neighbor]), neighborLine(line + contourStepY[neighbor]);
+			if(neighborColumn >= 0 && neighborColumn < _windowWidth && neighborLine >= 0 && neighborLine < _windowHeight
+				&& _mask[neighborLine * _windowWidth + neighborColumn] == CANDIDATE)
+			{
+				_mask[neighborLine * _windowWidth + neighborColumn] = HAND_SAMPLE;
+				_stack.push_back(neighborLine * _windowWidth + neighborColumn);
+			} // if
+		} // for
+	} // while
+	_handCentroid[0] = _windowX + sumX / handSamples;
+	_handCentroid[1] = _windowY + sumY / handSamples;
+	return(handSamples);
+} // HandShape::extractHand
+
+
+void HandShape::traceContour(void)
+{
+	// the first hand sample in raster order is on the outer contour, with nothing to its west or above
+	int startColumn(0), startLine(0);
+	for(unsigned int index = 0; index < _mask.size(); ++index)
+	{
+		if(_mask[index] == HAND_SAMPLE)
+		{
+			startColumn = index % _windowWidth;
+			startLine = index / _windowWidth;
+			break;
+		} // if
+	} // for
+
+	// Moore neighborhood tracing, stopping on re-entering the start the way it was first left (Jacob's criterion)
+	int column(startColumn), line(startLine);
+	unsigned int searchFrom(0), firstStep(8);
+	_contour.push_back(livescene::ContourPoint(_windowX + column, _windowY + line));
+	const unsigned int maxLength(_mask.size() * 4); // a safety net, a contour visits each sample at most four times
+	while(_contour.size() < maxLength)
+	{
+		unsigned int step(8);
+		for(unsigned int turn = 0; turn < 8; ++turn)
+		{
+			const unsigned int direction((searchFrom + turn) % 8);
+			if(isHand(column + contourStepX[direction], line + contourStepY[direction]))
+			{
+				step = direction;
+				break;
+			} // if
+		} // for
+		if(step == 8)
+		{
+			break; // a lone sample
+		} // if
+		if(column == startColumn && line == startLine)
+		{
+			if(firstStep == 8)
+			{
+				firstStep = step;
+			} // if
+			else if(step == firstStep)
+			{
+				_contour.pop_back(); // the start, reached again
+				break;
+			} // else if
+		} // if
+		column += contourStepX[step];
+		line += contourStepY[step];
+		_contour.push_back(livescene::ContourPoint(_windowX + column, _windowY + line));
+		// resume the sweep at the last outside neighbor checked, as seen from the new point
+		searchFrom = (step + ((step & 1) ? 5 : 6)) % 8;
+	} // while
+} // HandShape::traceContour
+
+
+void HandShape::buildHull(void)
+{
+	std::vector<unsigned int> sorted(_contour.size());
+	for(unsigned int index = 0; index < sorted.size(); ++index)
+	{
+		sorted[index] = index;
+	} // for
+	if(sorted.size() < 3)
+	{
+		_hull = sorted;
+		return;
+	} // if
+	std::sort(sorted.begin(), sorted.end(), ContourPointLess(_contour));
+
+	// Andrew's monotone chain, lower then upper, dropping collinear points
+	_hull.resize(sorted.size() * 2);
+	unsigned int hullSize(0);
+	for(unsigned int index = 0; index < sorted.size(); ++index)
+	{
+		while(hullSize >= 2 && cross(_contour[_hull[hullSize - 2]], _contour[_hull[hullSize - 1]], _contour[sorted[index]]) <= 0)
+		{
+			--hullSize;
+		} // while
+		_hull[hullSize++] = sorted[index];
+	} // for
+	for(int index = sorted.size() - 2, lowerSize = hullSize + 1; index >= 0; --index)
+	{
+		while((int)hullSize >= lowerSize && cross(_contour[_hull[hullSize - 2]], _contour[_hull[hullSize - 1]], _contour[sorted[index]]) <= 0)
+		{
+			--hullSize;
+		} // while
+		_hull[hullSize++] = sorted[index];
+	} // for
+	_hull.resize(hullSize - 1); // the last point repeats the first
+
+	// a simple outline meets its hull vertices in hull order, so contour order is hull order
+	std::sort(_hull.begin(), _hull.end());
+} // HandShape::buildHull
+
+
+void HandShape::findDefects(void)
+{
+	if(_hull.size() < 3)
+	{
+		return;
+	} // if
+	const float minDepth(_minDefectDepth * _handRadius);
+	for(unsigned int hullNum = 0; hullNum < _hull.size(); ++hullNum)
+	{
+		const unsigned int start(_hull[hullNum]), end(_hull[(hullNum + 1) % _hull.size()]);
+		const livescene::ContourPoint &startPoint = _contour[start], &endPoint = _contour[end];
+		const float edgeLength(sqrt((float)((endPoint.x - startPoint.x) * (endPoint.x - startPoint.x) + (endPoint.y - startPoint.y) * (endPoint.y - startPoint.y))));
+		if(edgeLength == 0.0f)
+		{
+			continue;
+		} // if
+
+		// deepest contour point between the two hull vertices, wrapping past the end of the contour
+		ConvexityDefect defect;
+		defect.start = start;
+		defect.end = end;
+		int deepestCross(0);
+		for(unsigned int index = (start + 1) % _contour.size(); index != end; index = (index + 1) % _contour.size())
+		{
+			const int depthCross(abs(cross(startPoint, endPoint, _contour[index])));
+			if(depthCross > deepestCross)
+			{
+				deepestCross = depthCross;
+				defect.deepest = index;
+			} // if
+		} // for
+		defect.depth = deepestCross / edgeLength;
+		if(defect.depth < minDepth)
+		{
+			continue;
+		} // if
+
+		// fingers either side of a gap meet at a sharp angle
+		const livescene::ContourPoint &deepestPoint = _contour[defect.deepest];
+		const float toStartX(startPoint.x - deepestPoint.x), toStartY(startPoint.y - deepestPoint.y),
+			toEndX(endPoint.x - deepestPoint.x), toEndY(endPoint.y - deepestPoint.y);
+		const float lengths(sqrt((toStartX * toStartX + toStartY * toStartY) * (toEndX * toEndX + toEndY * toEndY)));
+		if(lengths > 0.0f && (toStartX * toEndX + toStartY * toEndY) / lengths >= _maxDefectCos)
+		{
+			_defects.push_back(defect);
+		} // if
+	} // for
+} // HandShape::findDefects
+
+
+bool HandShape::onWindowEdge(const livescene::ContourPoint &point) const
+{
+	return(point.x == _windowX || point.y == _windowY || point.x == _windowX + _windowWidth - 1 || point.y == _windowY + _windowHeight - 1);
+} // HandShape::onWindowEdge
+
+
+void HandShape::findFingertips(const livescene::Image &foreZ)
+{
+	const float mergeDistanceSquared(HANDSHAPE_FINGERTIP_MERGE * HANDSHAPE_FINGERTIP_MERGE * _handRadius * _handRadius),
+		minDistanceSquared(HANDSHAPE_FINGERTIP_MIN_DISTANCE * HANDSHAPE_FINGERTIP_MIN_DISTANCE * _handRadius * _handRadius);
+	const unsigned short *depthBuffer = (const unsigned short *)foreZ.getData();
+
+	// both ends of every finger gap, once each
+	std::vector<unsigned int> candidates;
+	for(std::vector<livescene::ConvexityDefect>::const_iterator defectIt = _defects.begin(); defectIt != _defects.end(); ++defectIt)
+	{
+		candidates.push_back(defectIt->start);
+		candidates.push_back(defectIt->end);
+	} // for
+
+	// or else one finger reaching out alone
+	if(candidates.empty())
+	{
+		const float pointingDistanceSquared(_pointingDistance * _pointingDistance * _handRadius * _handRadius);
+		float farthestDistanceSquared(0.0f);
+		for(unsigned int index = 0; index < _contour.size(); ++index)
+		{
+			const float deltaX(_contour[index].x - _handCentroid[0]), deltaY(_contour[index].y - _handCentroid[1]);
+			if(!onWindowEdge(_contour[index]) && deltaX * deltaX + deltaY * deltaY > farthestDistanceSquared)
+			{
+				farthestDistanceSquared = deltaX * deltaX + deltaY * deltaY;
+				if(farthestDistanceSquared >= pointingDistanceSquared)
+				{
+					candidates.assign(1, index);
+				} // if
+			} // if
+		} // for
+	} // if
+
+	for(std::vector<unsigned int>::const_iterator candidateIt = candidates.begin(); candidateIt != candidates.end(); ++candidateIt)
+	{
+		const livescene::ContourPoint &point = _contour[*candidateIt];
+		const float deltaX(point.x - _handCentroid[0]), deltaY(point.y - _handCentroid[1]);
+		if(onWindowEdge(point) || deltaX * deltaX + deltaY * deltaY < minDistanceSquared)
+		{
+			continue;
+		} // if
+		bool merged(false);
+		for(unsigned int fingertip = 0; fingertip < _fingertips.size() && !merged; fingertip += 3)
+		{
+			const float apartX(point.x - _fingertips[fingertip]), apartY(point.y - _fingertips[fingertip + 1]);
+			merged = apartX * apartX + apartY * apartY < mergeDistanceSquared;
+		} // for
+		if(!merged)
+		{
+			_fingertips.push_back(point.x);
+			_fingertips.push_back(point.y);
+			_fingertips.push_back(depthBuffer[point.y * foreZ.getWidth() + point.x]);
+		} // if
+	} // for
+} // HandShape::findFingertips
+
+
+// namespace livescene
+}
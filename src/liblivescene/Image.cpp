@@ -1,6 +1,8 @@
 // Copyright 2011 Skew Matrix Software and AlphaPixel
 
 #include "liblivescene/Image.h"
+#include "liblivescene/Parallel.h"
+#include "liblivescene/SIMD.h"
 #include <stdlib.h> // malloc/free
 #include <malloc.h> // malloc/free
 #include <memory.h> // memcpy
@@ -14,8 +16,15 @@ namespace livescene {
 void ImageStatistics::addSample(double sample)
 {
 	_samples ++;
-	_min = std::min(_min, sample);
-	_max = std::max(_max, sample);
+	if(_samples == 1)
+	{ // first sample defines the range, otherwise the cleared 0.0 would stick as min (or max)
+		_min = _max = sample;
+	} // if
+	else
+	{
+		_min = std::min(_min, sample);
+		_max = std::max(_max, sample);
+	} // else
 
 	// stddev refer to http://www.johndcook.com/standard_deviation.html
     // See Knuth TAOCP vol 2, 3rd edition, page 232
@@ -35,6 +44,23 @@ void ImageStatistics::addSample(double sample)
     }
 } // ImageStatistics::addSample
 
+void ImageStatistics::setFromSums(const unsigned long int numSamples, const double sum, const double sumSquares, const double min, const double max)
+{
+	clear();
+	if(numSamples == 0)
+	{
+		return;
+	} // if
+	_samples = numSamples;
+	_mean = sum / numSamples;
+	_min = min;
+	_max = max;
+	// sum of squared deviations from the mean, which is what addSample() accumulates
+	m_newS = std::max(sumSquares - sum * _mean, 0.0);
+	m_oldM = _mean;
+	m_oldS = m_newS;
+} // ImageStatistics::setFromSums
+
 Image::Image(const Image &image, bool cloneData)
 : _data(0), _dataSelfAllocated(false), _nullValue(0)
 {
@@ -43,6 +69,7 @@ Image::Image(const Image &image, bool cloneData)
 	_depth = image._depth;
 	_format = image._format;
 	_timestamp = image._timestamp;
+	_generation = image._generation;
 	_nullValue = image._nullValue;
 
 	_xStatValid = image._xStatValid;
@@ -82,6 +109,7 @@ Image & Image::operator= (const Image & rhs)
 	_depth = rhs._depth;
 	_format = rhs._format;
 	_timestamp = rhs._timestamp;
+	_generation = rhs._generation;
 	_nullValue = rhs._nullValue;
 
 	_xStatValid = rhs._xStatValid;
@@ -109,33 +137,8 @@ return *this;
 
 void Image::rewriteZeroToNull(void)
 {
-	if(!(_format == DEPTH_10BIT || _format == DEPTH_11BIT))
-	{
-		return;
-	} // if
-
-	int width(getWidth()), height(getHeight());
-	short *depthBuffer = (short *)getData();
-
-	unsigned int startLine(1), endLine(height); // initial loop range
-	unsigned int startCol(1), endCol(width); // initial loop range
-
-	unsigned int lineSub(0);
-	// vertically scan 
-	for(unsigned int line = startLine; line < endLine; ++line)
-	{
-		lineSub = line * width;
-		// horizontally scan
-		for(unsigned int column = startCol; column < endCol; ++column)
-		{
-			// rewrite any zero values to NULL for easier single-test identification later
-			if(depthBuffer[lineSub + column] == 0)
-			{
-				depthBuffer[lineSub + column] = _nullValue; // null it out
-			} // if
-		} // for
-	} // for lines
-
+	getView().rewriteZeroToNull();
+	increaseGeneration();
 } // Image::rewriteZeroToNull
 
 
@@ -143,7 +146,7 @@ void Image::rewriteZeroToNull(void)
 unsigned int Image::patchNulls(const unsigned int &numPasses)
 {
 	unsigned int numPatched(0);
-	if(!(_format == DEPTH_10BIT || _format == DEPTH_11BIT))
+	if(!isDepthFormat(_format))
 	{
 		return(false);
 	} // if
@@ -220,75 +223,17 @@ unsigned int Image::patchNulls(const unsigned int &numPasses)
 
 unsigned int Image::filterNoise(const unsigned int &numNeighbors)
 {
-	unsigned int numFiltered(0);
-	if(!(_format == DEPTH_10BIT || _format == DEPTH_11BIT))
+	const unsigned int numFiltered = getView().filterNoise(numNeighbors);
+	if(numFiltered)
 	{
-		return(false);
+		increaseGeneration();
 	} // if
-
-	int width(getWidth()), height(getHeight());
-	short *depthBuffer = (short *)getData();
-
-	unsigned int startLine(1), endLine(height); // initial loop range
-	unsigned int startCol(1), endCol(width); // initial loop range
-
-	unsigned int lineSub(0);
-	// vertically scan 
-	for(unsigned int line = startLine; line < endLine; ++line)
-	{
-		lineSub = line * width;
-		// horizontally scan
-		for(unsigned int column = startCol; column < endCol; ++column)
-		{
-			// valid samples are assumed to be in the minority, so trigger on
-			// them, rather than on invalid samples
-			if(isCellValueValid(depthBuffer[lineSub + column]))
-			{
-				// does it have fewer valid neighbors than the threshold?
-				if(countValidNeighbors(column, line) < numNeighbors)
-				{
-					depthBuffer[lineSub + column] = _nullValue; // null it out
-					++numFiltered;
-				} // if
-			} // if
-		} // for
-	} // for lines
-
 	return(numFiltered);
 } // Image::filterNoise
 
 unsigned int Image::countValidNeighbors(const unsigned int &X, const unsigned int &Y) const
 {
-	unsigned int validNeighbors(0);
-	unsigned int width = getWidth();
-	short *depthBuffer = (short *)getData();
-
-	if(Y > 0)
-	{
-		// UL
-		if(X > 0 && isCellValueValid(depthBuffer[(Y - 1) * width + (X - 1)])) ++validNeighbors;
-		// UC
-		if(isCellValueValid(depthBuffer[(Y - 1) * width + (X)])) ++validNeighbors;
-		// UR
-		if(X < width && isCellValueValid(depthBuffer[(Y - 1) * width + (X + 1)])) ++validNeighbors;
-	} // if
-
-	// ML
-	if(X > 0 && isCellValueValid(depthBuffer[(Y) * width + (X - 1)])) ++validNeighbors;
-	// MR
-	if(X < width && isCellValueValid(depthBuffer[(Y) * width + (X + 1)])) ++validNeighbors;
-
-	if(Y < getHeight())
-	{
-		// LL
-		if(X > 0 && isCellValueValid(depthBuffer[(Y + 1) * width + (X - 1)])) ++validNeighbors;
-		// LC
-		if(isCellValueValid(depthBuffer[(Y + 1) * width + (X)])) ++validNeighbors;
-		// LR
-		if(X < width && isCellValueValid(depthBuffer[(Y + 1) * width + (X + 1)])) ++validNeighbors;
-	} // if
-
-	return(validNeighbors);
+	return(getView().countValidNeighbors(X, Y));
 } // Image::countValidNeighbors
 
 
@@ -309,32 +254,31 @@ bool Image::minimumDeltaToNeighbors(const unsigned int &X, const unsigned int &Y
 		// UC
 		if(isCellValueValid(depthValue = depthBuffer[(Y - 1) * width + (X)])) {++validNeighbors; absDelta = abs(depthValue - cellValue); if(absDelta < result) result = absDelta; }
 		// UR
-		if(X < width && isCellValueValid(depthValue = depthBuffer[(Y - 1) * width + (X + 1)])) {++validNeighbors; absDelta = abs(depthValue - cellValue); if(absDelta < result) result = absDelta; }
+		if(X + 1 < width && isCellValueValid(depthValue = depthBuffer[(Y - 1) * width + (X + 1)])) {++validNeighbors; absDelta = abs(depthValue - cellValue); if(absDelta < result) result = absDelta; }
 	} // if
 	// ML
 	if(X > 0 && isCellValueValid(depthValue = depthBuffer[(Y) * width + (X - 1)])) {++validNeighbors; absDelta = abs(depthValue - cellValue); if(absDelta < result) result = absDelta; }
 	// MR
-	if(X < width && isCellValueValid(depthValue = depthBuffer[(Y) * width + (X + 1)])) {++validNeighbors; absDelta = abs(depthValue - cellValue); if(absDelta < result) result = absDelta; }
-	if(Y < getHeight())
+	if(X + 1 < width && isCellValueValid(depthValue = depthBuffer[(Y) * width + (X + 1)])) {++validNeighbors; absDelta = abs(depthValue - cellValue); if(absDelta < result) result = absDelta; }
+	if(Y + 1 < getHeight())
 	{
 		// LL
 		if(X > 0 && isCellValueValid(depthValue = depthBuffer[(Y + 1) * width + (X - 1)])) {++validNeighbors; absDelta = abs(depthValue - cellValue); if(absDelta < result) result = absDelta; }
 		// LC
 		if(isCellValueValid(depthValue = depthBuffer[(Y + 1) * width + (X)])) {++validNeighbors; absDelta = abs(depthValue - cellValue); if(absDelta < result) result = absDelta; }
 		// LR
-		if(X < width && isCellValueValid(depthValue = depthBuffer[(Y + 1) * width + (X + 1)])) {++validNeighbors; absDelta = abs(depthValue - cellValue); if(absDelta < result) result = absDelta; }
+		if(X + 1 < width && isCellValueValid(depthValue = depthBuffer[(Y + 1) * width + (X + 1)])) {++validNeighbors; absDelta = abs(depthValue - cellValue); if(absDelta < result) result = absDelta; }
 	} // if
 
 	if(validNeighbors > 0)
-	{
-		result = absDelta;
+	{ // result already holds the minimum
 		return(true);
 	} // if
 	else
 	{
 		return(false);
 	} // else
-} // 
+} // Image::minimumDeltaToNeighbors
 
 
 bool Image::calcStatsXYZ(livescene::ImageStatistics *destStatsX, livescene::ImageStatistics *destStatsY, livescene::ImageStatistics *destStatsZ, ApproveCallback *approveCallback)
@@ -348,35 +292,7 @@ bool Image::calcStatsXYZBounded(const unsigned int &Xlow, const unsigned int &Yl
 								livescene::ImageStatistics *destStatsX, livescene::ImageStatistics *destStatsY, livescene::ImageStatistics *destStatsZ,
 								ApproveCallback *approveCallback)
 {
-	if(!(_format == DEPTH_10BIT || _format == DEPTH_11BIT))
-	{
-		return(false);
-	} // if
-
-	if(destStatsX) destStatsX->clear();
-	if(destStatsY) destStatsY->clear();
-	if(destStatsZ) destStatsZ->clear();
-
-	unsigned int width(getWidth()), height(getHeight());
-	short *depthBuffer = (short *)getData();
-
-	unsigned int lineSub(0);
-	for(unsigned int line = Ylow; line < Yhigh; ++line)
-	{
-		lineSub = line * width;
-		for(unsigned int column = Xlow; column < Xhigh; ++column)
-		{
-			short originalDepth = depthBuffer[lineSub + column];
-			if(isCellValueValid(originalDepth) && (!approveCallback || (*approveCallback)(column, line, originalDepth)))
-			{
-				if(destStatsX) destStatsX->addSample(column);
-				if(destStatsY) destStatsY->addSample(line);
-				if(destStatsZ) destStatsZ->addSample(originalDepth);
-			} // if
-		} // for
-	} // for lines
-
-return(true);
+	return(ImageView::fromBounds(*this, Xlow, Ylow, Xhigh, Yhigh).calcStatsXYZ(destStatsX, destStatsY, destStatsZ, approveCallback));
 } // Image::calcStatsXYZBounded
 
 
@@ -398,35 +314,7 @@ bool Image::calcInternalStatsXYZ(ApproveCallback *approveCallback)
 bool Image::calcHistogram(const unsigned int &Xlow, const unsigned int &Ylow, const unsigned int &Xhigh, const unsigned int &Yhigh,
 						  std::vector<unsigned long> &destHistogram )
 {
-	if(_format == DEPTH_10BIT)
-	{
-		destHistogram.resize(1024, 0); // pre-size 0,1023
-	} // if
-	else if(_format == DEPTH_11BIT)
-	{
-		destHistogram.resize(2048, 0); // pre-size 0,2048
-	} // if
-	else
-	{
-		return(false);
-	} // else
-
-	unsigned int width(getWidth()), height(getHeight());
-	short *depthBuffer = (short *)getData();
-
-	unsigned int lineSub(0);
-	for(unsigned int line = Ylow; line < Yhigh; ++line)
-	{
-		lineSub = line * width;
-		for(unsigned int column = Xlow; column < Xhigh; ++column)
-		{
-			short originalDepth = depthBuffer[lineSub + column];
-			destHistogram[std::max((short)0, originalDepth)]++; // don't subscript below 0
-		} // for
-	} // for lines
-
-	return(true);
-
+	return(ImageView::fromBounds(*this, Xlow, Ylow, Xhigh, Yhigh).calcHistogram(destHistogram));
 } // Image::calcHistogram
 
 
@@ -446,6 +334,16 @@ bool Image::preAllocate(void)
 	return(false); // failed
 } // Image::preAllocate
 
+ImageView Image::getView(void) const
+{
+	return(ImageView(*this));
+} // Image::getView
+
+ImageView Image::getView(const unsigned int &Xlow, const unsigned int &Ylow, const unsigned int &viewWidth, const unsigned int &viewHeight) const
+{
+	return(ImageView(*this, Xlow, Ylow, viewWidth, viewHeight));
+} // Image::getView
+
 void Image::allocData(void)
 {
 	freeData();
@@ -470,5 +368,313 @@ void Image::freeData(void)
 } // // Image::freeData
 
 
+
+
+ImageView::ImageView(const Image &image)
+: _data((unsigned short *)image.getData()), _originX(0), _originY(0), _width(image.getWidth()), _height(image.getHeight()),
+_stride(image.getWidth()), _parentWidth(image.getWidth()), _parentHeight(image.getHeight()),
+_nullValue(image.getNull()), _format(image.getFormat())
+{
+	if(!_data)
+	{
+		_width = _height = 0;
+	} // if
+} // ImageView::ImageView
+
+ImageView::ImageView(const Image &image, const unsigned int &Xlow, const unsigned int &Ylow, const unsigned int &viewWidth, const unsigned int &viewHeight)
+{
+	*this = ImageView(ImageView(image), Xlow, Ylow, viewWidth, viewHeight);
+} // ImageView::ImageView
+
+ImageView::ImageView(const ImageView &view, const unsigned int &Xlow, const unsigned int &Ylow, const unsigned int &viewWidth, const unsigned int &viewHeight)
+: _data(view._data), _originX(view._originX), _originY(view._originY), _width(0), _height(0),
+_stride(view._stride), _parentWidth(view._parentWidth), _parentHeight(view._parentHeight),
+_nullValue(view._nullValue), _format(view._format)
+{
+	// clamp the requested region to the view we're carving it from
+	const unsigned int XlowClamped(std::min(Xlow, view._width)), YlowClamped(std::min(Ylow, view._height));
+	_width = std::min(viewWidth, view._width - XlowClamped);
+	_height = std::min(viewHeight, view._height - YlowClamped);
+	_originX += XlowClamped;
+	_originY += YlowClamped;
+	if(_data)
+	{
+		_data += YlowClamped * _stride + XlowClamped;
+	} // if
+} // ImageView::ImageView
+
+ImageView ImageView::fromBounds(const Image &image, const unsigned int &Xlow, const unsigned int &Ylow, const unsigned int &Xhigh, const unsigned int &Yhigh)
+{
+	return(ImageView(image, Xlow, Ylow, (Xhigh > Xlow) ? Xhigh - Xlow : 0, (Yhigh > Ylow) ? Yhigh - Ylow : 0));
+} // ImageView::fromBounds
+
+
+void ImageView::rewriteZeroToNull(void) const
+{
+	if(!isZ() || isEmpty())
+	{
+		return;
+	} // if
+
+	const unsigned short nullValue = (unsigned short)_nullValue;
+	for(unsigned int line = 0; line < _height; ++line)
+	{
+		unsigned short *depthRow = getRow(line);
+		for(unsigned int column = 0; column < _width; ++column)
+		{
+			// rewrite any zero values to NULL for easier single-test identification later
+			if(depthRow[column] == 0)
+			{
+				depthRow[column] = nullValue; // null it out
+			} // if
+		} // for
+	} // for lines
+} // ImageView::rewriteZeroToNull
+
+
+unsigned int ImageView::filterNoise(const unsigned int &numNeighbors) const
+{
+	unsigned int numFiltered(0);
+	if(!isZ() || isEmpty())
+	{
+		return(0);
+	} // if
+
+	const unsigned short nullValue = (unsigned short)_nullValue;
+	for(unsigned int line = 0; line < _height; ++line)
+	{
+		unsigned short *depthRow = getRow(line);
+		for(unsigned int column = 0; column < _width; ++column)
+		{
+			// valid samples are assumed to be in the minority, so trigger on
+			// them, rather than on invalid samples
+			if(isCellValueValid(depthRow[column]))
+			{
+				// does it have fewer valid neighbors than the threshold?
+				if(countValidNeighbors(column, line) < numNeighbors)
+				{
+					depthRow[column] = nullValue; // null it out
+					++numFiltered;
+				} // if
+			} // if
+		} // for
+	} // for lines
+
+	return(numFiltered);
+} // ImageView::filterNoise
+
+unsigned int ImageView::countValidNeighbors(const unsigned int &X, const unsigned int &Y) const
+{
+	unsigned int validNeighbors(0);
+	// clamp the 3x3 neighborhood to the view
+	const unsigned int lineLow(Y > 0 ? Y - 1 : 0), lineHigh(std::min(Y + 1, _height - 1));
+	const unsigned int columnLow(X > 0 ? X - 1 : 0), columnHigh(std::min(X + 1, _width - 1));
+
+	for(unsigned int line = lineLow; line <= lineHigh; ++line)
+	{
+		const unsigned short *depthRow = getRow(line);
+		for(unsigned int column = columnLow; column <= columnHigh; ++column)
+		{
+			if((line != Y || column != X) && isCellValueValid(depthRow[column])) ++validNeighbors;
+		} // for
+	} // for
+
+	return(validNeighbors);
+} // ImageView::countValidNeighbors
+
+
+bool ImageView::calcStatsXYZ(livescene::ImageStatistics *destStatsX, livescene::ImageStatistics *destStatsY, livescene::ImageStatistics *destStatsZ,
+							 ApproveCallback *approveCallback) const
+{
+	if(!isZ())
+	{
+		return(false);
+	} // if
+
+	if(destStatsX) destStatsX->clear();
+	if(destStatsY) destStatsY->clear();
+	if(destStatsZ) destStatsZ->clear();
+
+	for(unsigned int line = 0; line < _height; ++line)
+	{
+		const unsigned short *depthRow = getRow(line);
+		const unsigned int parentLine = _originY + line; // stats are reported in parent image space
+		for(unsigned int column = 0; column < _width; ++column)
+		{
+			const unsigned short originalDepth = depthRow[column];
+			const unsigned int parentColumn = _originX + column;
+			if(isCellValueValid(originalDepth) && (!approveCallback || (*approveCallback)(parentColumn, parentLine, originalDepth)))
+			{
+				if(destStatsX) destStatsX->addSample(parentColumn);
+				if(destStatsY) destStatsY->addSample(parentLine);
+				if(destStatsZ) destStatsZ->addSample(originalDepth);
+			} // if
+		} // for
+	} // for lines
+
+	return(true);
+} // ImageView::calcStatsXYZ
+
+
+bool ImageView::calcHistogram(std::vector<unsigned long> &destHistogram) const
+{
+	if(_format == DEPTH_10BIT)
+	{
+		destHistogram.resize(1024, 0); // pre-size 0,1023
+	} // if
+	else if(_format == DEPTH_11BIT)
+	{
+		destHistogram.resize(2048, 0); // pre-size 0,2048
+	} // if
+	else if(_format == DEPTH_MM_16)
+	{
+		destHistogram.resize(10000, 0); // pre-size 0,9999mm, beyond the sensor's range, so farther samples pile up in the last bin
+	} // if
+	else
+	{
+		return(false);
+	} // else
+
+	const unsigned short maxBin = (unsigned short)(destHistogram.size() - 1);
+	for(unsigned int line = 0; line < _height; ++line)
+	{
+		const unsigned short *depthRow = getRow(line);
+		for(unsigned int column = 0; column < _width; ++column)
+		{
+			destHistogram[std::min(depthRow[column], maxBin)]++; // don't subscript past the end
+		} // for
+	} // for lines
+
+	return(true);
+} // ImageView::calcHistogram
+
+
+// smallest sample of a line that is valid and no greater than zThreshold, or 0xffff if there's none
+static unsigned short minZRow(const unsigned short *depthRow, const unsigned int &width, const unsigned short &nullValue, const unsigned short &zThreshold)
+{
+	unsigned short rowMin(0xffff);
+	unsigned int column(0);
+#ifdef LIVESCENE_SSE2
+	if(width >= 8)
+	{
+		const __m128i zero = _mm_setzero_si128(), allOnes = _mm_set1_epi16(-1);
+		const __m128i nullV = _mm_set1_epi16((short)nullValue), thresholdV = _mm_set1_epi16((short)zThreshold);
+		__m128i minV = allOnes;
+		for(; column + 8 <= width; column += 8)
+		{
+			const __m128i depth = _mm_loadu_si128((const __m128i *)(depthRow + column));
+			// NULL and beyond the threshold become 0xffff so they never win
+			const __m128i rejected = _mm_or_si128(_mm_cmpeq_epi16(depth, nullV),
+				_mm_xor_si128(_mm_cmpeq_epi16(_mm_subs_epu16(depth, thresholdV), zero), allOnes));
+			const __m128i candidate = _mm_or_si128(depth, rejected);
+			minV = _mm_subs_epu16(minV, _mm_subs_epu16(minV, candidate)); // unsigned min, which SSE2 lacks
+		} // for
+		// fold the eight lanes down to one
+		minV = _mm_subs_epu16(minV, _mm_subs_epu16(minV, _mm_srli_si128(minV, 8)));
+		minV = _mm_subs_epu16(minV, _mm_subs_epu16(minV, _mm_srli_si128(minV, 4)));
+		minV = _mm_subs_epu16(minV, _mm_subs_epu16(minV, _mm_srli_si128(minV, 2)));
+		rowMin = (unsigned short)_mm_cvtsi128_si32(minV);
+	} // if
+#endif // LIVESCENE_SSE2
+
+	for(; column < width; ++column)
+	{
+		const unsigned short depth(depthRow[column]);
+		if(depth < rowMin && depth <= zThreshold && depth != nullValue)
+		{
+			rowMin = depth;
+		} // if
+	} // for
+	return(rowMin);
+} // minZRow
+
+
+/** \brief Reduces a band of lines of a view to their minima for ImageView::findMinZ(). */
+class MinZRows : public livescene::BandCallback
+{
+	public:
+		MinZRows(const livescene::ImageView &view, const unsigned short &zThreshold, unsigned short *rowMins)
+			: _view(view), _zThreshold(zThreshold), _rowMins(rowMins) {}
+		virtual void operator ()(const unsigned int &begin, const unsigned int &end)
+		{
+			const unsigned short nullValue = (unsigned short)_view.getNull();
+			for(unsigned int line = begin; line < end; ++line)
+			{
+				_rowMins[line] = minZRow(_view.getRow(line), _view.getWidth(), nullValue, _zThreshold);
+			} // for
+		} // operator ()
+	private:
+		const livescene::ImageView &_view;
+		unsigned short _zThreshold;
+		unsigned short *_rowMins;
+}; // MinZRows
+
+
+bool ImageView::findMinZ(const unsigned short &zThreshold, unsigned int &minX, unsigned int &minY, unsigned short &minZ,
+						 ApproveCallback *approveCallback, const unsigned int numThreads, std::vector<unsigned short> *rowMins) const
+{
+	if(!isZ() || isEmpty())
+	{
+		return(false);
+	} // if
+
+	// lane-wise minimum of every line. A band has to be big enough to be worth a thread.
+	std::vector<unsigned short> localRowMins;
+	std::vector<unsigned short> &lineMins = rowMins ? *rowMins : localRowMins;
+	lineMins.resize(_height);
+	MinZRows minZRows(*this, zThreshold, &lineMins.front());
+	runBandsParallel(minZRows, _height, numThreads, std::max(131072U / std::max(_width, 1U), 16U));
+
+	// position recovery: only lines that could beat the best so far are looked at again
+	const unsigned short nullValue = (unsigned short)_nullValue;
+	unsigned short best(0xffff);
+	bool found(false);
+	for(unsigned int line = 0; line < _height; ++line)
+	{
+		if(lineMins[line] >= best)
+		{
+			continue;
+		} // if
+		const unsigned short *depthRow = getRow(line);
+		const unsigned int parentLine = _originY + line;
+		bool recovered(false);
+		for(unsigned int column = 0; column < _width; ++column)
+		{
+			if(depthRow[column] == lineMins[line] && (!approveCallback || (*approveCallback)(_originX + column, parentLine, depthRow[column])))
+			{
+				best = lineMins[line];
+				minX = _originX + column;
+				recovered = true;
+				break;
+			} // if
+		} // for
+		if(!recovered)
+		{ // every sample at the line's minimum was rejected, so look for the nearest approved one the slow way
+			for(unsigned int column = 0; column < _width; ++column)
+			{
+				const unsigned short depth(depthRow[column]);
+				if(depth < best && depth <= zThreshold && depth != nullValue && (*approveCallback)(_originX + column, parentLine, depth))
+				{
+					best = depth;
+					minX = _originX + column;
+					recovered = true;
+				} // if
+			} // for
+		} // if
+		if(recovered)
+		{
+			minY = parentLine;
+			found = true;
+		} // if
+	} // for lines
+
+	if(found)
+	{
+		minZ = best;
+	} // if
+	return(found);
+} // ImageView::findMinZ
+
+
 // namespace livescene
 }
@@ -0,0 +1,222 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#include "liblivescene/ImagePyramid.h"
+#include <algorithm> // std::min/max/swap
+#include <cassert>
+
+namespace livescene {
+
+ImagePyramid::ImagePyramid(ReduceMode mode, unsigned int numLevels)
+: _mode(mode), _numLevels(numLevels), _numLevelsBuilt(0), _numLevelsAllocated(0),
+_source(0), _sourceData(0), _sourceGeneration(0), _sourceTimestamp(0), _sourceWidth(0), _sourceHeight(0), _sourceFormat(DEPTH_11BIT)
+{
+} // ImagePyramid::ImagePyramid
+
+ImagePyramid::~ImagePyramid()
+{
+	freeLevels();
+} // ImagePyramid::~ImagePyramid
+
+
+void ImagePyramid::freeLevels(void)
+{
+	for(std::vector<livescene::Image *>::iterator levelIt = _levels.begin(); levelIt != _levels.end(); ++levelIt)
+	{
+		delete *levelIt;
+	} // for
+	_levels.clear();
+} // ImagePyramid::freeLevels
+
+
+bool ImagePyramid::build(const livescene::Image &imageZ)
+{
+	if(!isDepthFormat(imageZ.getFormat()))
+	{
+		return(false);
+	} // if
+
+	// is this the same frame we already reduced?
+	if(_sourceData && _sourceData == imageZ.getData() && _sourceGeneration == imageZ.getGeneration() && _sourceTimestamp == imageZ.getTimestamp()
+		&& _sourceWidth == imageZ.getWidth() && _sourceHeight == imageZ.getHeight() && _sourceFormat == imageZ.getFormat())
+	{
+		_source = &imageZ; // same data, but the caller may have handed us a different Image wrapping it
+		return(true);
+	} // if
+
+	allocateLevels(imageZ);
+	_source = &imageZ;
+	const livescene::Image *previousLevel = &imageZ;
+	for(std::vector<livescene::Image *>::iterator levelIt = _levels.begin(); levelIt != _levels.end(); ++levelIt)
+	{
+		livescene::Image &currentLevel = **levelIt;
+		currentLevel.setNull(imageZ.getNull());
+		currentLevel.setTimestamp(imageZ.getTimestamp());
+		currentLevel.invalidateInternalStats();
+		reduceLevel(*previousLevel, currentLevel, 0, 0, currentLevel.getWidth(), currentLevel.getHeight());
+		previousLevel = &currentLevel;
+	} // for
+
+	// record cache key
+	_sourceData = imageZ.getData();
+	_sourceGeneration = imageZ.getGeneration();
+	_sourceTimestamp = imageZ.getTimestamp();
+	_numLevelsBuilt = _levels.size() + 1;
+
+	return(true);
+} // ImagePyramid::build
+
+bool ImagePyramid::build(const livescene::Image &imageZ, const livescene::ImageView &window)
+{
+	if(!isDepthFormat(imageZ.getFormat()) || window.isEmpty()
+		|| window.getParentWidth() != imageZ.getWidth() || window.getParentHeight() != imageZ.getHeight())
+	{
+		return(false);
+	} // if
+
+	allocateLevels(imageZ);
+	_source = &imageZ;
+	// the coarsest level's part is the samples overlapping the window, and every finer level's part is all the
+	// samples under that, so each sample built comes out as it would from the whole frame
+	const unsigned int coarsest(_levels.size());
+	const unsigned int coarseMinX(window.getOriginX() >> coarsest), coarseMinY(window.getOriginY() >> coarsest);
+	const unsigned int coarseEndX(((window.getOriginX() + window.getWidth() - 1) >> coarsest) + 1);
+	const unsigned int coarseEndY(((window.getOriginY() + window.getHeight() - 1) >> coarsest) + 1);
+	const livescene::Image *previousLevel = &imageZ;
+	for(unsigned int level = 1; level <= coarsest; ++level)
+	{
+		livescene::Image &currentLevel = *_levels[level - 1];
+		currentLevel.setNull(imageZ.getNull());
+		currentLevel.setTimestamp(imageZ.getTimestamp());
+		currentLevel.invalidateInternalStats();
+		const unsigned int shift(coarsest - level);
+		reduceLevel(*previousLevel, currentLevel, coarseMinX << shift, coarseMinY << shift,
+			std::min(coarseEndX << shift, currentLevel.getWidth()), std::min(coarseEndY << shift, currentLevel.getHeight()));
+		previousLevel = &currentLevel;
+	} // for
+
+	_sourceData = 0; // only partly built, so no cache hit for build()
+	_numLevelsBuilt = _levels.size() + 1;
+
+	return(true);
+} // ImagePyramid::build
+
+
+// (re)allocates level buffers if the source geometry changed. Once sized, they are reused every frame.
+void ImagePyramid::allocateLevels(const livescene::Image &imageZ)
+{
+	if(_sourceWidth == imageZ.getWidth() && _sourceHeight == imageZ.getHeight() && _sourceFormat == imageZ.getFormat() && _numLevelsAllocated == _numLevels)
+	{
+		return;
+	} // if
+	freeLevels();
+	unsigned int levelWidth(imageZ.getWidth()), levelHeight(imageZ.getHeight());
+	for(unsigned int level = 0; level < _numLevels; ++level)
+	{
+		if(levelWidth < 2 && levelHeight < 2) break; // can't reduce any further
+		levelWidth = (levelWidth + 1) / 2; // round up so odd edges still get a sample
+		levelHeight = (levelHeight + 1) / 2;
+		livescene::Image *newLevel = new livescene::Image(levelWidth, levelHeight, imageZ.getDepth(), imageZ.getFormat());
+		newLevel->preAllocate();
+		_levels.push_back(newLevel);
+	} // for
+	_numLevelsAllocated = _numLevels;
+	_sourceWidth = imageZ.getWidth();
+	_sourceHeight = imageZ.getHeight();
+	_sourceFormat = imageZ.getFormat();
+} // ImagePyramid::allocateLevels
+
+
+const livescene::Image &ImagePyramid::getLevel(const unsigned int level) const
+{
+	assert(_source && level < _numLevelsBuilt);
+	if(level == 0 || _levels.empty())
+	{
+		return(*_source);
+	} // if
+	return(*_levels[std::min(level, (unsigned int)_levels.size()) - 1]);
+} // ImagePyramid::getLevel
+
+
+void ImagePyramid::reduceLevel(const livescene::Image &source, livescene::Image &dest,
+	const unsigned int &minX, const unsigned int &minY, const unsigned int &endX, const unsigned int &endY) const
+{
+	const unsigned short *sourceData = (const unsigned short *)source.getData();
+	unsigned short *destData = (unsigned short *)dest.getData();
+	const unsigned short sourceNull = (unsigned short)source.getNull();
+	const unsigned int sourceWidth(source.getWidth()), sourceHeight(source.getHeight());
+	const unsigned int destWidth(dest.getWidth());
+
+	for(unsigned int line = minY; line < endY; ++line)
+	{
+		const unsigned int sourceLine = line * 2;
+		// bottom edge of an odd-height source has no second line, reuse the first
+		const unsigned int sourceLineBelow = std::min(sourceLine + 1, sourceHeight - 1);
+		const unsigned short *sourceRow = sourceData + sourceLine * sourceWidth;
+		const unsigned short *sourceRowBelow = sourceData + sourceLineBelow * sourceWidth;
+		unsigned short *destRow = destData + line * destWidth;
+		for(unsigned int column = minX; column < endX; ++column)
+		{
+			const unsigned int sourceColumn = column * 2;
+			const unsigned int sourceColumnRight = std::min(sourceColumn + 1, sourceWidth - 1);
+			// gather the valid samples of this 2x2 block
+			// duplicated edge samples are only counted once so they don't bias the mean or median
+			unsigned short block[4];
+			unsigned int numValid(0);
+			if(sourceRow[sourceColumn] != sourceNull) block[numValid++] = sourceRow[sourceColumn];
+			if(sourceColumnRight != sourceColumn && sourceRow[sourceColumnRight] != sourceNull) block[numValid++] = sourceRow[sourceColumnRight];
+			if(sourceLineBelow != sourceLine)
+			{
+				if(sourceRowBelow[sourceColumn] != sourceNull) block[numValid++] = sourceRowBelow[sourceColumn];
+				if(sourceColumnRight != sourceColumn && sourceRowBelow[sourceColumnRight] != sourceNull) block[numValid++] = sourceRowBelow[sourceColumnRight];
+			} // if
+
+			if(numValid == 0)
+			{
+				destRow[column] = sourceNull;
+				continue;
+			} // if
+
+			switch(_mode)
+			{
+			case REDUCE_MIN:
+				{
+					unsigned short minZ = block[0];
+					for(unsigned int blockSub = 1; blockSub < numValid; ++blockSub) minZ = std::min(minZ, block[blockSub]);
+					destRow[column] = minZ;
+					break;
+				} // REDUCE_MIN
+			case REDUCE_MEDIAN:
+				{
+					// at most four values, so a tiny insertion sort beats anything clever
+					for(unsigned int outer = 1; outer < numValid; ++outer)
+					{
+						for(unsigned int inner = outer; inner > 0 && block[inner - 1] > block[inner]; --inner)
+						{
+							std::swap(block[inner - 1], block[inner]);
+						} // for
+					} // for
+					if(numValid & 1)
+					{ // odd count has a true middle
+						destRow[column] = block[numValid / 2];
+					} // if
+					else
+					{ // even count averages the middle pair
+						destRow[column] = (unsigned short)((block[numValid / 2 - 1] + block[numValid / 2] + 1) / 2);
+					} // else
+					break;
+				} // REDUCE_MEDIAN
+			case REDUCE_MEAN:
+				{
+					unsigned int sumZ(0);
+					for(unsigned int blockSub = 0; blockSub < numValid; ++blockSub) sumZ += block[blockSub];
+					destRow[column] = (unsigned short)((sumZ + numValid / 2) / numValid); // rounded, not truncated
+					break;
+				} // REDUCE_MEAN
+			} // mode
+		} // for column
+	} // for lines
+} // ImagePyramid::reduceLevel
+
+
+// namespace livescene
+}
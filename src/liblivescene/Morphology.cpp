@@ -0,0 +1,281 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#include "liblivescene/Morphology.h"
+#include "liblivescene/Parallel.h"
+#include <algorithm> // std::copy/fill
+#include <limits> // numeric_limits::max
+
+namespace livescene {
+
+// van Herk/Gil-Werman, one dimension:
+// pad the input by radius on each side with the operation's identity, and round the padded length
+// up to a multiple of the kernel size. forward[i] is the running min/max from the start of i's kernel-sized
+// block up to i, backward[i] is the running min/max from i to the end of its block. Any kernel-wide
+// window [x, x + kernel) spans at most two blocks, so its result is op(backward[x], forward[x + kernel - 1]).
+
+template <typename T>
+struct MinOp
+{
+	static inline T apply(const T a, const T b) {return(a < b ? a : b);}
+	static inline T identity(void) {return(std::numeric_limits<T>::max());}
+}; // MinOp
+
+template <typename T>
+struct MaxOp
+{
+	static inline T apply(const T a, const T b) {return(a > b ? a : b);}
+	static inline T identity(void) {return(0);}
+}; // MaxOp
+
+// masks go through unchanged
+template <typename T>
+struct PlainCodec
+{
+	inline T in(const T value) const {return(value);}
+	inline T out(const T value) const {return(value);}
+}; // PlainCodec
+
+// depth NULL becomes the farthest possible value while filtering, and back again after
+struct NullFarCodec
+{
+	NullFarCodec(const unsigned short nullValue) : _nullValue(nullValue) {}
+	enum {FAR_VALUE = 0xffff};
+	inline unsigned short in(const unsigned short value) const {return(value == _nullValue ? (unsigned short)FAR_VALUE : value);}
+	inline unsigned short out(const unsigned short value) const {return(value == FAR_VALUE ? _nullValue : value);}
+	unsigned short _nullValue;
+}; // NullFarCodec
+
+
+static inline unsigned int roundUpToMultiple(const unsigned int value, const unsigned int multiple)
+{
+	return((value + multiple - 1) / multiple * multiple);
+} // roundUpToMultiple
+
+
+/** \brief Row-wise vHGW pass, from the source image into a packed intermediate plane. Bands are lines. */
+template <typename T, class Op, class Codec>
+class HorizontalPass : public livescene::BandCallback
+{
+	public:
+		HorizontalPass(const T *source, const unsigned int &sourceStride, T *dest, const unsigned int &width, const unsigned int &radius, const Codec &codec)
+			: _source(source), _sourceStride(sourceStride), _dest(dest), _width(width), _radius(radius), _codec(codec) {}
+
+		virtual void operator ()(const unsigned int &begin, const unsigned int &end)
+		{
+			const unsigned int kernel = 2 * _radius + 1;
+			const unsigned int paddedLength = roundUpToMultiple(_width + 2 * _radius, kernel);
+			// per-band scratch, a few hundred bytes
+			std::vector<T> padded(paddedLength, Op::identity()), forward(paddedLength), backward(paddedLength);
+
+			for(unsigned int line = begin; line < end; ++line)
+			{
+				const T *sourceRow = _source + line * _sourceStride;
+				T *destRow = _dest + line * _width;
+				if(_radius == 0)
+				{
+					for(unsigned int column = 0; column < _width; ++column) destRow[column] = _codec.in(sourceRow[column]);
+					continue;
+				} // if
+
+				// only the middle is rewritten, the identity padding on both ends stays put
+				for(unsigned int column = 0; column < _width; ++column)
+				{
+					padded[_radius + column] = _codec.in(sourceRow[column]);
+				} // for
+				for(unsigned int blockStart = 0; blockStart < paddedLength; blockStart += kernel)
+				{
+					forward[blockStart] = padded[blockStart];
+					for(unsigned int index = blockStart + 1; index < blockStart + kernel; ++index)
+					{
+						forward[index] = Op::apply(forward[index - 1], padded[index]);
+					} // for
+					const unsigned int blockLast = blockStart + kernel - 1;
+					backward[blockLast] = padded[blockLast];
+					for(unsigned int index = blockLast; index > blockStart; --index)
+					{
+						backward[index - 1] = Op::apply(backward[index], padded[index - 1]);
+					} // for
+				} // for blocks
+				for(unsigned int column = 0; column < _width; ++column)
+				{
+					destRow[column] = Op::apply(backward[column], forward[column + kernel - 1]);
+				} // for
+			} // for lines
+		} // operator ()
+
+	private:
+		const T *_source;
+		unsigned int _sourceStride;
+		T *_dest;
+		unsigned int _width, _radius;
+		Codec _codec;
+}; // HorizontalPass
+
+
+/** \brief Column-wise vHGW pass, from the packed intermediate plane back into the image.
+Works a whole (band-wide) row at a time so the inner loops are contiguous and vectorizable. Bands are columns.
+*/
+template <typename T, class Op, class Codec>
+class VerticalPass : public livescene::BandCallback
+{
+	public:
+		VerticalPass(const T *source, T *dest, const unsigned int &destStride, const unsigned int &width, const unsigned int &height,
+			const unsigned int &radius, const Codec &codec, T *forward, T *backward)
+			: _source(source), _dest(dest), _destStride(destStride), _width(width), _height(height), _radius(radius), _codec(codec),
+			_forward(forward), _backward(backward) {}
+
+		virtual void operator ()(const unsigned int &begin, const unsigned int &end)
+		{
+			const unsigned int kernel = 2 * _radius + 1;
+			const unsigned int paddedLines = roundUpToMultiple(_height + 2 * _radius, kernel);
+			const unsigned int bandWidth = end - begin;
+			const std::vector<T> identityRow(bandWidth, Op::identity());
+
+			for(unsigned int blockStart = 0; blockStart < paddedLines; blockStart += kernel)
+			{
+				// forward, top down
+				std::copy(paddedRow(blockStart, begin, identityRow), paddedRow(blockStart, begin, identityRow) + bandWidth, forwardRow(blockStart, begin));
+				for(unsigned int index = blockStart + 1; index < blockStart + kernel; ++index)
+				{
+					const T *inRow = paddedRow(index, begin, identityRow), *previousRow = forwardRow(index - 1, begin);
+					T *outRow = forwardRow(index, begin);
+					for(unsigned int column = 0; column < bandWidth; ++column)
+					{
+						outRow[column] = Op::apply(previousRow[column], inRow[column]);
+					} // for
+				} // for
+				// backward, bottom up
+				const unsigned int blockLast = blockStart + kernel - 1;
+				std::copy(paddedRow(blockLast, begin, identityRow), paddedRow(blockLast, begin, identityRow) + bandWidth, backwardRow(blockLast, begin));
+				for(unsigned int index = blockLast; index > blockStart; --index)
+				{
+					const T *inRow = paddedRow(index - 1, begin, identityRow), *previousRow = backwardRow(index, begin);
+					T *outRow = backwardRow(index - 1, begin);
+					for(unsigned int column = 0; column < bandWidth; ++column)
+					{
+						outRow[column] = Op::apply(previousRow[column], inRow[column]);
+					} // for
+				} // for
+			} // for blocks
+
+			for(unsigned int line = 0; line < _height; ++line)
+			{
+				const T *backRow = backwardRow(line, begin), *foreRow = forwardRow(line + kernel - 1, begin);
+				T *destRow = _dest + line * _destStride + begin;
+				for(unsigned int column = 0; column < bandWidth; ++column)
+				{
+					destRow[column] = _codec.out(Op::apply(backRow[column], foreRow[column]));
+				} // for
+			} // for lines
+		} // operator ()
+
+	private:
+		// padded line index to intermediate data, or the identity padding beyond the image
+		inline const T *paddedRow(const unsigned int &index, const unsigned int &begin, const std::vector<T> &identityRow) const
+		{
+			if(index < _radius || index >= _radius + _height) return(&identityRow.front());
+			return(_source + (index - _radius) * _width + begin);
+		}
+		inline T *forwardRow(const unsigned int &index, const unsigned int &begin) const {return(_forward + index * _width + begin);}
+		inline T *backwardRow(const unsigned int &index, const unsigned int &begin) const {return(_backward + index * _width + begin);}
+
+		const T *_source;
+		T *_dest;
+		unsigned int _destStride, _width, _height, _radius;
+		Codec _codec;
+		T *_forward, *_backward;
+}; // VerticalPass
+
+
+template <typename T, class Op, class Codec>
+static void separableFilter(T *data, const unsigned int &width, const unsigned int &height, const unsigned int &stride,
+	const unsigned int &radiusX, const unsigned int &radiusY, const Codec &codec, const unsigned int &numThreads,
+	std::vector<T> &intermediate, std::vector<T> &forward, std::vector<T> &backward)
+{
+	if(!data || width == 0 || height == 0)
+	{
+		return;
+	} // if
+
+	const unsigned int kernelY = 2 * radiusY + 1;
+	const unsigned int paddedSamples = roundUpToMultiple(height + 2 * radiusY, kernelY) * width;
+	intermediate.resize(width * height);
+	if(forward.size() < paddedSamples)
+	{
+		forward.resize(paddedSamples);
+		backward.resize(paddedSamples);
+	} // if
+
+	HorizontalPass<T, Op, Codec> horizontalPass(data, stride, &intermediate.front(), width, radiusX, codec);
+	runBandsParallel(horizontalPass, height, numThreads);
+	VerticalPass<T, Op, Codec> verticalPass(&intermediate.front(), data, stride, width, height, radiusY, codec, &forward.front(), &backward.front());
+	runBandsParallel(verticalPass, width, numThreads, 32); // wider bands keep the row loops worth vectorizing
+} // separableFilter
+
+
+
+void Morphology::erodeMask(unsigned char *mask, const unsigned int &width, const unsigned int &height, const unsigned int &stride)
+{
+	separableFilter<unsigned char, MinOp<unsigned char> >(mask, width, height, stride, _radiusX, _radiusY, PlainCodec<unsigned char>(), _numThreads,
+		_maskIntermediate, _maskForward, _maskBackward);
+} // Morphology::erodeMask
+
+void Morphology::dilateMask(unsigned char *mask, const unsigned int &width, const unsigned int &height, const unsigned int &stride)
+{
+	separableFilter<unsigned char, MaxOp<unsigned char> >(mask, width, height, stride, _radiusX, _radiusY, PlainCodec<unsigned char>(), _numThreads,
+		_maskIntermediate, _maskForward, _maskBackward);
+} // Morphology::dilateMask
+
+void Morphology::openMask(unsigned char *mask, const unsigned int &width, const unsigned int &height, const unsigned int &stride)
+{
+	erodeMask(mask, width, height, stride);
+	dilateMask(mask, width, height, stride);
+} // Morphology::openMask
+
+void Morphology::closeMask(unsigned char *mask, const unsigned int &width, const unsigned int &height, const unsigned int &stride)
+{
+	dilateMask(mask, width, height, stride);
+	erodeMask(mask, width, height, stride);
+} // Morphology::closeMask
+
+
+
+bool Morphology::erodeDepth(const livescene::ImageView &imageZ)
+{
+	if(!imageZ.isZ())
+	{
+		return(false);
+	} // if
+	// NULL is farthest, so the farthest of the neighborhood shrinks the silhouette
+	separableFilter<unsigned short, MaxOp<unsigned short> >(imageZ.getData(), imageZ.getWidth(), imageZ.getHeight(), imageZ.getStride(),
+		_radiusX, _radiusY, NullFarCodec((unsigned short)imageZ.getNull()), _numThreads,
+		_depthIntermediate, _depthForward, _depthBackward);
+	return(true);
+} // Morphology::erodeDepth
+
+bool Morphology::dilateDepth(const livescene::ImageView &imageZ)
+{
+	if(!imageZ.isZ())
+	{
+		return(false);
+	} // if
+	// the nearest of the neighborhood grows the silhouette, and NULL only survives where there's nothing else
+	separableFilter<unsigned short, MinOp<unsigned short> >(imageZ.getData(), imageZ.getWidth(), imageZ.getHeight(), imageZ.getStride(),
+		_radiusX, _radiusY, NullFarCodec((unsigned short)imageZ.getNull()), _numThreads,
+		_depthIntermediate, _depthForward, _depthBackward);
+	return(true);
+} // Morphology::dilateDepth
+
+bool Morphology::openDepth(const livescene::ImageView &imageZ)
+{
+	return(erodeDepth(imageZ) && dilateDepth(imageZ));
+} // Morphology::openDepth
+
+bool Morphology::closeDepth(const livescene::ImageView &imageZ)
+{
+	return(dilateDepth(imageZ) && erodeDepth(imageZ));
+} // Morphology::closeDepth
+
+
+// namespace livescene
+}
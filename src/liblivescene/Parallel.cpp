@@ -0,0 +1,267 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#include "liblivescene/Parallel.h"
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+#include <OpenThreads/ScopedLock>
+#include <algorithm> // std::min/max
+#include <vector>
+#include <deque>
+#include <utility> // std::pair
+
+namespace livescene {
+
+static unsigned int defaultNumThreads(0); // 0 means not yet queried
+static OpenThreads::Mutex defaultNumThreadsMutex;
+
+
+/** \brief One runBandsParallel() call: its callback and how many of its bands aren't done yet. */
+struct BandJob
+{
+	livescene::BandCallback *callback;
+	unsigned int remaining;
+}; // BandJob
+
+/** \brief A band of a BandJob waiting to be run. */
+struct BandTask
+{
+	BandJob *job;
+	unsigned int begin, end;
+}; // BandTask
+
+
+/** \brief Worker threads kept for the life of the program and woken for each runBandsParallel() call.
+Starting and joining threads on every call would cost more than many bands take to run.
+Callers don't just wait for their bands, they run queued bands themselves until theirs are done,
+so a band may call runBandsParallel() again without waiting on workers that are waiting on it.
+*/
+class BandPool
+{
+	public:
+		BandPool() : _quit(false) {}
+		~BandPool();
+
+		// runs callback on each of bands, using the calling thread for the first, and returns once all are done
+		void run(livescene::BandCallback &callback, const std::vector<std::pair<unsigned int, unsigned int> > &bands);
+		// the worker thread loop
+		void work(void);
+
+	private:
+		// starts workers until there are at least numWorkers. Call with _mutex locked.
+		void addWorkers(const unsigned int &numWorkers);
+		// runs a task and marks it done. Call with _mutex locked, which is released while the band runs.
+		void runTask(const BandTask &task);
+
+		OpenThreads::Mutex _mutex;
+		OpenThreads::Condition _workQueued, _jobDone;
+		std::deque<BandTask> _tasks;
+		std::vector<OpenThreads::Thread *> _workers;
+		bool _quit;
+}; // BandPool
+
+
+/** \brief Runs BandPool::work() on its own thread. */
+class BandWorker : public OpenThreads::Thread
+{
+	public:
+		BandWorker(BandPool &pool) : _pool(pool) {}
+		virtual void run(void) {_pool.work();}
+	private:
+		BandPool &_pool;
+}; // BandWorker
+
+
+BandPool::~BandPool()
+{
+	_mutex.lock();
+	_quit = true;
+	_workQueued.broadcast();
+	_mutex.unlock();
+	for(std::vector<OpenThreads::Thread *>::iterator workerIt = _workers.begin(); workerIt != _workers.end(); ++workerIt)
+	{
+		(*workerIt)->join();
+		delete *workerIt;
+	} // for
+} // BandPool::~BandPool
+
+
+void BandPool::addWorkers(const unsigned int &numWorkers)
+{
+	while(_workers.size() < numWorkers)
+	{
+		BandWorker *worker = new BandWorker(*this);
+		if(worker->start() != 0)
+		{ // couldn't get a thread, callers will run their bands themselves
+			delete worker;
+			return;
+		} // if
+		_workers.push_back(worker);
+	} // while
+} // BandPool::addWorkers
+
+
+void BandPool::runTask(const BandTask &task)
+{
+	_mutex.unlock();
+	(*task.job->callback)(task.begin, task.end);
+	_mutex.lock();
+	if(--task.job->remaining == 0)
+	{
+		_jobDone.broadcast();
+	} // if
+} // BandPool::runTask
+
+
+void BandPool::run(livescene::BandCallback &callback, const std::vector<std::pair<unsigned int, unsigned int> > &bands)
+{
+	BandJob job;
+	job.callback = &callback;
+	job.remaining = bands.size();
+
+	_mutex.lock();
+	addWorkers(bands.size() - 1);
+	for(unsigned int bandNum = 1; bandNum < bands.size(); ++bandNum)
+	{
+		BandTask task;
+		task.job = &job;
+		task.begin = bands[bandNum].first;
+		task.end = bands[bandNum].second;
+		_tasks.push_back(task);
+	} // for
+	_workQueued.broadcast();
+
+	BandTask first;
+	first.job = &job;
+	first.begin = bands[0].first;
+	first.end = bands[0].second;
+	runTask(first);
+
+	// help with whatever is queued, ours or not, until our bands are done
+	while(job.remaining > 0)
+	{
+		if(!_tasks.empty())
+		{
+			const BandTask task(_tasks.front());
+			_tasks.pop_front();
+			runTask(task);
+		} // if
+		else
+		{
+			_jobDone.wait(&_mutex);
+		} // else
+	} // while
+	_mutex.unlock();
+} // BandPool::run
+
+
+void BandPool::work(void)
+{
+	_mutex.lock();
+	while(!_quit)
+	{
+		if(_tasks.empty())
+		{
+			_workQueued.wait(&_mutex);
+			continue;
+		} // if
+		const BandTask task(_tasks.front());
+		_tasks.pop_front();
+		runTask(task);
+	} // while
+	_mutex.unlock();
+} // BandPool::work
+
+
+static BandPool bandPool;
+
+
+unsigned int getDefaultNumThreads(void)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(defaultNumThreadsMutex);
+	if(defaultNumThreads == 0)
+	{
+		defaultNumThreads = std::max(OpenThreads::GetNumberOfProcessors(), 1);
+	} // if
+	return(defaultNumThreads);
+} // getDefaultNumThreads
+
+
+void setDefaultNumThreads(const unsigned int numThreads)
+{
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(defaultNumThreadsMutex);
+	defaultNumThreads = numThreads;
+} // setDefaultNumThreads
+
+
+void runBandsParallel(livescene::BandCallback &callback, const unsigned int &numItems,
+	unsigned int numThreads, const unsigned int &minItemsPerBand)
+{
+	if(numThreads == 0)
+	{
+		numThreads = getDefaultNumThreads();
+	} // if
+	const unsigned int numBands = std::min(numThreads, std::max(numItems / std::max(minItemsPerBand, 1U), 1U));
+	if(numBands <= 1)
+	{
+		callback(0, numItems);
+		return;
+	} // if
+
+	// spread the remainder over the first bands so they differ by at most one item
+	const unsigned int itemsPerBand = numItems / numBands, extraItems = numItems % numBands;
+	std::vector<std::pair<unsigned int, unsigned int> > bands;
+	bands.reserve(numBands);
+	for(unsigned int band = 0, begin = 0; band < numBands; ++band)
+	{
+		const unsigned int end = begin + itemsPerBand + (band < extraItems ? 1 : 0);
+		bands.push_back(std::make_pair(begin, end));
+		begin = end;
+	} // for
+	bandPool.run(callback, bands);
+} // runBandsParallel
+
+
+/** \brief Adapts a list of tiles to runBandsParallel(): bands are runs of the list. */
+class TileBands : public livescene::BandCallback
+{
+	public:
+		TileBands(livescene::SpanCallback &callback, const std::vector<unsigned int> &tiles, const unsigned int &tileSize,
+			const unsigned int &width, const unsigned int &height)
+			: _callback(callback), _tiles(tiles), _tileSize(tileSize), _width(width), _height(height), _tilesX((width + tileSize - 1) / tileSize) {}
+
+		virtual void operator ()(const unsigned int &begin, const unsigned int &end)
+		{
+			for(unsigned int index = begin; index < end; ++index)
+			{
+				const unsigned int tileX = _tiles[index] % _tilesX, tileY = _tiles[index] / _tilesX;
+				const unsigned int beginColumn = tileX * _tileSize, endColumn = std::min(beginColumn + _tileSize, _width);
+				const unsigned int endLine = std::min((tileY + 1) * _tileSize, _height);
+				for(unsigned int line = tileY * _tileSize; line < endLine; ++line)
+				{
+					_callback(line, beginColumn, endColumn);
+				} // for
+			} // for
+		} // operator ()
+
+	private:
+		livescene::SpanCallback &_callback;
+		const std::vector<unsigned int> &_tiles;
+		unsigned int _tileSize, _width, _height, _tilesX;
+}; // TileBands
+
+
+void runTilesParallel(livescene::SpanCallback &callback, const std::vector<unsigned int> &tiles, const unsigned int &tileSize,
+	const unsigned int &width, const unsigned int &height, unsigned int numThreads)
+{
+	if(tiles.empty() || tileSize == 0)
+	{
+		return;
+	} // if
+	TileBands bands(callback, tiles, tileSize, width, height);
+	runBandsParallel(bands, tiles.size(), numThreads, 4);
+} // runTilesParallel
+
+
+// namespace livescene
+}
@@ -0,0 +1,375 @@
+// Copyright 2011 Skew Matrix Software and AlphaPixel
+
+#include "liblivescene/Tracker.h"
+#include <algorithm> // std::min/max/sort
+#include <cmath> // fabs
+
+namespace livescene {
+
+
+void KalmanFilterCV::reset(const float position)
+{
+	_position = position;
+	_velocity = 0.0f;
+	_p00 = _measurementNoise;
+	_p01 = 0.0f;
+	_p11 = 10.0f * _measurementNoise; // nothing is known about the velocity yet
+} // KalmanFilterCV::reset
+
+void KalmanFilterCV::predict(void)
+{
+	// x' = F x with F = [1 1; 0 1], P' = F P F' + Q, Q from a random acceleration over one frame
+	_position += _velocity;
+	_p00 += 2.0f * _p01 + _p11 + _processNoise * 0.25f;
+	_p01 += _p11 + _processNoise * 0.5f;
+	_p11 += _processNoise;
+} // KalmanFilterCV::predict
+
+void KalmanFilterCV::correct(const float measurement)
+{
+	const float innovationVariance(_p00 + _measurementNoise);
+	const float gainPosition(_p00 / innovationVariance), gainVelocity(_p01 / innovationVariance);
+	const float innovation(measurement - _position);
+	_position += gainPosition * innovation;
+	_velocity += gainVelocity * innovation;
+	// P' = (I - K H) P, H = [1 0]. The velocity term must use the old _p01, so it goes first.
+	_p11 -= gainVelocity * _p01;
+	_p01 *= 1.0f - gainPosition;
+	_p00 *= 1.0f - gainPosition;
+} // KalmanFilterCV::correct
+
+
+
+void TrackedPoint::setNoise(const float processNoise, const float measurementNoise)
+{
+	for(unsigned int axis = 0; axis < 3; ++axis)
+	{
+		_axes[axis].setNoise(processNoise, measurementNoise);
+	} // for
+} // TrackedPoint::setNoise
+
+void TrackedPoint::reset(const float *position)
+{
+	for(unsigned int axis = 0; axis < 3; ++axis)
+	{
+		_axes[axis].reset(position[axis]);
+	} // for
+	updatePosition();
+} // TrackedPoint::reset
+
+void TrackedPoint::predict(void)
+{
+	for(unsigned int axis = 0; axis < 3; ++axis)
+	{
+		_axes[axis].predict();
+	} // for
+	updatePosition();
+} // TrackedPoint::predict
+
+void TrackedPoint::correct(const float *measurement)
+{
+	for(unsigned int axis = 0; axis < 3; ++axis)
+	{
+		_axes[axis].correct(measurement[axis]);
+	} // for
+	updatePosition();
+} // TrackedPoint::correct
+
+
+
+const float BodyTracker::_none[3] = {0.0f, 0.0f, 0.0f};
+
+// squared distance in X, Y between a tracked position and a detection
+static inline float distanceSquaredXY(const float *first, const float *second)
+{
+	const float deltaX(first[0] - second[0]), deltaY(first[1] - second[1]);
+	return(deltaX * deltaX + deltaY * deltaY);
+} // distanceSquaredXY
+
+// squared gate within which a detection may match a body, a few body widths
+static inline float bodyGateSquared(const float *halfExtent)
+{
+	const float gate(2.5f * std::max(halfExtent[0], halfExtent[1]) + 8.0f);
+	return(gate * gate);
+} // bodyGateSquared
+
+
+/** \brief A possible match of a track to a detection, for greedy nearest-first association. */
+struct TrackPairing
+{
+	TrackPairing(const float &distanceSquared, const unsigned int &track, const unsigned int &detection)
+		: distanceSquared(distanceSquared), track(track), detection(detection) {}
+	bool operator <(const TrackPairing &other) const {return(distanceSquared < other.distanceSquared);}
+
+	float distanceSquared;
+	unsigned int track, detection;
+}; // TrackPairing
+
+
+BodyTracker::BodyTracker()
+: _nextID(1), _framesSinceGlobal(0), _lostTrack(false), _lastSearchGlobal(true),
+_globalSearchInterval(30), _maxMissedFrames(5), _windowMargin(0.25f), _processNoise(1.0f), _measurementNoise(4.0f)
+{
+} // BodyTracker::BodyTracker
+
+
+void BodyTracker::clear(void)
+{
+	_tracks.clear();
+	_detector.clear();
+	_framesSinceGlobal = 0;
+	_lostTrack = false;
+} // BodyTracker::clear
+
+
+unsigned int BodyTracker::update(const livescene::Image &foreZ, const livescene::Deadline &deadline)
+{
+	for(std::vector<Track>::iterator trackIt = _tracks.begin(); trackIt != _tracks.end(); ++trackIt)
+	{
+		trackIt->body.predict();
+		for(unsigned int slot = 0; slot < 2; ++slot)
+		{
+			if(trackIt->handTracked[slot]) trackIt->hands[slot].predict();
+		} // for
+	} // for
+
+	// detect, in the predicted window if everything is accounted for
+	_lastSearchGlobal = _tracks.empty() || _lostTrack || _globalSearchInterval == 0 || _framesSinceGlobal >= _globalSearchInterval;
+	if(_lastSearchGlobal)
+	{
+		_detector.detect(foreZ, deadline);
+		_framesSinceGlobal = 0;
+	} // if
+	else
+	{
+		_detector.detect(foreZ, predictedWindow(foreZ), deadline);
+		++_framesSinceGlobal;
+	} // else
+	_detector.detectHands(foreZ, deadline);
+
+	// nearest pairs first, each track and detection used at most once
+	const unsigned int numDetections(_detector.getNumBodies());
+	std::vector<TrackPairing> pairings;
+	for(unsigned int track = 0; track < _tracks.size(); ++track)
+	{
+		const float gateSquared(bodyGateSquared(_tracks[track].halfExtent));
+		for(unsigned int detection = 0; detection < numDetections; ++detection)
+		{
+			const float distanceSquared(distanceSquaredXY(_tracks[track].body.getPosition(), _detector.getBodyCentroid(detection)));
+			if(distanceSquared <= gateSquared)
+			{
+				pairings.push_back(TrackPairing(distanceSquared, track, detection));
+			} // if
+		} // for
+	} // for
+	std::sort(pairings.begin(), pairings.end());
+	std::vector<int> trackDetection(_tracks.size(), -1);
+	std::vector<bool> detectionMatched(numDetections, false);
+	for(std::vector<TrackPairing>::const_iterator pairingIt = pairings.begin(); pairingIt != pairings.end(); ++pairingIt)
+	{
+		if(trackDetection[pairingIt->track] < 0 && !detectionMatched[pairingIt->detection])
+		{
+			trackDetection[pairingIt->track] = pairingIt->detection;
+			detectionMatched[pairingIt->detection] = true;
+		} // if
+	} // for
+
+	// correct what was found, coast what wasn't, and search the whole frame next time if anything was missed
+	_lostTrack = false;
+	for(unsigned int track = 0; track < _tracks.size(); ++track)
+	{
+		if(trackDetection[track] >= 0)
+		{
+			correctTrack(_tracks[track], trackDetection[track]);
+		} // if
+		else
+		{
+			++_tracks[track].missed;
+			missHands(_tracks[track]);
+			_lostTrack = true;
+		} // else
+	} // for
+	for(std::vector<Track>::iterator trackIt = _tracks.begin(); trackIt != _tracks.end(); )
+	{
+		if(trackIt->missed > _maxMissedFrames)
+		{
+			trackIt = _tracks.erase(trackIt);
+		} // if
+		else
+		{
+			++trackIt;
+		} // else
+	} // for
+
+	for(unsigned int detection = 0; detection < numDetections; ++detection)
+	{
+		if(!detectionMatched[detection])
+		{
+			startTrack(detection);
+		} // if
+	} // for
+
+	return(_tracks.size());
+} // BodyTracker::update
+
+
+livescene::ImageView BodyTracker::predictedWindow(const livescene::Image &foreZ) const
+{
+	float windowMinX(foreZ.getWidth()), windowMinY(foreZ.getHeight()), windowMaxX(0.0f), windowMaxY(0.0f);
+	for(std::vector<Track>::const_iterator trackIt = _tracks.begin(); trackIt != _tracks.end(); ++trackIt)
+	{
+		// the last detected bounds, moved to the predicted position and grown by the margin and the speed
+		const float shiftX(trackIt->body.getPosition()[0] - trackIt->measuredCentroid[0]), shiftY(trackIt->body.getPosition()[1] - trackIt->measuredCentroid[1]);
+		const float marginX(_windowMargin * (trackIt->maxX - trackIt->minX + 1) + fabs(trackIt->body.getVelocity(0)) + 8.0f);
+		const float marginY(_windowMargin * (trackIt->maxY - trackIt->minY + 1) + fabs(trackIt->body.getVelocity(1)) + 8.0f);
+		windowMinX = std::min(windowMinX, trackIt->minX + shiftX - marginX);
+		windowMinY = std::min(windowMinY, trackIt->minY + shiftY - marginY);
+		windowMaxX = std::max(windowMaxX, trackIt->maxX + shiftX + marginX + 1.0f);
+		windowMaxY = std::max(windowMaxY, trackIt->maxY + shiftY + marginY + 1.0f);
+	} // for
+
+	// fromBounds() clamps the high side, the low side can't go below zero
+	return(livescene::ImageView::fromBounds(foreZ, (unsigned int)std::max(windowMinX, 0.0f), (unsigned int)std::max(windowMinY, 0.0f),
+		(unsigned int)std::max(windowMaxX, 0.0f), (unsigned int)std::max(windowMaxY, 0.0f)));
+} // BodyTracker::predictedWindow
+
+
+void BodyTracker::startTrack(const unsigned int &detection)
+{
+	_tracks.push_back(Track());
+	Track &track = _tracks.back();
+	track.id = _nextID++;
+	track.body.setNoise(_processNoise, _measurementNoise);
+	track.body.reset(_detector.getBodyCentroid(detection));
+	for(unsigned int slot = 0; slot < 2; ++slot)
+	{
+		track.hands[slot].setNoise(_processNoise, _measurementNoise);
+		track.handTracked[slot] = false;
+		track.handMissed[slot] = 0;
+	} // for
+	for(unsigned int axis = 0; axis < 3; ++axis)
+	{
+		track.halfExtent[axis] = _detector.getBodyHalfExtent(detection)[axis];
+	} // for
+	correctTrack(track, detection);
+} // BodyTracker::startTrack
+
+
+void BodyTracker::correctTrack(Track &track, const unsigned int &detection)
+{
+	const float *centroid = _detector.getBodyCentroid(detection);
+	const livescene::ComponentStats *component = _detector.getBodyComponent(detection);
+	track.body.correct(centroid);
+	for(unsigned int axis = 0; axis < 3; ++axis)
+	{
+		// the extent isn't predicted, just smoothed
+		track.halfExtent[axis] += 0.5f * (_detector.getBodyHalfExtent(detection)[axis] - track.halfExtent[axis]);
+		track.measuredCentroid[axis] = centroid[axis];
+	} // for
+	track.minX = component->minX;
+	track.minY = component->minY;
+	track.maxX = component->maxX;
+	track.maxY = component->maxY;
+	track.missed = 0;
+	updateHands(track, detection);
+} // BodyTracker::correctTrack
+
+
+void BodyTracker::updateHands(Track &track, const unsigned int &detection)
+{
+	// a detected hand either continues the slot it's nearest to, within a gate, or starts over in a free one.
+	// Starting over costs as much as the farthest allowed match, so with two hands the cheaper of the two
+	// ways to pair them with the slots wins.
+	const unsigned int numDetected(std::min(_detector.getNumHands(detection), 2U));
+	const float gate(std::max(std::max(track.halfExtent[0], track.halfExtent[1]), 16.0f)), gateSquared(gate * gate);
+	float cost[2][2]; // [hand][slot]
+	for(unsigned int hand = 0; hand < numDetected; ++hand)
+	{
+		for(unsigned int slot = 0; slot < 2; ++slot)
+		{
+			cost[hand][slot] = track.handTracked[slot] ?
+				std::min(distanceSquaredXY(track.hands[slot].getPosition(), _detector.getHandCentroid(detection, hand)), gateSquared) : gateSquared;
+		} // for
+	} // for
+
+	int handSlot[2] = {-1, -1};
+	if(numDetected == 1)
+	{
+		handSlot[0] = (cost[0][1] < cost[0][0]) ? 1 : 0;
+	} // if
+	else if(numDetected == 2)
+	{
+		const bool swapped(cost[0][1] + cost[1][0] < cost[0][0] + cost[1][1]);
+		handSlot[0] = swapped ? 1 : 0;
+		handSlot[1] = swapped ? 0 : 1;
+	} // else if
+
+	bool slotMeasured[2] = {false, false};
+	for(unsigned int hand = 0; hand < numDetected; ++hand)
+	{
+		const unsigned int slot(handSlot[hand]);
+		const float *measurement = _detector.getHandCentroid(detection, hand);
+		if(track.handTracked[slot] && distanceSquaredXY(track.hands[slot].getPosition(), measurement) < gateSquared)
+		{
+			track.hands[slot].correct(measurement);
+		} // if
+		else
+		{
+			track.hands[slot].reset(measurement);
+			track.handTracked[slot] = true;
+		} // else
+		track.handMissed[slot] = 0;
+		slotMeasured[slot] = true;
+	} // for
+
+	for(unsigned int slot = 0; slot < 2; ++slot)
+	{
+		if(!slotMeasured[slot] && track.handTracked[slot] && ++track.handMissed[slot] > _maxMissedFrames)
+		{
+			track.handTracked[slot] = false;
+		} // if
+	} // for
+} // BodyTracker::updateHands
+
+
+void BodyTracker::missHands(Track &track)
+{
+	for(unsigned int slot = 0; slot < 2; ++slot)
+	{
+		if(track.handTracked[slot] && ++track.handMissed[slot] > _maxMissedFrames)
+		{
+			track.handTracked[slot] = false;
+		} // if
+	} // for
+} // BodyTracker::missHands
+
+
+unsigned int BodyTracker::getNumHands(unsigned int bodyNum) const
+{
+	if(bodyNum >= _tracks.size())
+	{
+		return(0);
+	} // if
+	return((_tracks[bodyNum].handTracked[0] ? 1 : 0) + (_tracks[bodyNum].handTracked[1] ? 1 : 0));
+} // BodyTracker::getNumHands
+
+const float *BodyTracker::getHandCentroid(unsigned int bodyNum, unsigned int handNum) const
+{
+	if(bodyNum >= _tracks.size())
+	{
+		return(_none);
+	} // if
+	const Track &track = _tracks[bodyNum];
+	for(unsigned int slot = 0; slot < 2; ++slot)
+	{
+		if(track.handTracked[slot] && handNum-- == 0)
+		{
+			return(track.hands[slot].getPosition());
+		} // if
+	} // for
+	return(_none);
+} // BodyTracker::getHandCentroid
+
+
+// namespace livescene
+}
@@ -19,8 +19,26 @@ UserInteraction::UserInteraction( osgViewer::GraphicsWindow* window )
     _defaultDetectionThreshold( 700 ),
     _defaultActiveThreshold( 500 ),
     _defaultSendEventsButton( 1 ),
-    _defaultSendEventsPunchMaxAge( 9 )
+    _defaultSendEventsPunchMaxAge( 9 ),
+    _defaultGrabDetection( false ),
+    _defaultGestureDetection( false )
 {
+    // Swipes of 10 frames, circles of 16 and push-pulls of 12 at their usual
+    // speed. Circles may begin at any quarter turn.
+    _gestureRecognizer.addTemplate( livescene::GestureTemplate::swipe( "swipe left", SWIPE_LEFT, -1.f, 0.f, 0.f, 10, 60.f ) );
+    _gestureRecognizer.addTemplate( livescene::GestureTemplate::swipe( "swipe right", SWIPE_RIGHT, 1.f, 0.f, 0.f, 10, 60.f ) );
+    _gestureRecognizer.addTemplate( livescene::GestureTemplate::swipe( "swipe up", SWIPE_UP, 0.f, -1.f, 0.f, 10, 60.f ) );
+    _gestureRecognizer.addTemplate( livescene::GestureTemplate::swipe( "swipe down", SWIPE_DOWN, 0.f, 1.f, 0.f, 10, 60.f ) );
+    for( unsigned int quarter=0; quarter < 4; ++quarter )
+    {
+        const float startAngle( quarter * 3.14159265f / 2.f );
+        _gestureRecognizer.addTemplate( livescene::GestureTemplate::circle( "circle clockwise", CIRCLE_CLOCKWISE, true, startAngle, 16, 120.f ) );
+        _gestureRecognizer.addTemplate( livescene::GestureTemplate::circle( "circle counterclockwise", CIRCLE_COUNTERCLOCKWISE, false, startAngle, 16, 120.f ) );
+    }
+    _gestureRecognizer.addTemplate( livescene::GestureTemplate::pushPull( "push pull", PUSH_PULL, 12, 30.f ) );
+
+    for( int contact=SWIPE_LEFT; contact <= PUSH_PULL; ++contact )
+        _eventMap[ (ContactType)contact ] = osgGA::GUIEventAdapter::USER;
 }
 UserInteraction::~UserInteraction()
 {
@@ -35,6 +53,19 @@ void UserInteraction::detectAndSendEvents( const livescene::Image& imageRGB, con
     else
         defaultDetection( newInteractors, imageRGB, imageZ );
 
+    // Follow the first Interactor's motion, as the user sees it.
+    if( _defaultGestureDetection )
+    {
+        if( newInteractors.empty() )
+            _gestureRecognizer.reset();
+        else
+        {
+            const Interactor& first = newInteractors.front();
+            const float position[ 3 ] = { (float)( imageZ.getWidth() - first._location.x() ), (float)( first._location.y() ), (float)( first._distance ) };
+            _gestureRecognizer.update( position );
+        }
+    }
+
     if( _sendEventsCallback.valid() )
         (*_sendEventsCallback)( this, _interactors, newInteractors );
     else
@@ -69,48 +100,48 @@ const UserInteraction::SendEventsCallback* UserInteraction::getSendEventsCallbac
     return( _sendEventsCallback.get() );
 }
 
-void UserInteraction::defaultDetection( InteractorContainer& interactors, const livescene::Image& imageRGB, const livescene::Image& imageZ )
+// Sometimes get spurious sudden changes in z, 300-400 units closer
+// to the Kinect. Tried sampling corners of a 4x4 square but saw _all_
+// those sample points jump closer. Now sampling corners of a 8x8
+// square instead, and that seems to filter out this problem.
+class CornerApproveCallback : public livescene::ApproveCallback
 {
-    unsigned short* ptr = ( unsigned short* )( imageZ.getData() );
-    int width = imageZ.getWidth();
-    int height = imageZ.getHeight();
+public:
+    CornerApproveCallback( const livescene::Image& imageZ )
+      : _ptr( ( const unsigned short* )( imageZ.getData() ) ),
+        _width( imageZ.getWidth() ),
+        _height( imageZ.getHeight() )
+    {}
+    bool operator ()( const unsigned int& xCoord, const unsigned int& yCoord, const unsigned short& zCoord )
+    {
+        if( ( xCoord + 8 >= _width ) ||
+            ( yCoord + 8 >= _height ) )
+            return( false );
+        const unsigned short* ptr = _ptr + yCoord * _width + xCoord;
+        unsigned short sample1 = *( ptr + 7 );
+        unsigned short sample2 = *( ptr + (_width * 7) );
+        unsigned short sample3 = *( ptr + (_width * 7) + 7 );
+        unsigned short targetDistance = zCoord * 1.1; // 110%
+        return( ( sample1 < targetDistance ) &&
+            ( sample2 < targetDistance ) &&
+            ( sample3 < targetDistance ) );
+    }
+private:
+    const unsigned short* _ptr;
+    unsigned int _width, _height;
+};
 
+void UserInteraction::defaultDetection( InteractorContainer& interactors, const livescene::Image& imageRGB, const livescene::Image& imageZ )
+{
     unsigned short undetected( 0xffff );
     unsigned short minVal( undetected );
     osg::Vec2s minLoc;
-    int sdx, tdx;
-    for( tdx=0; tdx<height; ++tdx )
-    {
-        for( sdx=0; sdx<width; ++sdx )
-        {
-            if( *ptr < minVal )
-            {
-                // Sometimes get spurious sudden changes in z, 300-400 units closer
-                // to the Kinect. Tried sampling corners of a 4x4 square but saw _all_
-                // those sample points jump closer. Now sampling corners of a 8x8
-                // square instead, and that seems to filter out this problem.
-                if( ( sdx < ( width - 8 ) ) &&
-                    ( tdx < ( height - 8 ) ) )
-                {
-                    unsigned short sample1 = *( ptr + 7 );
-                    unsigned short sample2 = *( ptr + (width * 7) );
-                    unsigned short sample3 = *( ptr + (width * 7) + 7 );
-                    unsigned short targetDistance = (*ptr) * 1.1; // 110%
-                    if( ( sample1 < targetDistance ) &&
-                        ( sample2 < targetDistance ) &&
-                        ( sample3 < targetDistance ) )
-                    {
-                        minVal = *ptr;
-                        ptr += ( (width * 7) + 7 ); // scan past the vertices we just sampled.
-                        minLoc.set( sdx, tdx );
-                        sdx += 7;
-                        tdx += 7;
-                    }
-                }
-            }
-            ++ptr;
-        }
-    }
+
+    // Nearest sample whose 8x8 square corners are also near.
+    CornerApproveCallback cornerApprove( imageZ );
+    unsigned int minX, minY;
+    if( imageZ.getView().findMinZ( undetected - 1, minX, minY, minVal, &cornerApprove, 0, &_rowMins ) )
+        minLoc.set( minX, minY );
 
     if( minVal < getDefaultDetectionThreshold() )
     {
@@ -119,7 +150,20 @@ void UserInteraction::defaultDetection( InteractorContainer& interactors, const
         newInteractor._id = 121;
         newInteractor._location = minLoc;
         newInteractor._distance = minVal;
-        newInteractor._active = ( minVal < getDefaultActiveThreshold() );
+        if( getDefaultGrabDetection() )
+        {
+            // Closed hand grabs, open hand releases. Keep the last state while unsure.
+            const float handCentroid[ 3 ] = { (float)( minLoc.x() ), (float)( minLoc.y() ), (float)( minVal ) };
+            newInteractor._handState = _handShape.analyze( imageZ, handCentroid );
+            if( newInteractor._handState == livescene::HandShape::UNKNOWN )
+            {
+                int prevIdx = getIndexByID( newInteractor._id, _interactors );
+                newInteractor._handState = ( prevIdx >= 0 ) ? _interactors[ prevIdx ]._handState : livescene::HandShape::OPEN;
+            }
+            newInteractor._active = ( newInteractor._handState == livescene::HandShape::CLOSED );
+        }
+        else
+            newInteractor._active = ( minVal < getDefaultActiveThreshold() );
         //std::cout << "Active: " << newInteractor._active << " because: " << minVal << " and " << getDefaultActiveThreshold() << std::endl;
         interactors.push_back( newInteractor );
     }
@@ -160,7 +204,7 @@ void UserInteraction::defaultSendEvents( InteractorContainer& lastInteractors, I
  
             if( previous._active && !( current._active ) )
             {
-                if( current._age < _defaultSendEventsPunchMaxAge )
+                if( !_defaultGrabDetection && ( current._age < _defaultSendEventsPunchMaxAge ) )
                 {
                     // PUNCH event.
                     eq->keyPress( ' ' );
@@ -224,6 +268,21 @@ void UserInteraction::defaultSendEvents( InteractorContainer& lastInteractors, I
         std::cout << " " << x << ", " << y << std::endl;
         eq->mouseButtonRelease( x, y, _defaultSendEventsButton );
     }
+
+    // Gestures recognized this frame, as whatever event types they map to.
+    if( !_defaultGestureDetection )
+        return;
+    const std::vector< livescene::GestureMatch >& gestures = getRecognizedGestures();
+    for( unsigned int idx=0; idx < gestures.size(); ++idx )
+    {
+        ContactEventMap::const_iterator mapItr = _eventMap.find( (ContactType)( gestures[ idx ].id ) );
+        if( mapItr == _eventMap.end() )
+            continue;
+        osgGA::GUIEventAdapter* event = eq->createEvent();
+        event->setEventType( mapItr->second );
+        event->setName( _gestureRecognizer.getTemplate( gestures[ idx ].templateNum ).name );
+        eq->addEvent( event );
+    }
 }
 
 
@@ -272,6 +331,26 @@ unsigned int UserInteraction::getDefaultSendEventsPunchMaxAge() const
     return( _defaultSendEventsPunchMaxAge );
 }
 
+void UserInteraction::setDefaultGrabDetection( bool enable )
+{
+    _defaultGrabDetection = enable;
+}
+bool UserInteraction::getDefaultGrabDetection() const
+{
+    return( _defaultGrabDetection );
+}
+
+void UserInteraction::setDefaultGestureDetection( bool enable )
+{
+    if( enable != _defaultGestureDetection )
+        _gestureRecognizer.reset(); // Start over from the next frame's motion.
+    _defaultGestureDetection = enable;
+}
+bool UserInteraction::getDefaultGestureDetection() const
+{
+    return( _defaultGestureDetection );
+}
+
 
 int UserInteraction::getIndexOfClosest( const osg::Vec2s& loc, const InteractorContainer& interactors, float& distance ) const
 {
@@ -374,7 +453,8 @@ UserInteraction::Interactor::Interactor()
   : _id( 0 ),
     _distance( 0 ),
     _age( 0 ),
-    _active( false )
+    _active( false ),
+    _handState( livescene::HandShape::UNKNOWN )
 {
 }
 
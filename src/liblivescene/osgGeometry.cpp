@@ -44,6 +44,37 @@ int transformOSG( osg::Vec3Array* vec, const osg::Matrix& m, const livescene::Im
     return( vdx );
 }
 
+int transformMetricOSG( osg::Vec3Array* vec, const livescene::DepthConversion& conversion, const livescene::Image &imageMM )
+{
+    if( imageMM.getFormat() != livescene::DEPTH_MM_16 || imageMM.getWidth() > conversion.getWidth() || imageMM.getHeight() > conversion.getHeight() )
+        return( 0 );
+
+    const int width = imageMM.getWidth();
+    const int height = imageMM.getHeight();
+    vec->resize( width * height );
+
+    const unsigned short* dataPtr = ( const unsigned short* )( imageMM.getData() );
+    const float* rayX = conversion.getRayX();
+    const float* rayY = conversion.getRayY();
+    const unsigned short nullValue = ( unsigned short )( imageMM.getNull() );
+    int sdx, tdx, vdx( 0 );
+    for( tdx=0; tdx<height; ++tdx )
+    {
+        const float lineRay = rayY[ tdx ];
+        for( sdx=0; sdx<width; ++sdx )
+        {
+            const unsigned short value = *dataPtr++;
+            if( value != nullValue )
+            {
+                (*vec)[ vdx++ ].set( rayX[ sdx ] * value, lineRay * value, -0.001f * value );
+            }
+        }
+    }
+    vec->resize( vdx ); // unlike transformOSG, don't leave stale entries past the valid ones
+    vec->dirty();
+    return( vdx );
+}
+
 
 
 // <<<>>> this function does NOT currently work!